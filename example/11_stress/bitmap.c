@@ -0,0 +1,34 @@
+#include <vgs.h>
+
+// Stress: redraws the bitmap planes with lines, boxes and pixels every frame
+
+#define FRAMES 600
+
+int main(int argc, char* argv[])
+{
+    int width = vgs_draw_width();
+    int height = vgs_draw_height();
+    vgs_draw_mode(0, TRUE);
+    vgs_draw_mode(1, TRUE);
+
+    for (int frame = 0; frame < FRAMES; frame++) {
+        vgs_vsync();
+        vgs_draw_boxf(0, 0, 0, width, height, 0x101820);
+        for (int i = 0; i < 64; i++) {
+            int degree = (frame * 2 + i * 6) % 360;
+            vgs_draw_line(0, width / 2, height / 2, width / 2 + vgs_cos(degree) * 150 / 256, height / 2 + vgs_sin(degree) * 150 / 256, 0x4080C0 + i * 0x020100);
+        }
+        vgs_draw_clear(1, 0, 0, width, height);
+        for (int i = 0; i < 32; i++) {
+            int x = (frame * (i + 1) + i * 37) % width;
+            int y = (i * 23 + frame) % height;
+            vgs_draw_boxf(1, x - 12, y - 8, 24, 16, 0x800000 + i * 0x000804);
+            vgs_draw_box(1, x - 12, y - 8, 24, 16, 0xFFFFFF);
+        }
+        for (int i = 0; i < 1024; i++) {
+            vgs_draw_pixel(1, vgs_rand() % width, vgs_rand() % height, 0xFFFF00);
+        }
+    }
+    vgs_exit(0);
+    return 0;
+}
@@ -0,0 +1,47 @@
+#include <vgs.h>
+
+// Stress: moves a bitmap sprite image around WRAM with DMA (memcpy/memset) and sorts records every frame
+
+#define FRAMES 600
+#define SIZE 128 // size of the bitmap sprite (pixels)
+#define COPY_NUM 16
+#define RECORD_NUM 4096
+
+static uint32_t image[SIZE * SIZE]; // RGB888 referred by the bitmap sprite
+static uint32_t work[SIZE * SIZE];
+
+static struct Record {
+    uint32_t key;
+    uint32_t value;
+} records[RECORD_NUM];
+
+int main(int argc, char* argv[])
+{
+    for (int y = 0; y < SIZE; y++) {
+        for (int x = 0; x < SIZE; x++) {
+            image[y * SIZE + x] = ((x ^ y) & 8) ? 0x2060A0 + x * 0x010000 : 0x102030 + y * 0x000101;
+        }
+    }
+    vgs_sprite(0, TRUE, (vgs_draw_width() - SIZE) / 2, (vgs_draw_height() - SIZE) / 2, SIZE / 8 - 1, 0, 0);
+    vgs_oam(0)->ram_ptr = (uint32_t)image;
+
+    for (int frame = 0; frame < FRAMES; frame++) {
+        vgs_vsync();
+        // scroll the image by one line
+        vgs_memcpy(work, image, SIZE * 4);
+        vgs_memcpy(image, &image[SIZE], (SIZE - 1) * SIZE * 4);
+        vgs_memcpy(&image[(SIZE - 1) * SIZE], work, SIZE * 4);
+        // bulk transfers
+        for (int i = 0; i < COPY_NUM; i++) {
+            vgs_memcpy(work, image, sizeof(image));
+            vgs_memset(work, i, sizeof(work));
+        }
+        for (int i = 0; i < RECORD_NUM; i++) {
+            records[i].key = vgs_rand32();
+            records[i].value = i;
+        }
+        vgs_sort(records, RECORD_NUM, sizeof(struct Record), 0, VGS_DMA_SORT_KEY32);
+    }
+    vgs_exit(0);
+    return 0;
+}
@@ -0,0 +1,50 @@
+#include <vgs.h>
+
+// Stress: 4 planes of character pattern BG filled with tiles and scrolled at different speeds
+
+#define FRAMES 600
+#define P_TILE 0
+#define TILE_NUM 16
+
+static uint8_t patterns[TILE_NUM][32];
+
+// tiles of diagonal stripes (the color 0 is transparent, so the lower planes are visible)
+static void make_patterns(void)
+{
+    for (int i = 0; i < TILE_NUM; i++) {
+        for (int y = 0; y < 8; y++) {
+            for (int x = 0; x < 8; x++) {
+                uint8_t col = ((x + y + i) & 3) ? 0 : 1 + (x + i) % 15;
+                patterns[i][y * 4 + x / 2] |= (x & 1) ? col : col << 4;
+            }
+        }
+    }
+    vgs_ptn_transfer(P_TILE, patterns, sizeof(patterns));
+}
+
+int main(int argc, char* argv[])
+{
+    make_patterns();
+    for (int pal = 0; pal < 4; pal++) {
+        for (int col = 1; col < 16; col++) {
+            vgs_pal_set(pal, col, vgs_rand32() & 0xFFFFFF);
+        }
+    }
+    vgs_pal_set(0, 0, 0x102030);
+    for (int n = 0; n < 4; n++) {
+        for (int y = 0; y < BG_HEIGHT; y++) {
+            for (int x = 0; x < BG_WIDTH; x++) {
+                vgs_put_bg(n, x, y, (uint32_t)n << 16 | (P_TILE + vgs_rand() % TILE_NUM));
+            }
+        }
+    }
+
+    for (int frame = 0; frame < FRAMES; frame++) {
+        vgs_vsync();
+        for (int n = 0; n < 4; n++) {
+            vgs_scroll(n, frame * (n + 1), vgs_sin((frame * (n + 1)) % 360) / 8 + frame * n / 2);
+        }
+    }
+    vgs_exit(0);
+    return 0;
+}
@@ -0,0 +1,76 @@
+#include <vgs.h>
+
+// Stress: 1024 rotated and translucent sprites (16x16) bouncing around the screen
+
+#define SPRITE_NUM 1024
+#define FRAMES 600
+#define P_BALL 0
+
+static uint8_t pattern[4][32]; // 16x16 = 2x2 tiles (4 bits per pixel)
+
+static struct Object {
+    int32_t x;
+    int32_t y;
+    int32_t vx;
+    int32_t vy;
+} objects[SPRITE_NUM];
+
+// a disc shaded with the colors 1 to 15 from the center
+static void make_pattern(void)
+{
+    for (int y = 0; y < 16; y++) {
+        for (int x = 0; x < 16; x++) {
+            int dx = x * 2 - 15;
+            int dy = y * 2 - 15;
+            int d = dx * dx + dy * dy;
+            uint8_t col = d < 225 ? 1 + d * 14 / 225 : 0;
+            uint8_t* ptr = &pattern[(y >> 3) * 2 + (x >> 3)][(y & 7) * 4 + (x & 7) / 2];
+            *ptr |= (x & 1) ? col : col << 4;
+        }
+    }
+    vgs_ptn_transfer(P_BALL, pattern, sizeof(pattern));
+}
+
+int main(int argc, char* argv[])
+{
+    make_pattern();
+    for (int pal = 0; pal < 16; pal++) {
+        for (int col = 1; col < 16; col++) {
+            vgs_pal_set(pal, col, (vgs_rand32() & 0x7F7F7F) + col * 0x080808);
+        }
+    }
+    vgs_draw_mode(0, TRUE);
+    for (int y = 0; y < vgs_draw_height(); y += 8) {
+        vgs_draw_boxf(0, 0, y, vgs_draw_width(), 8, (y & 8) ? 0x203040 : 0x304050);
+    }
+
+    for (int i = 0; i < SPRITE_NUM; i++) {
+        objects[i].x = (vgs_rand() % (vgs_draw_width() - 16)) << 8;
+        objects[i].y = (vgs_rand() % (vgs_draw_height() - 16)) << 8;
+        objects[i].vx = vgs_cos(i % 360) * 2;
+        objects[i].vy = vgs_sin(i % 360) * 2;
+        vgs_sprite(i, TRUE, objects[i].x >> 8, objects[i].y >> 8, 1, i & 15, P_BALL);
+        vgs_sprite_alpha8(vgs_oam(i), 0x80);
+    }
+
+    for (int frame = 0; frame < FRAMES; frame++) {
+        vgs_vsync();
+        for (int i = 0; i < SPRITE_NUM; i++) {
+            struct Object* obj = &objects[i];
+            ObjectAttributeMemory* oam = vgs_oam(i);
+            obj->x += obj->vx;
+            obj->y += obj->vy;
+            if (obj->x < 0 || (vgs_draw_width() - 16) << 8 < obj->x) {
+                obj->vx = -obj->vx;
+            }
+            if (obj->y < 0 || (vgs_draw_height() - 16) << 8 < obj->y) {
+                obj->vy = -obj->vy;
+            }
+            oam->x = obj->x >> 8;
+            oam->y = obj->y >> 8;
+            oam->rotate = (frame * 3 + i) % 360;
+        }
+    }
+    vgs_exit(0);
+    return 0;
+}
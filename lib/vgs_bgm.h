@@ -63,6 +63,31 @@ static inline void vgs_bgm_resume(void) { VGS_OUT_VGM_PLAY_OPT = VGS_VGM_OPT_RES
  */
 static inline void vgs_bgm_fadeout(void) { VGS_OUT_VGM_PLAY_OPT = VGS_VGM_OPT_FADEOUT; }
 
+/**
+ * @brief Seek the playing background music
+ * @param position Song position in samples (44100 = 1 second)
+ * @remark A position beyond the end wraps around the loop (or stops the music if not looped).
+ */
+static inline void vgs_bgm_seek(uint32_t position) { VGS_IO_VGM_POSITION = position; }
+
+/**
+ * @brief Get the position of the playing background music
+ * @return Song position in samples (44100 = 1 second)
+ */
+static inline uint32_t vgs_bgm_position(void) { return VGS_IO_VGM_POSITION; }
+
+/**
+ * @brief Get the length of the playing background music
+ * @return Song length in samples (44100 = 1 second)
+ */
+static inline uint32_t vgs_bgm_length(void) { return VGS_IN_VGM_LENGTH; }
+
+/**
+ * @brief Get the loop point of the playing background music
+ * @return Song position of the loop point in samples (0 if not looped)
+ */
+static inline uint32_t vgs_bgm_loop_position(void) { return VGS_IN_VGM_LOOP_POSITION; }
+
 #ifdef __cplusplus
 };
 #endif
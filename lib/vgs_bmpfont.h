@@ -77,8 +77,19 @@ static inline void vgs_pfont_set(uint8_t code, int32_t dx, int32_t dy, int32_t w
  * @param pal Palette Number (0 to 1023)
  * @param ptn The starting number for character patterns used in the font.
  * @param text A pointer to a null-terminated buffer containing the string to be displayed.
+ * @return Advance width of the drawn string (in pixels).
  */
-void vgs_pfont_print(uint8_t n, int32_t x, int32_t y, uint16_t pal, uint16_t ptn, const char* text);
+static inline int32_t vgs_pfont_print(uint8_t n, int32_t x, int32_t y, uint16_t pal, uint16_t ptn, const char* text)
+{
+    VGS_VREG_G_BG = n & 3;
+    VGS_VREG_G_X1 = x;
+    VGS_VREG_G_Y1 = y;
+    VGS_VREG_G_COL = pal;
+    VGS_VREG_G_PTN = ptn;
+    VGS_VREG_G_OPT = (uint32_t)text;
+    VGS_VREG_G_EXE = VGS_DRAW_PFONT_STRING;
+    return VGS_VREG_G_ADV;
+}
 
 /**
  * @brief Width of a string displayed in a proportional font (in pixels).
@@ -94,8 +105,18 @@ int32_t vgs_pfont_strlen(const char* text);
  * @param y Y-coordinate
  * @param col RGB888 color format
  * @param sjis A pointer to a null-terminated buffer containing the Shift-JIS string to be displayed.
+ * @return Advance width of the drawn string (in pixels).
  */
-void vgs_k8x12_print(uint8_t n, int32_t x, int32_t y, uint32_t col, const char* sjis);
+static inline int32_t vgs_k8x12_print(uint8_t n, int32_t x, int32_t y, uint32_t col, const char* sjis)
+{
+    VGS_VREG_G_BG = n & 3;
+    VGS_VREG_G_X1 = x;
+    VGS_VREG_G_Y1 = y;
+    VGS_VREG_G_COL = col;
+    VGS_VREG_G_OPT = (uint32_t)sjis;
+    VGS_VREG_G_EXE = VGS_DRAW_K8X12_STRING;
+    return VGS_VREG_G_ADV;
+}
 
 #ifdef __cplusplus
 };
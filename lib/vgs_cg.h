@@ -24,6 +24,7 @@
  */
 #pragma once
 #include "vgs_stdint.h"
+#include "vgs_io.h"
 
 // Name table (256x256)
 // Bit Layout:
@@ -62,9 +63,16 @@ typedef struct {
     uint32_t slx;         // Scale Lock (X)
     uint32_t pri;         // High Priority Flag
     uint32_t ram_ptr;     // Bitmap Sprite Buffer (RGB888)
-    uint32_t reserved[3]; // Reserved (Specify 0 to maintain future compatibility.)
+    uint32_t group;       // Collision Group (bit mask for the sprite hit unit)
+    uint32_t reserved[2]; // Reserved (Specify 0 to maintain future compatibility.)
 } ObjectAttributeMemory;
 
+// Sprite Hit Pair (output of vgs_hit_check in VGS_HIT_MODE_PAIRS)
+typedef struct {
+    uint16_t a; // OAM index of the group A
+    uint16_t b; // OAM index of the group B
+} SpriteHitPair;
+
 #define OAM_MAX 1024
 #define OAM ((ObjectAttributeMemory*)0xD00000)
 
@@ -118,6 +126,8 @@ typedef struct {
 #define VGS_VREG_TR_ADDR *((volatile int32_t*)0xD20098)
 #define VGS_VREG_TR_SIZE *((volatile int32_t*)0xD2009C)
 #define VGS_VREG_TR_TO *((volatile int32_t*)0xD200A0)
+#define VGS_VREG_G_PTN *((volatile uint32_t*)0xD200A4)
+#define VGS_VREG_G_ADV *((volatile int32_t*)0xD200A8)
 
 // Graphic Draw Function Identifer
 #define VGS_DRAW_PIXEL 0
@@ -129,6 +139,8 @@ typedef struct {
 #define VGS_DRAW_JISX0208 6
 #define VGS_DRAW_CLEAR 7
 #define VGS_DRAW_WINDOW 8
+#define VGS_DRAW_K8X12_STRING 9
+#define VGS_DRAW_PFONT_STRING 10
 
 #ifdef __cplusplus
 extern "C" {
@@ -493,6 +505,48 @@ static inline void vgs_sprite_alpha8(ObjectAttributeMemory* oam, uint8_t alpha)
     oam->alpha = alpha24;
 }
 
+/**
+ * @brief Set the group A of the sprite hit unit.
+ * @param first First OAM index (0 to 1023)
+ * @param last Last OAM index (0 to 1023)
+ * @param mask Collision group mask (0: all sprites in the range, otherwise only sprites where `OAM.group & mask` is not zero)
+ */
+static inline void vgs_hit_group_a(uint16_t first, uint16_t last, uint32_t mask)
+{
+    VGS_IO_HIT_A_FIRST = first;
+    VGS_IO_HIT_A_LAST = last;
+    VGS_IO_HIT_A_MASK = mask;
+}
+
+/**
+ * @brief Set the group B of the sprite hit unit.
+ * @param first First OAM index (0 to 1023)
+ * @param last Last OAM index (0 to 1023)
+ * @param mask Collision group mask (0: all sprites in the range, otherwise only sprites where `OAM.group & mask` is not zero)
+ */
+static inline void vgs_hit_group_b(uint16_t first, uint16_t last, uint32_t mask)
+{
+    VGS_IO_HIT_B_FIRST = first;
+    VGS_IO_HIT_B_LAST = last;
+    VGS_IO_HIT_B_MASK = mask;
+}
+
+/**
+ * @brief Detect overlapping sprites between the group A and the group B.
+ * @param mode `VGS_HIT_MODE_RECT` or `VGS_HIT_MODE_PIXEL`, combined with `VGS_HIT_MODE_PAIRS` or `VGS_HIT_MODE_BITMASK`.
+ * @param buffer Output buffer in RAM (`SpriteHitPair[limit]` or `uint32_t[32]` in bitmask mode)
+ * @param limit Maximum number of pairs to write (ignored in bitmask mode)
+ * @return Number of detected pairs (may exceed limit)
+ */
+static inline uint32_t vgs_hit_check(uint32_t mode, void* buffer, uint32_t limit)
+{
+    VGS_IO_HIT_MODE = mode;
+    VGS_IO_HIT_BUFFER = (uint32_t)buffer;
+    VGS_IO_HIT_LIMIT = limit;
+    VGS_IO_HIT_EXECUTE = 0;
+    return VGS_IO_HIT_EXECUTE;
+}
+
 #ifdef __cplusplus
 };
 #endif
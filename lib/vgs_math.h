@@ -24,6 +24,7 @@
  */
 #pragma once
 #include "vgs_stdint.h"
+#include "vgs_io.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -53,6 +54,26 @@ int32_t vgs_sin(int32_t degree);
  */
 int32_t vgs_cos(int32_t degree);
 
+/**
+ * @brief Process a whole int32_t array with the math coprocessor.
+ * @param op Operation (VGS_MATH_SIN, VGS_MATH_COS, VGS_MATH_DEGREE, VGS_MATH_SQRT, VGS_MATH_HYPOT, VGS_MATH_NORMALIZE, VGS_MATH_ROTATE or VGS_MATH_MAC)
+ * @param src Source array (program or RAM)
+ * @param dst Destination array (RAM, can be the same as src)
+ * @param count Number of elements
+ * @param arg Argument of the operation (length of NORMALIZE, degree of ROTATE, or 16.16 coefficient of MAC)
+ * @return Number of processed elements (0: invalid request)
+ * @remark The element layout of each operation is described in the README (Math Array).
+ */
+static inline uint32_t vgs_math_array(uint32_t op, const void* src, void* dst, uint32_t count, int32_t arg)
+{
+    VGS_OUT_MATH_SOURCE = (uint32_t)src;
+    VGS_OUT_MATH_DESTINATION = (uint32_t)dst;
+    VGS_OUT_MATH_COUNT = count;
+    VGS_OUT_MATH_ARGUMENT = arg;
+    VGS_IO_MATH_EXECUTE = op;
+    return VGS_IO_MATH_EXECUTE;
+}
+
 /**
  * @brief Calculate the absolute value of an integer.
  * @param value Target value
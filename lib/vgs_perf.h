@@ -0,0 +1,113 @@
+/**
+ * VGS Standard Library for MC68030
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2025 Yoji Suzuki.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+#include "log.h"
+
+/**
+ * @brief Per-section clock counter (see vgs_perf_begin and vgs_perf_end)
+ */
+typedef struct {
+    const char* name; // Name of the section (printed by vgs_perf_print)
+    uint32_t start;   // Free-running clock counter at vgs_perf_begin
+    uint32_t total;   // Clocks accumulated since vgs_perf_reset
+    uint32_t max;     // Clocks of the longest section
+    uint32_t count;   // Number of the measured sections
+} VgsPerfCounter;
+
+/**
+ * @brief Retrieves the clocks consumed by the CPU in the current frame so far.
+ * @return Clocks since the last vsync
+ */
+static inline uint32_t vgs_perf_clocks() { return VGS_IN_PERF_CLOCKS; }
+
+/**
+ * @brief Retrieves the clocks consumed by the CPU in the previous frame.
+ * @return Clocks of the previous frame
+ */
+static inline uint32_t vgs_perf_last_clocks() { return VGS_IN_PERF_LAST_CLOCKS; }
+
+/**
+ * @brief Retrieves the free-running clock counter of the CPU.
+ * @return Clocks since the program started (lower 32 bits, the difference of two values is valid across the wrap)
+ */
+static inline uint32_t vgs_perf_total_clocks() { return VGS_IN_PERF_TOTAL_CLOCKS; }
+
+/**
+ * @brief Retrieves the time the host spent rendering the previous frame.
+ * @return Microseconds (always 0 while an input movie is recorded or replayed)
+ * @remark The value depends on the host, so use it only for debug displays and not for the game logic.
+ */
+static inline uint32_t vgs_perf_render_time() { return VGS_IN_PERF_RENDER_TIME; }
+
+/**
+ * @brief Clear a per-section clock counter.
+ * @param counter Counter
+ * @param name Name of the section printed by vgs_perf_print
+ */
+static inline void vgs_perf_reset(VgsPerfCounter* counter, const char* name)
+{
+    counter->name = name;
+    counter->start = 0;
+    counter->total = 0;
+    counter->max = 0;
+    counter->count = 0;
+}
+
+/**
+ * @brief Start measuring a section.
+ * @param counter Counter
+ */
+static inline void vgs_perf_begin(VgsPerfCounter* counter) { counter->start = VGS_IN_PERF_TOTAL_CLOCKS; }
+
+/**
+ * @brief Finish measuring a section and accumulate its clocks.
+ * @param counter Counter
+ * @return Clocks of the section
+ */
+static inline uint32_t vgs_perf_end(VgsPerfCounter* counter)
+{
+    uint32_t clocks = VGS_IN_PERF_TOTAL_CLOCKS - counter->start;
+    counter->total += clocks;
+    if (counter->max < clocks) {
+        counter->max = clocks;
+    }
+    counter->count++;
+    return clocks;
+}
+
+/**
+ * @brief Output the accumulated clocks of a counter to the debug console with vgs_putlog.
+ * @param counter Counter
+ * @remark Link liblog.a (-llog) to use this function.
+ */
+static inline void vgs_perf_print(const VgsPerfCounter* counter)
+{
+    vgs_putlog("%s: total %u clocks, %u sections, average %u, maximum %u",
+               counter->name,
+               counter->total,
+               counter->count,
+               counter->count ? counter->total / counter->count : 0,
+               counter->max);
+}
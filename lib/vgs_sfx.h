@@ -53,6 +53,22 @@ static inline void vgs_sfx_play(uint8_t n) { VGS_OUT_SFX_PLAY = n; }
  */
 static inline void vgs_sfx_stop(uint8_t n) { VGS_OUT_SFX_STOP = n; }
 
+/**
+ * @brief Set volume of a sound effect
+ * @param n Number of SFX (0 to 255)
+ * @param v Volume (0 to 255, default: 255)
+ * @remark The volume is kept until reset and also applies to the playing SFX.
+ */
+static inline void vgs_sfx_volume(uint8_t n, uint8_t v) { VGS_OUT_SFX_VOLUME = ((uint32_t)n << 16) | v; }
+
+/**
+ * @brief Set pan of a sound effect
+ * @param n Number of SFX (0 to 255)
+ * @param p Pan (VGS_SFX_PAN_LEFT: 0 to VGS_SFX_PAN_RIGHT: 255, default: VGS_SFX_PAN_CENTER)
+ * @remark The pan is kept until reset and also applies to the playing SFX.
+ */
+static inline void vgs_sfx_pan(uint8_t n, uint8_t p) { VGS_OUT_SFX_PAN = ((uint32_t)n << 16) | p; }
+
 /**
  * @brief Stop the all o0f sound effects
  */
@@ -23,6 +23,7 @@
  * THE SOFTWARE.
  */
 #pragma once
+#include "vgs_io.h"
 #include "vgs_stdint.h"
 
 #ifdef __cplusplus
@@ -147,6 +148,24 @@ char* vgs_strcat(char* dest, const char* src);
  */
 void vgs_sjis_from_utf8(char* dest, const char* src);
 
+/**
+ * @brief Stable sort of fixed-size records in RAM by a big-endian key using DMA
+ * @param base Array of records (must be a RAM Address: 0xF00000 to 0xFFFFFF)
+ * @param count Number of records
+ * @param size Size of a record in bytes (1 to 65535)
+ * @param offset Byte offset of the key in a record (0 to 255)
+ * @param flags `VGS_DMA_SORT_KEY16` or `VGS_DMA_SORT_KEY32`, optionally with `VGS_DMA_SORT_SIGNED` and `VGS_DMA_SORT_DESCENDING`
+ * @remark Records with equal keys keep their original order.
+ * @remark If the key does not fit in the record or the array exceeds RAM, this function will not be executed.
+ */
+static inline void vgs_sort(void* base, uint32_t count, uint32_t size, uint32_t offset, uint32_t flags)
+{
+    VGS_OUT_DMA_DESTINATION = (uint32_t)base;
+    VGS_OUT_DMA_SOURCE = count;
+    VGS_OUT_DMA_ARGUMENT = VGS_DMA_SORT_LAYOUT(size, offset) | flags;
+    VGS_IO_DMA_EXECUTE = VGS_DMA_SORT;
+}
+
 #ifdef __cplusplus
 };
 #endif
@@ -0,0 +1,288 @@
+/**
+ * VGS-X Input Movie
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2025 Yoji Suzuki.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <vector>
+
+// 64-bit hash of a memory block (FNV-1a over 8-byte words): used to compare the frames of the replays
+static inline uint64_t hashMemory(const void* data, size_t size, uint64_t hash = 0xCBF29CE484222325ULL)
+{
+    const uint8_t* ptr = (const uint8_t*)data;
+    for (; 8 <= size; ptr += 8, size -= 8) {
+        uint64_t word;
+        memcpy(&word, ptr, 8);
+        hash = (hash ^ word) * 0x100000001B3ULL;
+        hash ^= hash >> 32;
+    }
+    for (; 0 < size; ptr++, size--) {
+        hash = (hash ^ *ptr) * 0x100000001B3ULL;
+    }
+    return hash;
+}
+
+// Per-frame inputs of a session (gamepad, mouse, wall clock and audio pacing) to replay it deterministically
+// File: "VGSM", version, frames, program hash, then one record per frame holding the changes from the previous frame
+class InputMovie
+{
+  public:
+    static constexpr uint32_t Version = 2;
+
+    struct Frame {
+        uint8_t key[19]; // VGSX::KeyStatus
+        bool mouse;      // VGSX::mouseUpdate was called before the frame
+        bool left;
+        bool right;
+        int32_t mouseX;
+        int32_t mouseY;
+        int32_t scrV;
+        int32_t scrH;
+        int64_t clock;     // time(nullptr) read by the calendar ports during the frame
+        int32_t utcOffset; // seconds east of UTC at the clock (the local calendar does not depend on the replaying host)
+        uint32_t samples; // samples rendered by VGSX::tickSound before the frame (the BGM position is visible to the program)
+    };
+
+    InputMovie() { this->clear(0); }
+
+    void clear(uint64_t programHash)
+    {
+        this->frames.clear();
+        this->position = 0;
+        this->programHash = programHash;
+    }
+
+    inline size_t getFrames() const { return this->frames.size(); }
+    inline size_t getPosition() const { return this->position; }
+    inline uint64_t getProgramHash() const { return this->programHash; }
+    inline void append(const Frame& frame) { this->frames.push_back(frame); }
+
+    inline const Frame* peek() const { return this->position < this->frames.size() ? &this->frames[this->position] : nullptr; }
+
+    // read the next frame of the replay (false: end of the movie)
+    bool next(Frame& frame)
+    {
+        if (this->frames.size() <= this->position) {
+            return false;
+        }
+        frame = this->frames[this->position++];
+        return true;
+    }
+
+    void save(std::vector<uint8_t>& out) const
+    {
+        out.clear();
+        out.insert(out.end(), {'V', 'G', 'S', 'M'});
+        putU32(out, Version);
+        putU32(out, (uint32_t)this->frames.size());
+        putU32(out, (uint32_t)this->programHash);
+        putU32(out, (uint32_t)(this->programHash >> 32));
+        Frame prev;
+        memset(&prev, 0, sizeof(prev));
+        for (const auto& frame : this->frames) {
+            uint32_t keyMask = 0;
+            for (int i = 0; i < (int)sizeof(frame.key); i++) {
+                keyMask |= frame.key[i] != prev.key[i] ? 1U << i : 0;
+            }
+            const bool mouseMoved = frame.mouse && (frame.mouseX != prev.mouseX || frame.mouseY != prev.mouseY || frame.scrV != prev.scrV || frame.scrH != prev.scrH || frame.left != prev.left || frame.right != prev.right);
+            uint8_t flags = 0;
+            flags |= keyMask ? FlagKey : 0;
+            flags |= frame.mouse ? FlagMouse : 0;
+            flags |= mouseMoved ? FlagMouseMoved : 0;
+            flags |= frame.clock != prev.clock ? FlagClock : 0;
+            flags |= frame.samples != prev.samples ? FlagSamples : 0;
+            flags |= frame.utcOffset != prev.utcOffset ? FlagUtcOffset : 0;
+            out.push_back(flags);
+            if (keyMask) {
+                putVarint(out, keyMask);
+                for (int i = 0; i < (int)sizeof(frame.key); i++) {
+                    if (keyMask & (1U << i)) {
+                        out.push_back(frame.key[i]);
+                    }
+                }
+            }
+            if (mouseMoved) {
+                putVarint(out, zigzag((int64_t)frame.mouseX - prev.mouseX));
+                putVarint(out, zigzag((int64_t)frame.mouseY - prev.mouseY));
+                putVarint(out, zigzag(frame.scrV));
+                putVarint(out, zigzag(frame.scrH));
+                out.push_back((frame.left ? 1 : 0) | (frame.right ? 2 : 0));
+            }
+            if (frame.clock != prev.clock) {
+                putVarint(out, zigzag(frame.clock - prev.clock));
+            }
+            if (frame.samples != prev.samples) {
+                putVarint(out, zigzag((int64_t)frame.samples - prev.samples));
+            }
+            if (frame.utcOffset != prev.utcOffset) {
+                putVarint(out, zigzag(frame.utcOffset));
+            }
+            Frame next = frame;
+            if (!frame.mouse) {
+                // keep the arguments of the last VGSX::mouseUpdate as the base of the next delta
+                next.mouseX = prev.mouseX;
+                next.mouseY = prev.mouseY;
+                next.scrV = prev.scrV;
+                next.scrH = prev.scrH;
+                next.left = prev.left;
+                next.right = prev.right;
+            }
+            prev = next;
+        }
+    }
+
+    // returns an error message or nullptr
+    const char* load(const void* data, size_t size)
+    {
+        const uint8_t* ptr = (const uint8_t*)data;
+        const uint8_t* end = ptr + size;
+        if (!data || size < 20 || 0 != memcmp(ptr, "VGSM", 4)) {
+            return "Not a movie file.";
+        }
+        ptr += 4;
+        if (Version != getU32(ptr)) {
+            return "Unsupported movie version.";
+        }
+        const uint32_t count = getU32(ptr);
+        uint64_t hash = getU32(ptr);
+        hash |= (uint64_t)getU32(ptr) << 32;
+        std::vector<Frame> frames;
+        frames.reserve(count < 0x100000 ? count : 0x100000);
+        Frame frame;
+        memset(&frame, 0, sizeof(frame));
+        for (uint32_t n = 0; n < count; n++) {
+            if (end <= ptr) {
+                return "Truncated movie file.";
+            }
+            const uint8_t flags = *ptr++;
+            if (flags & FlagKey) {
+                uint64_t keyMask;
+                if (!getVarint(ptr, end, keyMask) || (1U << sizeof(frame.key)) <= keyMask) {
+                    return "Broken movie file.";
+                }
+                for (int i = 0; i < (int)sizeof(frame.key); i++) {
+                    if (keyMask & (1U << i)) {
+                        if (end <= ptr) {
+                            return "Truncated movie file.";
+                        }
+                        frame.key[i] = *ptr++;
+                    }
+                }
+            }
+            frame.mouse = 0 != (flags & FlagMouse);
+            if (flags & FlagMouseMoved) {
+                uint64_t dx, dy, v, h;
+                if (!getVarint(ptr, end, dx) || !getVarint(ptr, end, dy) || !getVarint(ptr, end, v) || !getVarint(ptr, end, h) || end <= ptr) {
+                    return "Truncated movie file.";
+                }
+                frame.mouseX = (int32_t)((uint32_t)frame.mouseX + (uint32_t)unzigzag(dx));
+                frame.mouseY = (int32_t)((uint32_t)frame.mouseY + (uint32_t)unzigzag(dy));
+                frame.scrV = (int32_t)unzigzag(v);
+                frame.scrH = (int32_t)unzigzag(h);
+                frame.left = 0 != (*ptr & 1);
+                frame.right = 0 != (*ptr & 2);
+                ptr++;
+            }
+            if (flags & FlagClock) {
+                uint64_t delta;
+                if (!getVarint(ptr, end, delta)) {
+                    return "Truncated movie file.";
+                }
+                frame.clock = (int64_t)((uint64_t)frame.clock + (uint64_t)unzigzag(delta));
+            }
+            if (flags & FlagSamples) {
+                uint64_t delta;
+                if (!getVarint(ptr, end, delta)) {
+                    return "Truncated movie file.";
+                }
+                frame.samples = (uint32_t)(frame.samples + (uint32_t)unzigzag(delta));
+            }
+            if (flags & FlagUtcOffset) {
+                uint64_t offset;
+                if (!getVarint(ptr, end, offset)) {
+                    return "Truncated movie file.";
+                }
+                frame.utcOffset = (int32_t)unzigzag(offset);
+            }
+            frames.push_back(frame);
+        }
+        this->frames.swap(frames);
+        this->position = 0;
+        this->programHash = hash;
+        return nullptr;
+    }
+
+  private:
+    static constexpr uint8_t FlagKey = 0x01;
+    static constexpr uint8_t FlagMouse = 0x02;
+    static constexpr uint8_t FlagMouseMoved = 0x04;
+    static constexpr uint8_t FlagClock = 0x08;
+    static constexpr uint8_t FlagSamples = 0x10;
+    static constexpr uint8_t FlagUtcOffset = 0x20;
+
+    std::vector<Frame> frames;
+    size_t position;
+    uint64_t programHash;
+
+    static uint64_t zigzag(int64_t value) { return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63); }
+    static int64_t unzigzag(uint64_t value) { return (int64_t)(value >> 1) ^ -(int64_t)(value & 1); }
+
+    static void putU32(std::vector<uint8_t>& out, uint32_t value)
+    {
+        out.insert(out.end(), {(uint8_t)value, (uint8_t)(value >> 8), (uint8_t)(value >> 16), (uint8_t)(value >> 24)});
+    }
+
+    static uint32_t getU32(const uint8_t*& ptr)
+    {
+        const uint32_t value = ptr[0] | ptr[1] << 8 | ptr[2] << 16 | (uint32_t)ptr[3] << 24;
+        ptr += 4;
+        return value;
+    }
+
+    static void putVarint(std::vector<uint8_t>& out, uint64_t value)
+    {
+        while (0x80 <= value) {
+            out.push_back((uint8_t)(value | 0x80));
+            value >>= 7;
+        }
+        out.push_back((uint8_t)value);
+    }
+
+    static bool getVarint(const uint8_t*& ptr, const uint8_t* end, uint64_t& value)
+    {
+        value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            if (end <= ptr) {
+                return false;
+            }
+            const uint8_t byte = *ptr++;
+            value |= (uint64_t)(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) {
+                return true;
+            }
+        }
+        return false;
+    }
+};
@@ -0,0 +1,316 @@
+/**
+ * VGS-X Rewind Buffer
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2025 Yoji Suzuki.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <algorithm>
+#include <deque>
+#include <vector>
+
+// 4KB pages of a memory region written since the last clear (marked by every writer of the region)
+template <size_t Size>
+class DirtyPages
+{
+  public:
+    static constexpr size_t PageSize = 4096;
+    static constexpr size_t Pages = (Size + PageSize - 1) / PageSize;
+    uint64_t bits[(Pages + 63) / 64];
+
+    DirtyPages() { this->markAll(); }
+
+    inline void mark(size_t offset)
+    {
+        const size_t page = offset / PageSize;
+        if (page < Pages) {
+            this->bits[page >> 6] |= 1ULL << (page & 63);
+        }
+    }
+
+    inline void mark(size_t offset, size_t size)
+    {
+        for (size_t page = offset / PageSize; 0 < size && page <= (offset + size - 1) / PageSize && page < Pages; page++) {
+            this->bits[page >> 6] |= 1ULL << (page & 63);
+        }
+    }
+
+    inline void markAll() { memset(this->bits, 0xFF, sizeof(this->bits)); }
+};
+
+// Rewind history: each frame is kept as the XOR delta from the previous frame (written pages only, zero runs compressed)
+// The latest frame is kept as a plain copy, so a frame is restored by applying a single delta to it (no keyframes).
+class RewindBuffer
+{
+  public:
+    static constexpr size_t PageSize = 4096;
+
+    RewindBuffer()
+    {
+        this->limit = 0;
+        this->memory = 0;
+        this->anchored = false;
+    }
+
+    // register a memory region recorded page by page (dirty: bitmap of the written pages, cleared by push and pop)
+    void addRegion(uint8_t* data, size_t size, uint64_t* dirty)
+    {
+        Region region;
+        region.data = data;
+        region.size = size;
+        region.pages = (size + PageSize - 1) / PageSize;
+        region.dirty = dirty;
+        this->regions.push_back(region);
+        this->anchored = false;
+    }
+
+    // maximum size of the deltas (the oldest frames are dropped first)
+    void setLimit(size_t bytes)
+    {
+        this->limit = bytes;
+        this->trim();
+    }
+
+    void clear()
+    {
+        this->entries.clear();
+        this->memory = 0;
+        this->anchored = false;
+        for (auto& region : this->regions) {
+            std::vector<uint8_t>().swap(region.shadow);
+        }
+        std::vector<uint8_t>().swap(this->shadowCore);
+    }
+
+    inline size_t getFrames() const { return this->entries.size(); }
+    inline size_t getMemory() const { return this->memory; }
+
+    // record the current frame (core: serialized state other than the regions)
+    void push(const std::vector<uint8_t>& core)
+    {
+        if (!this->anchored) {
+            for (auto& region : this->regions) {
+                region.shadow.assign(region.data, region.data + region.size);
+                memset(region.dirty, 0, (region.pages + 63) / 64 * sizeof(uint64_t));
+            }
+            this->shadowCore = core;
+            this->anchored = true;
+            return;
+        }
+        auto& work = this->work;
+        work.clear();
+        for (size_t r = 0; r < this->regions.size(); r++) {
+            auto& region = this->regions[r];
+            for (size_t w = 0; w < (region.pages + 63) / 64; w++) {
+                for (size_t bit = 0; bit < 64 && (region.dirty[w] >> bit); bit++) {
+                    const size_t page = w * 64 + bit;
+                    if (!(region.dirty[w] & (1ULL << bit)) || region.pages <= page) {
+                        continue;
+                    }
+                    const size_t offset = page * PageSize;
+                    const size_t size = std::min(PageSize, region.size - offset);
+                    if (0 == memcmp(&region.data[offset], &region.shadow[offset], size)) {
+                        continue;
+                    }
+                    work.push_back((uint8_t)r);
+                    putU32(work, (uint32_t)page);
+                    encode(&region.data[offset], &region.shadow[offset], size, work);
+                    memcpy(&region.shadow[offset], &region.data[offset], size);
+                }
+                region.dirty[w] = 0;
+            }
+        }
+
+        // the core is compared with the previous one padded with zero to the longer size
+        const size_t size = std::max(core.size(), this->shadowCore.size());
+        work.push_back(CoreRecord);
+        putU32(work, (uint32_t)core.size());
+        putU32(work, (uint32_t)this->shadowCore.size());
+        this->coreWork.assign(core.begin(), core.end());
+        this->coreWork.resize(size, 0);
+        this->shadowCore.resize(size, 0);
+        encode(this->coreWork.data(), this->shadowCore.data(), size, work);
+        this->shadowCore.assign(core.begin(), core.end());
+
+        this->entries.emplace_back(work.begin(), work.end());
+        this->memory += work.size();
+        this->trim();
+    }
+
+    // restore the frame before the latest one into the regions and the core (false: no history)
+    bool pop(std::vector<uint8_t>& core)
+    {
+        if (!this->anchored || this->entries.empty()) {
+            return false;
+        }
+
+        // revert the pages written after the latest frame was recorded
+        for (auto& region : this->regions) {
+            for (size_t w = 0; w < (region.pages + 63) / 64; w++) {
+                for (size_t bit = 0; bit < 64 && (region.dirty[w] >> bit); bit++) {
+                    const size_t page = w * 64 + bit;
+                    if ((region.dirty[w] & (1ULL << bit)) && page < region.pages) {
+                        const size_t offset = page * PageSize;
+                        memcpy(&region.data[offset], &region.shadow[offset], std::min(PageSize, region.size - offset));
+                    }
+                }
+                region.dirty[w] = 0;
+            }
+        }
+
+        // apply the delta of the latest frame to the copy and to the regions
+        const auto& entry = this->entries.back();
+        const uint8_t* ptr = entry.data();
+        while (CoreRecord != *ptr) {
+            auto& region = this->regions[*ptr++];
+            const size_t offset = getU32(ptr) * PageSize;
+            const size_t size = std::min(PageSize, region.size - offset);
+            ptr = decode(ptr, &region.shadow[offset], size);
+            memcpy(&region.data[offset], &region.shadow[offset], size);
+        }
+        ptr++;
+        const size_t size = getU32(ptr);
+        const size_t previousSize = getU32(ptr);
+        this->shadowCore.resize(std::max(size, previousSize), 0);
+        decode(ptr, this->shadowCore.data(), this->shadowCore.size());
+        this->shadowCore.resize(previousSize);
+        core = this->shadowCore;
+
+        this->memory -= entry.size();
+        this->entries.pop_back();
+        return true;
+    }
+
+  private:
+    static constexpr uint8_t CoreRecord = 0xFF;
+
+    struct Region {
+        uint8_t* data;
+        size_t size;
+        size_t pages;
+        uint64_t* dirty;
+        std::vector<uint8_t> shadow; // contents at the latest frame
+    };
+
+    std::vector<Region> regions;
+    std::vector<uint8_t> shadowCore;
+    std::deque<std::vector<uint8_t>> entries; // the newest frame is at the back
+    std::vector<uint8_t> work;
+    std::vector<uint8_t> coreWork;
+    size_t limit;
+    size_t memory;
+    bool anchored;
+
+    void trim()
+    {
+        while (this->limit < this->memory && !this->entries.empty()) {
+            this->memory -= this->entries.front().size();
+            this->entries.pop_front();
+        }
+    }
+
+    static void putU32(std::vector<uint8_t>& out, uint32_t value)
+    {
+        out.insert(out.end(), {(uint8_t)value, (uint8_t)(value >> 8), (uint8_t)(value >> 16), (uint8_t)(value >> 24)});
+    }
+
+    static uint32_t getU32(const uint8_t*& ptr)
+    {
+        const uint32_t value = ptr[0] | ptr[1] << 8 | ptr[2] << 16 | (uint32_t)ptr[3] << 24;
+        ptr += 4;
+        return value;
+    }
+
+    static void putVarint(std::vector<uint8_t>& out, size_t value)
+    {
+        while (0x80 <= value) {
+            out.push_back((uint8_t)(value | 0x80));
+            value >>= 7;
+        }
+        out.push_back((uint8_t)value);
+    }
+
+    static size_t getVarint(const uint8_t*& ptr)
+    {
+        size_t value = 0;
+        for (int shift = 0;; shift += 7) {
+            const uint8_t byte = *ptr++;
+            value |= (size_t)(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) {
+                return value;
+            }
+        }
+    }
+
+    // a XOR b as the pairs of (equal bytes to skip, differing bytes to store)
+    static void encode(const uint8_t* a, const uint8_t* b, size_t size, std::vector<uint8_t>& out)
+    {
+        size_t i = 0;
+        while (i < size) {
+            size_t start = i;
+            uint64_t wa, wb;
+            while (start + 8 <= size && (memcpy(&wa, &a[start], 8), memcpy(&wb, &b[start], 8), wa == wb)) {
+                start += 8;
+            }
+            while (start < size && a[start] == b[start]) {
+                start++;
+            }
+            putVarint(out, start - i);
+            if (start == size) {
+                putVarint(out, 0);
+                return;
+            }
+
+            // the literal ends at a run of 8 equal bytes
+            size_t end = start;
+            size_t same = 0;
+            while (end < size && same < 8) {
+                same = a[end] == b[end] ? same + 1 : 0;
+                end++;
+            }
+            end -= same;
+            putVarint(out, end - start);
+            for (size_t n = start; n < end; n++) {
+                out.push_back(a[n] ^ b[n]);
+            }
+            i = end;
+        }
+    }
+
+    // XOR the delta into dst (returns the end of the delta)
+    static const uint8_t* decode(const uint8_t* ptr, uint8_t* dst, size_t size)
+    {
+        size_t i = 0;
+        while (i < size) {
+            i += getVarint(ptr);
+            const size_t length = getVarint(ptr);
+            for (size_t n = 0; n < length; n++) {
+                dst[i + n] ^= ptr[n];
+            }
+            ptr += length;
+            i += length;
+        }
+        return ptr;
+    }
+};
@@ -0,0 +1,142 @@
+/**
+ * VGS-X Frame Telemetry
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2025 Yoji Suzuki.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+#include <stdint.h>
+#include <string.h>
+#include <chrono>
+
+// Per-frame telemetry: counters and timed spans of a frame, handed over to the host by VGSX::setTelemetryCallback
+// A record covers a VGSX::tick and the host work until the next tick (sound, present).
+class Telemetry
+{
+  public:
+    static constexpr int MaxSpans = 32;
+
+    enum class Span : uint8_t {
+        Tick,          // VGSX::tick (CPU and render)
+        Cpu,           // MC68030 until the V-SYNC read
+        Render,        // VGSX::render
+        RenderBG,      // VDP::renderBG (arg: BG number)
+        RenderSprites, // VDP::renderSprites
+        TickSound,     // VGSX::tickSound
+        Present,       // reported by the host (VGSX::reportPresent)
+    };
+
+    struct SpanRecord {
+        Span span;
+        uint8_t arg;
+        uint64_t begin; // nanoseconds (Telemetry::now)
+        uint64_t end;
+    };
+
+    struct Frame {
+        uint32_t frame;       // sequence number of the tick
+        bool speculative;     // ticked as speculative (rolled back by run-ahead)
+        uint32_t cpuClocks;   // VGSX::ctx.frameClocks
+        uint64_t cpuNanos;    // host time of the spans by kind
+        uint64_t renderNanos;
+        uint64_t soundNanos;
+        uint64_t presentNanos;
+        uint32_t inPorts;  // I/O port reads
+        uint32_t outPorts; // I/O port writes
+        uint32_t dmaBytes; // bytes written by DMA copy, set and sort
+        uint32_t sprites;  // sprites drawn by VDP::renderSprites
+        int spanCount;
+        SpanRecord spans[MaxSpans];
+    };
+
+    bool enabled;
+    Frame frame;
+
+    Telemetry()
+    {
+        this->enabled = false;
+        this->restart();
+    }
+
+    static inline uint64_t now()
+    {
+        return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // start recording from frame 0
+    void restart()
+    {
+        this->sequence = 0;
+        this->clear();
+    }
+
+    // start the record of the next tick
+    void clear()
+    {
+        memset(&this->frame, 0, sizeof(this->frame));
+        this->frame.frame = this->sequence++;
+        this->ticked = false;
+    }
+
+    // the record holds a tick (the host work before the first tick belongs to its record)
+    inline bool isTicked() const { return this->ticked; }
+
+    // record a span from begin to now and return now (the begin of the next span)
+    uint64_t span(Span span, uint64_t begin, uint8_t arg = 0)
+    {
+        const uint64_t end = now();
+        const uint64_t nanos = end - begin;
+        switch (span) {
+            case Span::Cpu: this->frame.cpuNanos += nanos; break;
+            case Span::Render: this->frame.renderNanos += nanos; break;
+            case Span::TickSound: this->frame.soundNanos += nanos; break;
+            case Span::Present: this->frame.presentNanos += nanos; break;
+            case Span::Tick: this->ticked = true; break;
+            default: break;
+        }
+        if (this->frame.spanCount < MaxSpans) {
+            auto& record = this->frame.spans[this->frame.spanCount++];
+            record.span = span;
+            record.arg = arg;
+            record.begin = begin;
+            record.end = end;
+        }
+        return end;
+    }
+
+    static const char* name(Span span)
+    {
+        switch (span) {
+            case Span::Tick: return "tick";
+            case Span::Cpu: return "cpu";
+            case Span::Render: return "render";
+            case Span::RenderBG: return "renderBG";
+            case Span::RenderSprites: return "renderSprites";
+            case Span::TickSound: return "tickSound";
+            case Span::Present: return "present";
+        }
+        return "unknown";
+    }
+
+  private:
+    uint32_t sequence;
+    bool ticked;
+};
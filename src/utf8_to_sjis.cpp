@@ -23,10 +23,15 @@
  * THE SOFTWARE.
  */
 #include "utf8_to_sjis.h"
-#include <stdio.h>
-#include <map>
+#include <stddef.h>
 
-static std::map<uint32_t, uint32_t> codeMap = {
+struct CodePair {
+    uint32_t utf8;
+    uint32_t sjis;
+};
+
+// UTF-8 (packed big-endian byte sequence) -> SJIS pairs (must be sorted by utf8)
+static constexpr CodePair codePairs[] = {
     {0x20, 0x20},
     {0x21, 0x21},
     {0x22, 0x22},
@@ -13142,8 +13147,96 @@ static std::map<uint32_t, uint32_t> codeMap = {
     {0xEFBFA5, 0x818F},
 };
 
+static constexpr size_t codePairCount = sizeof(codePairs) / sizeof(codePairs[0]);
+static constexpr uint32_t invalidCodePoint = 0xFFFFFFFF;
+
+// Decode a packed UTF-8 byte sequence to a BMP code point (rejects malformed and overlong forms)
+static constexpr uint32_t decodeUtf8(uint32_t utf8)
+{
+    if (utf8 < 0x80) {
+        return utf8;
+    } else if (utf8 < 0x10000) {
+        const uint32_t b0 = utf8 >> 8;
+        const uint32_t b1 = utf8 & 0xFF;
+        if ((b0 & 0xE0) != 0xC0 || (b1 & 0xC0) != 0x80) {
+            return invalidCodePoint;
+        }
+        const uint32_t cp = ((b0 & 0x1F) << 6) | (b1 & 0x3F);
+        return cp < 0x80 ? invalidCodePoint : cp;
+    } else if (utf8 < 0x1000000) {
+        const uint32_t b0 = utf8 >> 16;
+        const uint32_t b1 = (utf8 >> 8) & 0xFF;
+        const uint32_t b2 = utf8 & 0xFF;
+        if ((b0 & 0xF0) != 0xE0 || (b1 & 0xC0) != 0x80 || (b2 & 0xC0) != 0x80) {
+            return invalidCodePoint;
+        }
+        const uint32_t cp = ((b0 & 0x0F) << 12) | ((b1 & 0x3F) << 6) | (b2 & 0x3F);
+        return cp < 0x800 ? invalidCodePoint : cp;
+    }
+    return invalidCodePoint; // 4 bytes sequences are out of the JIS range
+}
+
+static constexpr bool isSortedCodePairs()
+{
+    for (size_t i = 1; i < codePairCount; i++) {
+        if (codePairs[i].utf8 <= codePairs[i - 1].utf8) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static_assert(isSortedCodePairs(), "codePairs must be sorted by utf8 without duplicates");
+
+// Number of the 256 code points blocks (high byte of the code point) that have at least one mapping
+static constexpr size_t countCodeBlocks()
+{
+    bool used[0x100] = {};
+    size_t result = 0;
+    for (size_t i = 0; i < codePairCount; i++) {
+        const uint32_t cp = decodeUtf8(codePairs[i].utf8);
+        if (cp != invalidCodePoint && !used[cp >> 8]) {
+            used[cp >> 8] = true;
+            result++;
+        }
+    }
+    return result;
+}
+
+static constexpr size_t codeBlockCount = countCodeBlocks() + 1; // block 0 is the empty block
+
+// Two-level lookup table: code point high byte -> block, code point low byte -> SJIS
+struct CodeTable {
+    uint8_t block[0x100];
+    uint16_t sjis[codeBlockCount][0x100];
+};
+
+static_assert(codeBlockCount <= 0x100, "too many code blocks");
+
+static constexpr CodeTable makeCodeTable()
+{
+    CodeTable table = {};
+    size_t next = 1;
+    for (size_t i = 0; i < codePairCount; i++) {
+        const uint32_t cp = decodeUtf8(codePairs[i].utf8);
+        if (cp == invalidCodePoint) {
+            continue; // unreachable from a well-formed UTF-8 string
+        }
+        if (0 == table.block[cp >> 8]) {
+            table.block[cp >> 8] = static_cast<uint8_t>(next++);
+        }
+        table.sjis[table.block[cp >> 8]][cp & 0xFF] = static_cast<uint16_t>(codePairs[i].sjis);
+    }
+    return table;
+}
+
+static constexpr CodeTable codeTable = makeCodeTable();
+
 uint32_t utf8_to_sjis(uint32_t utf8)
 {
-    auto it = codeMap.find(utf8);
-    return it == codeMap.end() ? 0 : it->second;
+    const uint32_t cp = decodeUtf8(utf8);
+    if (cp > 0xFFFF) {
+        return 0;
+    }
+    return codeTable.sjis[codeTable.block[cp >> 8]][cp & 0xFF];
 }
@@ -30,6 +30,11 @@
 #include <string.h>
 #include <math.h>
 #include <ctype.h>
+#include <algorithm>
+#include <utility>
+#include <vector>
+#include "rewind.hpp"
+#include "telemetry.hpp"
 
 #define VDP_BG_NUM 4   /* Number of the BG plan */
 #define VDP_WIDTH 320  /* Width of the Screen */
@@ -69,6 +74,8 @@ static inline void graphicDrawJisX0201(VDP* vdp);
 static inline void graphicDrawJisX0208(VDP* vdp);
 static inline void graphicDrawClear(VDP* vdp);
 static inline void graphicDrawWindow(VDP* vdp);
+static inline void graphicDrawK8x12String(VDP* vdp);
+static inline void graphicDrawPropotionalString(VDP* vdp);
 
 class VDP
 {
@@ -98,6 +105,28 @@ class VDP
         size_t palSize;
     } rom;
 
+    uint64_t ptnModified[65536 / 64]; // character patterns rewritten after reset (bitmap)
+
+    void markPatternModified(uint32_t index, uint32_t count)
+    {
+        for (uint32_t i = index; i < index + count && i < 0x10000; i++) {
+            this->ptnModified[i >> 6] |= 1ULL << (i & 63);
+        }
+        this->ptnDirty.mark(index * 32, count * 32);
+    }
+
+    // restore a character pattern to the state just after reset (ROM or zero)
+    void restorePattern(uint32_t index)
+    {
+        memset(this->ctx.ptn[index], 0, 32);
+        for (auto ptn : this->rom.ptn) {
+            if ((uint32_t)ptn->index <= index && index < (uint32_t)ptn->index + (uint32_t)(ptn->size + 31) / 32) {
+                const int offset = (int)(index - ptn->index) * 32;
+                memcpy(this->ctx.ptn[index], ptn->ptn + offset, std::min(32, ptn->size - offset));
+            }
+        }
+    }
+
     void resetPattern()
     {
         for (auto ptn : this->rom.ptn) {
@@ -243,7 +272,9 @@ class VDP
         uint32_t tr_addr;             // R38: Transfer Character Pattern (address)
         uint32_t tr_size;             // R39: Transfer Character Pattern (size)
         uint32_t tr_to;               // R40: Transfer Character Pattern (to)
-        uint32_t reserved[215];       // Reserved (Specify 0 to maintain future compatibility.)
+        uint32_t g_ptn;               // R41: Graphic Draw - Pattern base of the Propotional Font string
+        uint32_t g_adv;               // R42: Graphic Draw - Advance width of the last string (pixels)
+        uint32_t reserved[213];       // Reserved (Specify 0 to maintain future compatibility.)
     } Register;
 
     static constexpr uint32_t kVdpRegisterFirstReservedIndex =
@@ -270,7 +301,8 @@ class VDP
         uint32_t slx;         // Scale Lock (X)
         uint32_t pri;         // High Priority Flag
         uint32_t ram_ptr;     // Bitmap Sprite Buffer (RGB888)
-        uint32_t reserved[3]; // Reserved (Specify 0 to maintain future compatibility.)
+        uint32_t group;       // Collision Group (bit mask for the sprite hit unit)
+        uint32_t reserved[2]; // Reserved (Specify 0 to maintain future compatibility.)
     } OAM;
 
     static constexpr int kSpriteScaleMaxPercent = 3200;
@@ -299,13 +331,23 @@ class VDP
         int wy2[VDP_BG_NUM];                  // BG Window Y2
     } ctx;
 
+    // pages written since the last rewind frame
+    DirtyPages<sizeof(Context::ptn)> ptnDirty;
+    DirtyPages<sizeof(Context::nametbl)> nametblDirty;
+    DirtyPages<sizeof(Context::oam)> oamDirty;
+
+    Telemetry* telemetry; // spans of renderBG and renderSprites (nullptr: not recorded)
+
     VDP()
     {
+        this->telemetry = nullptr;
         this->rom.ptn.clear();
         this->rom.pal = nullptr;
         this->rom.palSize = 0;
         this->cpu_rom = nullptr;
         this->cpu_ram = nullptr;
+        memset(&this->ctx, 0, sizeof(this->ctx));
+        memset(this->ptnModified, 0, sizeof(this->ptnModified));
     }
 
     void setCpuRom(const uint8_t* cpu_rom, size_t cpu_rom_size)
@@ -319,6 +361,152 @@ class VDP
         this->cpu_ram = cpu_ram;
     }
 
+    // Resolve a NUL-terminated string placed in the program (ROM) or RAM.
+    // Returns nullptr if the address is invalid, otherwise limit is set to the readable size.
+    const uint8_t* resolveString(uint32_t addr, size_t* limit)
+    {
+        addr &= 0x00FFFFFF;
+        if (addr < 0xC00000) {
+            if (!cpu_rom || cpu_rom_size <= addr) {
+                return nullptr;
+            }
+            *limit = cpu_rom_size - addr;
+            return &cpu_rom[addr];
+        } else if (0xF00000 <= addr) {
+            if (!cpu_ram) {
+                return nullptr;
+            }
+            addr &= 0x0FFFFF;
+            *limit = 0x100000 - addr;
+            return &cpu_ram[addr];
+        }
+        return nullptr;
+    }
+
+    typedef struct {
+        uint16_t aFirst; // Group A: first OAM index
+        uint16_t aLast;  // Group A: last OAM index
+        uint16_t bFirst; // Group B: first OAM index
+        uint16_t bLast;  // Group B: last OAM index
+        uint32_t aMask;  // Group A: collision group mask (0: all)
+        uint32_t bMask;  // Group B: collision group mask (0: all)
+        bool pixel;      // Pixel exact test (false: rectangle only)
+    } HitQuery;
+
+    typedef std::pair<uint16_t, uint16_t> HitPair;
+
+    // Detect overlapping sprites between group A and group B.
+    // Each pair is reported once in ascending order of (A, B).
+    void detectSpriteHits(const HitQuery& query, std::vector<HitPair>& hits)
+    {
+        hits.clear();
+        auto& rectsA = this->hitWork.rectsA;
+        auto& rectsB = this->hitWork.rectsB;
+        rectsA.clear();
+        rectsB.clear();
+        HitRect r;
+        for (int i = query.aFirst; i <= query.aLast && i < 1024; i++) {
+            if (this->isHitGroup(i, query.aMask) && this->makeHitRect(i, &r)) {
+                rectsA.push_back(r);
+            }
+        }
+        for (int i = query.bFirst; i <= query.bLast && i < 1024; i++) {
+            if (this->isHitGroup(i, query.bMask) && this->makeHitRect(i, &r)) {
+                rectsB.push_back(r);
+            }
+        }
+        if (rectsA.empty() || rectsB.empty()) {
+            return;
+        }
+
+        // Broadphase: register group B to a uniform grid that covers the bounding box of group B
+        int32_t gx1 = rectsB[0].x1, gy1 = rectsB[0].y1, gx2 = rectsB[0].x2, gy2 = rectsB[0].y2;
+        for (const auto& b : rectsB) {
+            gx1 = std::min(gx1, b.x1);
+            gy1 = std::min(gy1, b.y1);
+            gx2 = std::max(gx2, b.x2);
+            gy2 = std::max(gy2, b.y2);
+        }
+        int shift = 5; // 32x32 pixels per cell
+        while (kHitGridMaxCells < (((gx2 - gx1) >> shift) + 1) * (((gy2 - gy1) >> shift) + 1)) {
+            shift++;
+        }
+        const int gw = ((gx2 - gx1) >> shift) + 1;
+        const int gh = ((gy2 - gy1) >> shift) + 1;
+        auto& cellStart = this->hitWork.cellStart;
+        auto& cellItems = this->hitWork.cellItems;
+        cellStart.assign(gw * gh + 1, 0);
+        for (const auto& b : rectsB) {
+            for (int cy = (b.y1 - gy1) >> shift; cy <= (b.y2 - 1 - gy1) >> shift; cy++) {
+                for (int cx = (b.x1 - gx1) >> shift; cx <= (b.x2 - 1 - gx1) >> shift; cx++) {
+                    cellStart[cy * gw + cx + 1]++;
+                }
+            }
+        }
+        for (int i = 0; i < gw * gh; i++) {
+            cellStart[i + 1] += cellStart[i];
+        }
+        cellItems.resize(cellStart[gw * gh]);
+        auto& cellFill = this->hitWork.cellFill;
+        cellFill.assign(cellStart.begin(), cellStart.end() - 1);
+        for (size_t n = 0; n < rectsB.size(); n++) {
+            const auto& b = rectsB[n];
+            for (int cy = (b.y1 - gy1) >> shift; cy <= (b.y2 - 1 - gy1) >> shift; cy++) {
+                for (int cx = (b.x1 - gx1) >> shift; cx <= (b.x2 - 1 - gx1) >> shift; cx++) {
+                    cellItems[cellFill[cy * gw + cx]++] = (uint16_t)n;
+                }
+            }
+        }
+
+        // Narrowphase
+        auto& visited = this->hitWork.visited;
+        auto& found = this->hitWork.found;
+        visited.assign(rectsB.size(), -1);
+        for (size_t an = 0; an < rectsA.size(); an++) {
+            const auto& a = rectsA[an];
+            if (a.x2 <= gx1 || gx2 <= a.x1 || a.y2 <= gy1 || gy2 <= a.y1) {
+                continue;
+            }
+            const int cx1 = std::max(0, (a.x1 - gx1) >> shift);
+            const int cy1 = std::max(0, (a.y1 - gy1) >> shift);
+            const int cx2 = std::min(gw - 1, (a.x2 - 1 - gx1) >> shift);
+            const int cy2 = std::min(gh - 1, (a.y2 - 1 - gy1) >> shift);
+            found.clear();
+            for (int cy = cy1; cy <= cy2; cy++) {
+                for (int cx = cx1; cx <= cx2; cx++) {
+                    const int cell = cy * gw + cx;
+                    for (uint32_t k = cellStart[cell]; k < cellStart[cell + 1]; k++) {
+                        const int bn = cellItems[k];
+                        if (visited[bn] == (int)an) {
+                            continue;
+                        }
+                        visited[bn] = (int)an;
+                        const auto& b = rectsB[bn];
+                        if (a.index == b.index) {
+                            continue;
+                        }
+                        if (a.x2 <= b.x1 || b.x2 <= a.x1 || a.y2 <= b.y1 || b.y2 <= a.y1) {
+                            continue;
+                        }
+                        // A pair that belongs to both groups in both roles is reported only once
+                        if (b.index < a.index && this->isHitMember(b.index, query.aFirst, query.aLast, query.aMask) &&
+                            this->isHitMember(a.index, query.bFirst, query.bLast, query.bMask)) {
+                            continue;
+                        }
+                        if (query.pixel && !this->hitPixels(a, b)) {
+                            continue;
+                        }
+                        found.push_back(b.index);
+                    }
+                }
+            }
+            std::sort(found.begin(), found.end());
+            for (auto bi : found) {
+                hits.push_back(HitPair(a.index, bi));
+            }
+        }
+    }
+
     ~VDP()
     {
         for (auto ptn : this->rom.ptn) {
@@ -339,8 +527,72 @@ class VDP
             this->ctx.wx2[i] = VDP_WIDTH - 1;
             this->ctx.wy2[i] = VDP_HEIGHT - 1;
         }
+        for (uint32_t w = 0; w < 65536 / 64; w++) {
+            for (uint32_t bit = 0; bit < 64 && (this->ptnModified[w] >> bit); bit++) {
+                if (this->ptnModified[w] & (1ULL << bit)) {
+                    memset(this->ctx.ptn[w * 64 + bit], 0, 32);
+                }
+            }
+        }
+        memset(this->ptnModified, 0, sizeof(this->ptnModified));
         this->resetPattern();
         this->resetPalette();
+        this->ptnDirty.markAll();
+        this->nametblDirty.markAll();
+        this->oamDirty.markAll();
+    }
+
+    // save or restore the machine state (the display is not saved: it is rendered again by the next frame)
+    template <class Archive>
+    void saveRestore(Archive& state)
+    {
+        if (!state.includesPages()) {
+            // the patterns, the name table and the OAM are recorded by the rewind buffer page by page
+            state.data(this->ptnModified, sizeof(this->ptnModified));
+            this->saveRestoreRegisters(state);
+            return;
+        }
+
+        // the character patterns not modified after reset are restored from the ROM instead of the state
+        uint64_t modified[65536 / 64];
+        memcpy(modified, this->ptnModified, sizeof(modified));
+        state.scratch(modified, sizeof(modified));
+        for (uint32_t w = 0; w < 65536 / 64; w++) {
+            const uint64_t stale = state.restoring() ? this->ptnModified[w] & ~modified[w] : 0;
+            if (0 == (modified[w] | stale)) {
+                continue;
+            }
+            for (uint32_t bit = 0; bit < 64; bit++) {
+                if (modified[w] & (1ULL << bit)) {
+                    state.data(this->ctx.ptn[w * 64 + bit], 32);
+                } else if (stale & (1ULL << bit)) {
+                    this->restorePattern(w * 64 + bit);
+                }
+            }
+        }
+        if (state.restoring()) {
+            memcpy(this->ptnModified, modified, sizeof(modified));
+        }
+        state.data(this->ctx.nametbl, sizeof(this->ctx.nametbl));
+        state.data(this->ctx.oam, sizeof(this->ctx.oam));
+        if (state.restoring()) {
+            this->ptnDirty.markAll();
+            this->nametblDirty.markAll();
+            this->oamDirty.markAll();
+        }
+        this->saveRestoreRegisters(state);
+    }
+
+    template <class Archive>
+    void saveRestoreRegisters(Archive& state)
+    {
+        state.data(this->ctx.palette, sizeof(this->ctx.palette));
+        state.data(this->ctx.pinfo, sizeof(this->ctx.pinfo));
+        state.data(&this->ctx.reg, sizeof(this->ctx.reg));
+        state.data(this->ctx.wx1, sizeof(this->ctx.wx1));
+        state.data(this->ctx.wy1, sizeof(this->ctx.wy1));
+        state.data(this->ctx.wx2, sizeof(this->ctx.wx2));
+        state.data(this->ctx.wy2, sizeof(this->ctx.wy2));
     }
 
     void addPattern(int index, const void* ptn, size_t ptnSize)
@@ -395,6 +647,7 @@ class VDP
             uint8_t n = (address & 0xC0000) >> 18;
             uint16_t addr = (address & 0x3FFFC) >> 2;
             this->ctx.nametbl[n][addr] = value;
+            this->nametblDirty.mark(((size_t)n * 65536 + addr) * 4);
         } else {
             switch (address & 0xFF0000) {
                 case 0xD00000: {
@@ -402,6 +655,7 @@ class VDP
                     uint8_t arg = (address & 0x003C) >> 2;
                     uint32_t* rawOam = (uint32_t*)&this->ctx.oam[index];
                     rawOam[arg] = value;
+                    this->oamDirty.mark(index * sizeof(OAM));
                     return;
                 }
                 case 0xD10000: {
@@ -450,12 +704,21 @@ class VDP
         for (int i = 0; i < VDP_DISPLAY_PIXELS; i++) {
             this->ctx.display[i] = this->ctx.palette[0][0];
         }
+        Telemetry* trace = this->telemetry && this->telemetry->enabled ? this->telemetry : nullptr;
+        uint64_t t = trace ? Telemetry::now() : 0;
         for (int i = 0; i < VDP_BG_NUM; i++) {
             if (0 == ((uint32_t*)&this->ctx.reg.skip0)[i]) {
                 this->renderBG(i);
+                if (trace) {
+                    t = trace->span(Telemetry::Span::RenderBG, t, (uint8_t)i);
+                }
             }
             if (i == this->ctx.reg.spos) {
-                this->renderSprites();
+                const uint32_t sprites = this->renderSprites();
+                if (trace) {
+                    trace->frame.sprites += sprites;
+                    t = trace->span(Telemetry::Span::RenderSprites, t);
+                }
             }
         }
     }
@@ -482,6 +745,7 @@ class VDP
             return;
         }
         memcpy(this->ctx.ptn[this->ctx.reg.cp_to], this->ctx.ptn[this->ctx.reg.cp_fr], 32);
+        this->markPatternModified(this->ctx.reg.cp_to, 1);
     }
 
     void transferCharacterPattern()
@@ -517,6 +781,7 @@ class VDP
             return; // invalid address
         }
         memcpy(this->ctx.ptn[to], from, num * 32);
+        this->markPatternModified(to, num);
     }
 
     void setupPropotional(uint16_t ptn_start)
@@ -594,6 +859,7 @@ class VDP
     inline void cls(int n, uint32_t value)
     {
         n &= 3;
+        this->nametblDirty.mark((size_t)n * 0x40000, 0x40000);
         uint8_t* cp = (uint8_t*)&value;
         if (cp[0] == cp[1] && cp[1] == cp[2] && cp[2] == cp[3]) {
             memset(this->ctx.nametbl[n], *cp, 0x40000);
@@ -616,8 +882,11 @@ class VDP
             graphicDrawJisX0208,
             graphicDrawClear,
             graphicDrawWindow,
+            graphicDrawK8x12String,
+            graphicDrawPropotionalString,
         };
-        if (op < 9) {
+        if (op < 11) {
+            this->nametblDirty.mark((size_t)(this->ctx.reg.g_bg & 3) * 0x40000, 0x40000);
             func[op](this);
         }
     }
@@ -646,6 +915,7 @@ class VDP
             this->cls(bg, 0);
             return;
         }
+        this->nametblDirty.mark((size_t)bg * 0x40000, 0x40000);
         uint32_t* vram = this->ctx.nametbl[bg];
         if (vector < 0) {
             // left scroll
@@ -674,6 +944,7 @@ class VDP
             this->cls(bg, 0);
             return;
         }
+        this->nametblDirty.mark((size_t)bg * 0x40000, 0x40000);
         uint32_t* vram = this->ctx.nametbl[bg];
         if (vector < 0) {
             // upward scroll
@@ -702,6 +973,97 @@ class VDP
         return readPatternPixel((base + tileOffset) & 0xFFFF, px & 7, py & 7);
     }
 
+    struct HitRect {
+        int32_t x1; // left (inclusive)
+        int32_t y1; // top (inclusive)
+        int32_t x2; // right (exclusive)
+        int32_t y2; // bottom (exclusive)
+        uint16_t index;
+    };
+
+    static constexpr int kHitGridMaxCells = 4096;
+
+    struct HitWork {
+        std::vector<HitRect> rectsA;
+        std::vector<HitRect> rectsB;
+        std::vector<uint32_t> cellStart;
+        std::vector<uint32_t> cellFill;
+        std::vector<uint16_t> cellItems;
+        std::vector<int> visited;
+        std::vector<uint16_t> found;
+    } hitWork;
+
+    inline bool isHitGroup(int index, uint32_t mask) const
+    {
+        return 0 == mask || (this->ctx.oam[index].group & mask);
+    }
+
+    inline bool isHitMember(int index, int first, int last, uint32_t mask) const
+    {
+        return first <= index && index <= last && this->isHitGroup(index, mask);
+    }
+
+    // Hit rectangle of a sprite in VRAM coordinates (scale is applied, rotate is ignored)
+    inline bool makeHitRect(int index, HitRect* rect) const
+    {
+        const OAM* oam = &this->ctx.oam[index];
+        if (!oam->visible || 0 == oam->scale) {
+            return false;
+        }
+        const int size = ((oam->size & 0x3F) + 1) << 3;
+        const int scale = std::min((int)oam->scale, kSpriteScaleMaxPercent);
+        const int w = oam->slx ? size : size * scale / 100;
+        const int h = oam->sly ? size : size * scale / 100;
+        if (w < 1 || h < 1) {
+            return false;
+        }
+        rect->x1 = range(oam->x, -32768, 32767) + (size - w) / 2;
+        rect->y1 = range(oam->y, -32768, 32767) + (size - h) / 2;
+        rect->x2 = rect->x1 + w;
+        rect->y2 = rect->y1 + h;
+        rect->index = (uint16_t)index;
+        return true;
+    }
+
+    inline bool isSolidSpritePixel(const HitRect& rect, int x, int y)
+    {
+        const OAM* oam = &this->ctx.oam[rect.index];
+        const int psize = (oam->size & 0x3F) + 1;
+        const int size = psize << 3;
+        int px = (x - rect.x1) * size / (rect.x2 - rect.x1);
+        int py = (y - rect.y1) * size / (rect.y2 - rect.y1);
+        if (oam->attr & 0x80000000) {
+            px = size - px - 1;
+        }
+        if (oam->attr & 0x40000000) {
+            py = size - py - 1;
+        }
+        if (oam->ram_ptr) {
+            if (!cpu_ram) {
+                return false;
+            }
+            const int ram_ptr = (oam->ram_ptr + (px + py * size) * 4) & 0xFFFFC;
+            return cpu_ram[ram_ptr + 1] || cpu_ram[ram_ptr + 2] || cpu_ram[ram_ptr + 3];
+        }
+        return 0 != readSpritePixel(oam->attr & 0xFFFF, psize, px, py);
+    }
+
+    inline bool hitPixels(const HitRect& a, const HitRect& b)
+    {
+        const int x1 = std::max(a.x1, b.x1);
+        const int y1 = std::max(a.y1, b.y1);
+        const int x2 = std::min(a.x2, b.x2);
+        const int y2 = std::min(a.y2, b.y2);
+        for (int y = y1; y < y2; y++) {
+            for (int x = x1; x < x2; x++) {
+                if (this->isSolidSpritePixel(a, x, y) && this->isSolidSpritePixel(b, x, y)) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
     inline uint16_t readPaletteNumber(uint32_t attr) const
     {
         return (attr & kAttributePaletteMask) >> kAttributePaletteShift;
@@ -761,18 +1123,23 @@ class VDP
         }
     }
 
-    inline void renderSprites()
+    // returns the number of the visible sprites
+    inline uint32_t renderSprites()
     {
+        uint32_t count = 0;
         for (int i = 1023; 0 <= i; i--) {
             if (this->ctx.oam[i].visible && !this->ctx.oam[i].pri) {
                 renderSprite(&this->ctx.oam[i]);
+                count++;
             }
         }
         for (int i = 1023; 0 <= i; i--) {
             if (this->ctx.oam[i].visible && this->ctx.oam[i].pri) {
                 renderSprite(&this->ctx.oam[i]);
+                count++;
             }
         }
+        return count;
     }
 
     inline void renderSprite(OAM* oam)
@@ -815,7 +1182,7 @@ class VDP
         int scaledY = oam->y * coordScale;
         for (int dy = scaledY + offsetY, by = 0; by < scaledSizeY; dy++, by++) {
             int py = (int)(by * ratioY);
-            int wy = flipH ? size - py - 1 : py;
+            int wy = flipV ? size - py - 1 : py;
             for (int dx = scaledX + offsetX, bx = 0; bx < scaledSizeX; dx++, bx++) {
                 int px = (int)(bx * ratioX);
                 int wx = flipH ? size - px - 1 : px;
@@ -961,6 +1328,110 @@ static inline void drawLine(uint32_t* vram, int32_t fx, int32_t fy, int32_t tx,
     }
 }
 
+// Horizontal runs of set bits in a 1bpp k8x12 glyph row (at most 4 runs per byte)
+struct K8x12SpanTable {
+    uint8_t count[256];
+    uint8_t start[256][4];
+    uint8_t length[256][4];
+};
+
+static constexpr K8x12SpanTable makeK8x12SpanTable()
+{
+    K8x12SpanTable table{};
+    for (int bits = 0; bits < 256; bits++) {
+        int n = 0;
+        for (int ix = 0; ix < 8; ix++) {
+            if (bits & (0x80 >> ix)) {
+                if (ix == 0 || !(bits & (0x100 >> ix))) {
+                    table.start[bits][n] = (uint8_t)ix;
+                    table.length[bits][n] = 0;
+                    n++;
+                }
+                table.length[bits][n - 1]++;
+            }
+        }
+        table.count[bits] = (uint8_t)n;
+    }
+    return table;
+}
+
+static constexpr K8x12SpanTable k8x12SpanTable = makeK8x12SpanTable();
+
+static inline void drawK8x12Glyph(uint32_t* vram, int32_t x, int32_t y, uint32_t col, const uint8_t* ptn, int width)
+{
+    if (x <= -width || VDP_WIDTH <= x || y <= -12 || VDP_HEIGHT <= y) {
+        return;
+    }
+    const uint8_t mask = (uint8_t)(0xFF00 >> width);
+    for (int iy = 0; iy < 12; iy++) {
+        if (y + iy < 0 || VDP_HEIGHT <= y + iy) {
+            continue;
+        }
+        const uint8_t bits = ptn[iy] & mask;
+        uint32_t* line = &vram[(y + iy) * VDP_WIDTH];
+        for (int i = 0; i < k8x12SpanTable.count[bits]; i++) {
+            int sx = x + k8x12SpanTable.start[bits][i];
+            int ex = sx + k8x12SpanTable.length[bits][i];
+            if (sx < 0) {
+                sx = 0;
+            }
+            if (VDP_WIDTH < ex) {
+                ex = VDP_WIDTH;
+            }
+            for (; sx < ex; sx++) {
+                line[sx] = col;
+            }
+        }
+    }
+}
+
+static inline void drawCharacter(VDP* vdp, uint32_t* vram, int32_t x, int32_t y, uint16_t pal, const uint8_t* ptn, bool drawZero)
+{
+    if (x <= -8 || y <= -8 || VDP_WIDTH <= x || VDP_HEIGHT <= y) {
+        return;
+    }
+    const uint32_t* palette = vdp->ctx.palette[pal];
+    for (int i = 0; i < 8; i++, ptn += 4) {
+        if (y + i < 0 || VDP_HEIGHT <= y + i) {
+            continue;
+        }
+        uint32_t* line = &vram[(y + i) * VDP_WIDTH];
+        for (int j = 0; j < 8; j++) {
+            if (x + j < 0 || VDP_WIDTH <= x + j) {
+                continue;
+            }
+            int p = j & 1 ? ptn[j >> 1] & 0x0F : ptn[j >> 1] >> 4;
+            if (p) {
+                line[x + j] = palette[p];
+            } else if (drawZero) {
+                line[x + j] = 0;
+            }
+        }
+    }
+}
+
+// Convert a SJIS double-byte code to the JIS X 0208 index of the k8x12 font (-1: out of range)
+static inline int32_t sjisToK8x12Index(uint8_t h, uint8_t l)
+{
+    int32_t hh = h - (h < 0x9F ? 0x71 : 0xB1);
+    int32_t ll = l;
+    hh = hh * 2 + 1;
+    if (0x7F <= ll) {
+        ll--;
+    }
+    if (0x9E <= ll) {
+        ll -= 0x7D;
+        hh++;
+    } else {
+        ll -= 0x1F;
+    }
+    if (hh < 0x21 || ll < 0x21 || 0x21 + 94 <= ll) {
+        return -1;
+    }
+    int32_t code = (hh - 0x21) * 94 + (ll - 0x21);
+    return code <= 8835 ? code : -1;
+}
+
 static inline void graphicDrawPixel(VDP* vdp)
 {
     drawPixel(vdp->ctx.nametbl[vdp->ctx.reg.g_bg & 3],
@@ -1013,98 +1484,41 @@ static inline void graphicDrawBoxFill(VDP* vdp)
 
 static inline void graphicDrawCharacter(VDP* vdp)
 {
-    uint32_t* vram = vdp->ctx.nametbl[vdp->ctx.reg.g_bg & 3];
-    int32_t x = (int32_t)vdp->ctx.reg.g_x1;
-    int32_t y = (int32_t)vdp->ctx.reg.g_y1;
-    uint16_t pal = (int32_t)vdp->ctx.reg.g_col & VDP::kPaletteMask;
-    uint8_t* ptn = vdp->ctx.ptn[vdp->ctx.reg.g_opt & 0xFFFF];
-    bool drawZero = vdp->ctx.reg.g_col & 0x80000000 ? true : false;
-
-    if (x < -8 || y < -8 || 320 <= x || 200 <= y) {
-        return;
-    }
-    for (int i = 0; i < 8; i++) {
-        if (y + i < 0 || 200 <= y + i) {
-            continue;
-        }
-        for (int j = 0; j < 4; j++) {
-            int p0 = (ptn[i * 4 + j] & 0xF0) >> 4;
-            int p1 = ptn[i * 4 + j] & 0x0F;
-            uint32_t c0 = vdp->ctx.palette[pal][p0];
-            uint32_t c1 = vdp->ctx.palette[pal][p1];
-            if (0 <= x + j * 2 && x + j * 2 < 320) {
-                if (p0) {
-                    vram[(y + i) * 320 + x + j * 2] = c0;
-                } else if (drawZero) {
-                    vram[(y + i) * 320 + x + j * 2] = 0;
-                }
-            }
-            if (0 <= x + j * 2 + 1 && x + j * 2 + 1 < 320) {
-                if (p1) {
-                    vram[(y + i) * 320 + x + j * 2 + 1] = c1;
-                } else if (drawZero) {
-                    vram[(y + i) * 320 + x + j * 2 + 1] = 0;
-                }
-            }
-        }
-    }
+    drawCharacter(vdp,
+                  vdp->ctx.nametbl[vdp->ctx.reg.g_bg & 3],
+                  (int32_t)vdp->ctx.reg.g_x1,
+                  (int32_t)vdp->ctx.reg.g_y1,
+                  vdp->ctx.reg.g_col & VDP::kPaletteMask,
+                  vdp->ctx.ptn[vdp->ctx.reg.g_opt & 0xFFFF],
+                  vdp->ctx.reg.g_col & 0x80000000 ? true : false);
 }
 
 static inline void graphicDrawJisX0201(VDP* vdp)
 {
-    uint32_t* vram = vdp->ctx.nametbl[vdp->ctx.reg.g_bg & 3];
-    int32_t x = (int32_t)vdp->ctx.reg.g_x1;
-    int32_t y = (int32_t)vdp->ctx.reg.g_y1;
-    uint32_t col = vdp->ctx.reg.g_col;
-    uint32_t code = (int32_t)vdp->ctx.reg.g_opt;
+    uint32_t code = vdp->ctx.reg.g_opt;
     if (255 < code) {
         return;
     }
-    const uint8_t* ptn = &k8x12_jisx0201[code * 12];
-    for (int iy = 0; iy < 12; iy++) {
-        int p = ptn[iy];
-        if (y + iy < 0 || 200 <= y + iy) {
-            continue;
-        }
-        for (int ix = 0; ix < 4; ix++) {
-            if (x + ix < 0 || 320 <= x + ix) {
-                continue;
-            }
-            if (p & 0x80) {
-                vram[(y + iy) * 320 + x + ix] = col;
-            }
-            p <<= 1;
-        }
-    }
+    drawK8x12Glyph(vdp->ctx.nametbl[vdp->ctx.reg.g_bg & 3],
+                   (int32_t)vdp->ctx.reg.g_x1,
+                   (int32_t)vdp->ctx.reg.g_y1,
+                   vdp->ctx.reg.g_col,
+                   &k8x12_jisx0201[code * 12],
+                   4);
 }
 
 static inline void graphicDrawJisX0208(VDP* vdp)
 {
-    uint32_t* vram = vdp->ctx.nametbl[vdp->ctx.reg.g_bg & 3];
-    int32_t x = (int32_t)vdp->ctx.reg.g_x1;
-    int32_t y = (int32_t)vdp->ctx.reg.g_y1;
-    uint32_t col = vdp->ctx.reg.g_col;
-    uint32_t code = (int32_t)vdp->ctx.reg.g_opt;
-    printf("jisx0208: 0x%04X\n", code);
+    uint32_t code = vdp->ctx.reg.g_opt;
     if (8835 < code) {
         return;
     }
-    const uint8_t* ptn = &k8x12_jisx0208[code * 12];
-    for (int iy = 0; iy < 12; iy++) {
-        int p = ptn[iy];
-        if (y + iy < 0 || 200 <= y + iy) {
-            continue;
-        }
-        for (int ix = 0; ix < 8; ix++) {
-            if (x + ix < 0 || 320 <= x + ix) {
-                continue;
-            }
-            if (p & 0x80) {
-                vram[(y + iy) * 320 + x + ix] = col;
-            }
-            p <<= 1;
-        }
-    }
+    drawK8x12Glyph(vdp->ctx.nametbl[vdp->ctx.reg.g_bg & 3],
+                   (int32_t)vdp->ctx.reg.g_x1,
+                   (int32_t)vdp->ctx.reg.g_y1,
+                   vdp->ctx.reg.g_col,
+                   &k8x12_jisx0208[code * 12],
+                   8);
 }
 
 static inline void graphicDrawClear(VDP* vdp)
@@ -1151,3 +1565,65 @@ static inline void graphicDrawWindow(VDP* vdp)
     vdp->ctx.wx2[n] = x2;
     vdp->ctx.wy2[n] = y2;
 }
+
+static inline void graphicDrawK8x12String(VDP* vdp)
+{
+    vdp->ctx.reg.g_adv = 0;
+    size_t limit;
+    const uint8_t* text = vdp->resolveString(vdp->ctx.reg.g_opt, &limit);
+    if (!text) {
+        return;
+    }
+    uint32_t* vram = vdp->ctx.nametbl[vdp->ctx.reg.g_bg & 3];
+    int32_t x = (int32_t)vdp->ctx.reg.g_x1;
+    int32_t y = (int32_t)vdp->ctx.reg.g_y1;
+    uint32_t col = vdp->ctx.reg.g_col;
+    int32_t sx = x;
+    for (size_t i = 0; i < limit && text[i]; i++) {
+        uint8_t c = text[i];
+        if ((0x81 <= c && c <= 0x9F) || (0xE0 <= c && c <= 0xEF)) {
+            if (limit <= i + 1 || !text[i + 1]) {
+                break; // truncated double-byte character
+            }
+            int32_t code = sjisToK8x12Index(c, text[++i]);
+            if (0 <= code) {
+                drawK8x12Glyph(vram, x, y, col, &k8x12_jisx0208[code * 12], 8);
+            }
+            x += 8;
+        } else {
+            drawK8x12Glyph(vram, x, y, col, &k8x12_jisx0201[c * 12], 4);
+            x += 4;
+        }
+    }
+    vdp->ctx.reg.g_adv = (uint32_t)(x - sx);
+}
+
+static inline void graphicDrawPropotionalString(VDP* vdp)
+{
+    vdp->ctx.reg.g_adv = 0;
+    size_t limit;
+    const uint8_t* text = vdp->resolveString(vdp->ctx.reg.g_opt, &limit);
+    if (!text) {
+        return;
+    }
+    uint32_t* vram = vdp->ctx.nametbl[vdp->ctx.reg.g_bg & 3];
+    int32_t x = (int32_t)vdp->ctx.reg.g_x1;
+    int32_t y = (int32_t)vdp->ctx.reg.g_y1;
+    uint16_t pal = vdp->ctx.reg.g_col & VDP::kPaletteMask;
+    bool drawZero = vdp->ctx.reg.g_col & 0x80000000 ? true : false;
+    uint16_t base = vdp->ctx.reg.g_ptn & 0xFFFF;
+    int32_t sx = x;
+    for (size_t i = 0; i < limit && text[i]; i++) {
+        uint8_t c = text[i];
+        const uint8_t* ptn = vdp->ctx.ptn[(uint16_t)(base + c)];
+        if (c < 0x80 && 0 < vdp->ctx.pinfo[c].width) {
+            const VDP::PropotionalInfo& info = vdp->ctx.pinfo[c];
+            drawCharacter(vdp, vram, x + info.dx, y + info.dy, pal, ptn, drawZero);
+            x += info.width;
+        } else {
+            drawCharacter(vdp, vram, x, y, pal, ptn, drawZero);
+            x += 8;
+        }
+    }
+    vdp->ctx.reg.g_adv = (uint32_t)(x - sx);
+}
@@ -38,6 +38,7 @@
 #include <string>
 #include <algorithm>
 #include <array>
+#include <bitset>
 #include <map>
 #include <vector>
 #include <iostream>
@@ -110,21 +111,113 @@ class VgmDriver : public ymfm::ymfm_interface
   private:
     static constexpr int YM2612ChannelCount = 6;
     static constexpr size_t OutputChannelCount = 2;
+    static constexpr size_t Ym2612QueueCapacity = 1024;
     ymfm::ym2612 ym2612;
-    std::vector<std::pair<uint32_t, uint8_t>> ym2612_queue;
+
+    // register writes are time stamped and applied just before the chip sample at (or after) that time
+    struct Ym2612Write {
+        emulated_time time;
+        uint16_t reg;
+        uint8_t data;
+    };
+
+    struct Ym2612WriteQueue {
+        std::array<Ym2612Write, Ym2612QueueCapacity> writes;
+        size_t head;
+        size_t count;
+
+        void clear()
+        {
+            this->head = 0;
+            this->count = 0;
+        }
+    } ym2612_queue;
+    uint32_t ym2612QueuePeak;      // maximum depth of ym2612_queue (kept over reset)
+    uint32_t ym2612QueueOverflows; // writes applied early because ym2612_queue was full (kept over reset)
     std::array<uint8_t, YM2612ChannelCount> ym2612_frequency_low;
     std::array<uint8_t, YM2612ChannelCount> ym2612_frequency_high;
     std::array<bool, YM2612ChannelCount> ym2612_mute;
     bool subscribedLog;
     std::function<void(bool isError, const char* msg)> logCallback;
 
+  public:
+    // a VGM is compiled into a flat event array at load time (the byte stream is not interpreted during playback)
+    enum class EventType : uint8_t {
+        Write, // write data to the YM2612 register (reg bit 8 = port 1)
+        Wait,  // wait samples
+        End,   // jump to the loop point (or end if not looped)
+    };
+
+    struct Event {
+        EventType type;
+        uint8_t data;
+        uint16_t reg;
+        uint32_t wait;
+    };
+
+    // YM2612 register values written so far (restored at once when seeking)
+    struct Ym2612Shadow {
+        std::array<uint8_t, 0x200> regs;
+        std::bitset<0x200> written;
+        std::array<uint8_t, 8> keys; // the last key on/off (0x28) for each channel code
+        uint8_t keysWritten;
+
+        void clear()
+        {
+            this->regs.fill(0);
+            this->written.reset();
+            this->keys.fill(0);
+            this->keysWritten = 0;
+        }
+
+        void write(uint16_t reg, uint8_t data)
+        {
+            if (0x28 == reg) {
+                this->keys[data & 7] = data;
+                this->keysWritten |= 1 << (data & 7);
+            } else {
+                this->regs[reg & 0x1FF] = data;
+                this->written.set(reg & 0x1FF);
+            }
+        }
+    };
+
+    // register state at the beginning of an event (recorded every CheckpointInterval samples)
+    struct Checkpoint {
+        uint32_t event;
+        uint32_t position;
+        Ym2612Shadow shadow;
+    };
+
+    struct Program {
+        const uint8_t* source; // compiled VGM data
+        size_t sourceSize;
+        bool valid;
+        bool looped;
+        uint32_t loopIndex;
+        uint32_t loopPosition; // song position of the loop point (samples)
+        uint32_t length;       // song length (samples)
+        emulated_time step;
+        std::map<ChipType, uint32_t> clocks;
+        std::vector<Event> events;
+        std::vector<Checkpoint> checkpoints;
+    };
+
+    static constexpr uint32_t VgmSampleRate = 44100; // unit of the waits and the song positions
+    static constexpr uint32_t CheckpointInterval = VgmSampleRate;
+
+  private:
+    std::map<uint16_t, Program> programs;
+    Program adhocProgram;
+    Ym2612Shadow seekShadow;
+
     struct Context {
-        uint32_t version;
-        const uint8_t* data;
-        size_t size;
-        int32_t cursor;
-        int32_t loopOffset;
-        int32_t wait;
+        const Program* program;
+        uint32_t cursor;
+        uint32_t position;
+        uint64_t positionFraction; // rendered frames not yet counted in position (x VgmSampleRate)
+        int32_t wait;              // output frames until the next event
+        uint64_t waitFraction;     // waited samples not yet converted to frames (x outputRate)
         uint32_t loopCount;
         bool end;
         emulated_time output_start;
@@ -136,6 +229,7 @@ class VgmDriver : public ymfm::ymfm_interface
         bool primed;
         emulated_time previousTime;
         emulated_time nextTime;
+        uint64_t stepReciprocal; // 2^48 / vgm.step (phase to 16-bit fraction)
         std::array<int32_t, OutputChannelCount> previousSample;
         std::array<int32_t, OutputChannelCount> nextSample;
 
@@ -144,11 +238,15 @@ class VgmDriver : public ymfm::ymfm_interface
             this->primed = false;
             this->previousTime = 0;
             this->nextTime = 0;
+            this->stepReciprocal = 0;
             this->previousSample.fill(0);
             this->nextSample.fill(0);
         }
     } ym2612ResampleState;
 
+    std::vector<ymfm::ym2612::output_data> ym2612Block;
+    std::vector<int32_t> mixedBlock;
+
     emulated_time output_step;
     std::map<ChipType, uint32_t> clocks;
     int channels;
@@ -213,6 +311,8 @@ class VgmDriver : public ymfm::ymfm_interface
     Ym2612AnalogNotchCoefficients ym2612AnalogNotch;
     Ym2612AnalogState ym2612AnalogState;
     float outputSampleRate;
+    uint32_t outputRate;
+    std::vector<uint8_t> chipState; // serialized ymfm state (save states)
 
   public:
     VgmDriver(int samples, int channels) : ym2612(*this)
@@ -220,6 +320,9 @@ class VgmDriver : public ymfm::ymfm_interface
         this->output_step = 0x100000000ull / samples;
         this->channels = channels;
         this->outputSampleRate = static_cast<float>(samples);
+        this->outputRate = static_cast<uint32_t>(samples);
+        this->ym2612QueuePeak = 0;
+        this->ym2612QueueOverflows = 0;
         this->postAmp = 1.55f;
         this->dcCutEnabled = true;
         this->dcCutAlpha = 0.995f;
@@ -232,6 +335,26 @@ class VgmDriver : public ymfm::ymfm_interface
     {
     }
 
+    // the YM2612 resampler and the analog filters follow the output rate directly (no extra conversion stage)
+    void setOutputSampleRate(int samples)
+    {
+        this->output_step = 0x100000000ull / samples;
+        this->outputSampleRate = static_cast<float>(samples);
+        this->outputRate = static_cast<uint32_t>(samples);
+        this->updateYm2612AnalogNotchCoefficients();
+        this->ym2612AnalogState.reset();
+    }
+
+    inline int getOutputSampleRate() { return static_cast<int>(this->outputRate); }
+    inline uint32_t getYm2612QueuePeak() { return this->ym2612QueuePeak; }
+    inline uint32_t getYm2612QueueOverflows() { return this->ym2612QueueOverflows; }
+
+    void resetYm2612QueueStats()
+    {
+        this->ym2612QueuePeak = 0;
+        this->ym2612QueueOverflows = 0;
+    }
+
     void subscribeLog(std::function<void(bool, const char*)> callback)
     {
         this->subscribedLog = true;
@@ -432,9 +555,57 @@ class VgmDriver : public ymfm::ymfm_interface
         }
     }
 
+    // compile the VGM into the program slot (index) in advance
+    bool compile(uint16_t index, const uint8_t* data, size_t size)
+    {
+        auto& program = this->programs[index];
+        if (vgm.program == &program) {
+            this->reset(); // stop playing the program before it is rewritten
+        }
+        return this->compile(data, size, program);
+    }
+
+    // play the program slot (index), compiling it first if the slot was not compiled from this data
+    bool load(uint16_t index, const uint8_t* data, size_t size)
+    {
+        auto& program = this->programs[index];
+        if (program.source != data || program.sourceSize != size) {
+            this->compile(data, size, program);
+        }
+        return this->load(program);
+    }
+
     bool load(const uint8_t* data, size_t size)
+    {
+        this->compile(data, size, this->adhocProgram);
+        return this->load(this->adhocProgram);
+    }
+
+    bool load(const Program& program)
     {
         this->reset();
+        if (!program.valid) {
+            return false;
+        }
+        this->clocks = program.clocks;
+        vgm.step = program.step;
+        vgm.program = &program;
+        return true;
+    }
+
+    bool compile(const uint8_t* data, size_t size, Program& program)
+    {
+        program.source = data;
+        program.sourceSize = size;
+        program.valid = false;
+        program.looped = false;
+        program.loopIndex = 0;
+        program.loopPosition = 0;
+        program.length = 0;
+        program.step = 0;
+        program.clocks.clear();
+        program.events.clear();
+        program.checkpoints.clear();
         if (size < 0x100) {
             return false;
         }
@@ -442,14 +613,12 @@ class VgmDriver : public ymfm::ymfm_interface
             return false;
         }
 
-        memcpy(&vgm.version, &data[0x08], 4);
-        if (vgm.version < 0x161) {
+        uint32_t version;
+        memcpy(&version, &data[0x08], 4);
+        if (version < 0x161) {
             return false;
         }
 
-        vgm.data = data;
-        vgm.size = size;
-
         bool detect_unsupported = false;
         bool detect_supported = false;
         for (int i = 0x2C; i < 0xE8; i += 4) {
@@ -463,23 +632,19 @@ class VgmDriver : public ymfm::ymfm_interface
                     auto type = getChipType(it->second);
                     if (type != ChipType::Unsupported) {
                         strcat(msg, "<supported>");
-                        this->clocks[type] = clocks;
+                        program.clocks[type] = clocks;
                         switch (type) {
                             case ChipType::YM2612:
-                                vgm.step = 0x100000000ull / this->ym2612.sample_rate(clocks);
+                                program.step = 0x100000000ull / this->ym2612.sample_rate(clocks);
                                 break;
                             case ChipType::Unsupported: break;
                         }
                         detect_supported = true;
-                        if (subscribedLog) {
-                            logCallback(false, msg);
-                        }
+                        this->putCompileLog(false, msg);
                     } else {
                         strcat(msg, "<unsupported!>");
                         detect_unsupported = true;
-                        if (subscribedLog) {
-                            logCallback(true, msg);
-                        }
+                        this->putCompileLog(true, msg);
                     }
                 }
             }
@@ -488,68 +653,249 @@ class VgmDriver : public ymfm::ymfm_interface
             return false;
         }
 
-        memcpy(&vgm.cursor, &data[0x34], 4);
-        vgm.cursor += 0x34;
-        memcpy(&vgm.loopOffset, &data[0x1C], 4);
-        vgm.loopOffset += vgm.loopOffset ? 0x1C : 0;
+        uint32_t cursor;
+        uint32_t loopOffset;
+        memcpy(&cursor, &data[0x34], 4);
+        cursor += 0x34;
+        memcpy(&loopOffset, &data[0x1C], 4);
+        loopOffset += loopOffset ? 0x1C : 0;
+
+        const uint8_t* pcmBank = nullptr;
+        uint32_t pcmBankSize = 0;
+        uint32_t pcmCursor = 0;
+        uint32_t pendingWait = 0;
+        uint32_t ignoredCommands = 0;
+        bool terminated = false;
+        auto flushWait = [&]() {
+            if (pendingWait) {
+                program.events.push_back({EventType::Wait, 0, 0, pendingWait});
+                pendingWait = 0;
+            }
+        };
+        auto write = [&](uint16_t reg, uint8_t value) {
+            flushWait();
+            program.events.push_back({EventType::Write, value, reg, 0});
+        };
+        auto invalid = [&](const char* reason, uint32_t offset) {
+            char msg[256];
+            snprintf(msg, sizeof(msg), "%s at 0x%X", reason, offset);
+            this->putCompileLog(true, msg);
+            program.events.clear();
+            return false;
+        };
+
+        while (!terminated && cursor < size) {
+            if (loopOffset && cursor == loopOffset) {
+                flushWait();
+                program.looped = true;
+                program.loopIndex = static_cast<uint32_t>(program.events.size());
+            }
+            const uint32_t offset = cursor;
+            const uint8_t cmd = data[cursor++];
+            uint32_t length;
+            switch (cmd) {
+                case 0x4F: length = 1; break;      // Game Gear PSG stereo (ignore)
+                case 0x50: length = 1; break;      // SN76489 write (ignore)
+                case 0x52: length = 2; break;      // YM2612 port 0
+                case 0x53: length = 2; break;      // YM2612 port 1
+                case 0xA2: length = 2; break;      // YM2612 port 0 (2nd chip)
+                case 0xA3: length = 2; break;      // YM2612 port 1 (2nd chip)
+                case 0x61: length = 2; break;      // Wait nn samples
+                case 0x67: length = 6; break;      // Data block: 0x67 0x66 tt ss ss ss ss
+                case 0x90: length = 4; break;      // Setup Stream Control (ignore)
+                case 0x91: length = 4; break;      // Set Stream Data (ignore)
+                case 0x92: length = 5; break;      // Set Stream Frequency (ignore)
+                case 0x93: length = 10; break;     // Start Stream (ignore)
+                case 0x94: length = 1; break;      // Stop Stream (ignore)
+                case 0x95: length = 4; break;      // Start Stream fast call (ignore)
+                case 0xE0: length = 4; break;      // Seek to offset in PCM data bank
+                default: length = 0; break;
+            }
+            if (size < cursor + length) {
+                return invalid("Detected a truncated VGM command", offset);
+            }
+            switch (cmd) {
+                case 0x52:
+                case 0xA2:
+                    write(data[cursor], data[cursor + 1]);
+                    break;
+                case 0x53:
+                case 0xA3:
+                    write(data[cursor] | 0x100, data[cursor + 1]);
+                    break;
+                case 0x61: {
+                    uint16_t nn;
+                    memcpy(&nn, &data[cursor], 2);
+                    pendingWait += nn;
+                    break;
+                }
+                case 0x62: pendingWait += 735; break;
+                case 0x63: pendingWait += 882; break;
+                case 0x66: terminated = true; break;
+                case 0x67: {
+                    uint32_t blockSize;
+                    memcpy(&blockSize, &data[cursor + 2], 4);
+                    if (size - (cursor + length) < blockSize) {
+                        return invalid("Detected a truncated VGM data block", offset);
+                    }
+                    if (0x00 == data[cursor + 1] && !pcmBank) {
+                        // YM2612 PCM data bank (used by 0x8n)
+                        pcmBank = &data[cursor + length];
+                        pcmBankSize = blockSize;
+                    }
+                    length += blockSize;
+                    break;
+                }
+                case 0xE0:
+                    memcpy(&pcmCursor, &data[cursor], 4);
+                    break;
+                case 0x4F:
+                case 0x50:
+                case 0x90:
+                case 0x91:
+                case 0x92:
+                case 0x93:
+                case 0x94:
+                case 0x95:
+                    ignoredCommands++;
+                    break;
+                default:
+                    if (0x70 == (cmd & 0xF0)) {
+                        // Wait n+1 samples
+                        pendingWait += (cmd & 0x0F) + 1;
+                    } else if (0x80 == (cmd & 0xF0)) {
+                        // YM2612 port 0 address 2A write from the data bank, then wait n samples
+                        if (pcmCursor >= pcmBankSize) {
+                            return invalid("Detected a YM2612 DAC write outside of the PCM data bank", offset);
+                        }
+                        write(0x2A, pcmBank[pcmCursor++]);
+                        pendingWait += cmd & 0x0F;
+                    } else {
+                        char msg[64];
+                        snprintf(msg, sizeof(msg), "Detected an unsupported VGM command: %02X", cmd);
+                        return invalid(msg, offset);
+                    }
+            }
+            cursor += length;
+        }
+        flushWait();
+        if (!terminated) {
+            this->putCompileLog(true, "Detected no end of sound data (0x66)");
+        }
+        if (loopOffset && !program.looped) {
+            this->putCompileLog(true, "Ignored the loop offset that is not at a VGM command");
+        }
+        if (program.looped) {
+            // a loop without any wait would never yield (play it once instead)
+            bool waited = false;
+            for (size_t i = program.loopIndex; i < program.events.size(); i++) {
+                waited |= program.events[i].type == EventType::Wait;
+            }
+            if (!waited) {
+                this->putCompileLog(true, "Ignored the loop that has no wait");
+                program.looped = false;
+            }
+        }
+        if (ignoredCommands) {
+            char msg[128];
+            snprintf(msg, sizeof(msg), "Ignored %u PSG/DAC stream commands", ignoredCommands);
+            this->putCompileLog(false, msg);
+        }
+        program.events.push_back({EventType::End, 0, 0, 0});
+        program.events.shrink_to_fit();
+        this->recordCheckpoints(program);
+        program.valid = true;
+        return true;
+    }
+
+    // jump to the song position (samples) by restoring the nearest checkpoint without synthesizing the skipped part
+    bool seek(uint32_t position)
+    {
+        const Program* program = vgm.program;
+        if (!program) {
+            return false;
+        }
+        // load() resets the driver, but the channel mutes and the loop count belong to the playback, not to the position
+        const auto mute = this->ym2612_mute;
+        const uint32_t loopCount = vgm.loopCount;
+        this->load(*program);
+        for (int ch = 0; ch < YM2612ChannelCount; ch++) {
+            this->setMute(ChipType::YM2612, ch, mute[ch]);
+        }
+        vgm.loopCount = loopCount;
+        if (program->length <= position) {
+            if (!program->looped) {
+                vgm.position = program->length;
+                vgm.end = true;
+                return true;
+            }
+            position = program->loopPosition + (position - program->loopPosition) % (program->length - program->loopPosition);
+        }
+        auto it = std::upper_bound(program->checkpoints.begin(), program->checkpoints.end(), position, [](uint32_t p, const Checkpoint& cp) {
+            return p < cp.position;
+        });
+        const Checkpoint& checkpoint = *(--it);
+        this->seekShadow = checkpoint.shadow;
+        uint32_t cursor = checkpoint.event;
+        uint32_t current = checkpoint.position;
+        while (current < position) {
+            const Event& event = program->events[cursor++];
+            if (EventType::Write == event.type) {
+                this->seekShadow.write(event.reg, event.data);
+            } else if (EventType::Wait == event.type) {
+                if (position < current + event.wait) {
+                    this->addWait(current + event.wait - position);
+                    break;
+                }
+                current += event.wait;
+            }
+        }
+        vgm.cursor = cursor;
+        vgm.position = position;
+        this->restoreYm2612(this->seekShadow);
         return true;
     }
 
+    inline uint32_t getPosition() { return this->vgm.position; }
+    inline uint32_t getLength() { return this->vgm.program ? this->vgm.program->length : 0; }
+    inline uint32_t getLoopPosition() { return this->vgm.program && this->vgm.program->looped ? this->vgm.program->loopPosition : 0; }
+    inline bool isLooped() { return this->vgm.program && this->vgm.program->looped; }
+
     void render(int16_t* buf, int samples)
     {
-        if (!vgm.data) {
+        if (!vgm.program) {
             memset(buf, 0, samples * 2);
             return;
         }
-        int cursor = 0;
-        while (cursor < samples) {
+        const int frames = samples / this->channels;
+        const bool ym2612Enabled = this->clocks.find(ChipType::YM2612) != this->clocks.end();
+        int frame = 0;
+        while (frame < frames) {
             if (vgm.wait < 1) {
                 this->execute();
             }
-            vgm.wait--;
-            int32_t mixed[2] = {0, 0};
-            for (auto it = this->clocks.begin(); it != this->clocks.end(); it++) {
-                switch (it->first) {
-                    case ChipType::YM2612: {
-                        uint32_t addr1 = 0xffff, addr2 = 0xffff;
-                        uint32_t reg = 0;
-                        uint8_t data1 = 0, data2 = 0;
-
-                        // see if there is data to be written; if so, extract it and dequeue
-                        if (!ym2612_queue.empty()) {
-                            auto front = ym2612_queue.front();
-                            reg = front.first;
-                            addr1 = 0 + 2 * ((front.first >> 8) & 3);
-                            data1 = front.first & 0xff;
-                            addr2 = addr1 + 1;
-                            data2 = front.second;
-                            ym2612_queue.erase(ym2612_queue.begin());
-                        }
-
-                        // write to the chip
-                        if (addr1 != 0xffff) {
-                            ym2612.write(addr1, data1);
-                            ym2612.write(addr2, data2);
-                            this->updateYm2612Frequency(reg, data2);
-                        }
 
-                        this->sampleYm2612At(vgm.output_start, mixed);
-                        vgm.output_start += output_step;
-                        break;
-                    }
-                    case ChipType::Unsupported:
-                        break;
-                }
+            // render until the next VGM event (or the end of the buffer) at once
+            int span = frames - frame;
+            if (!vgm.end && vgm.wait < span) {
+                span = vgm.wait;
             }
+            vgm.wait -= span;
 
-            int16_t left = this->postProcessSample(0, mixed[0]);
-            int16_t right = this->postProcessSample(1, mixed[1]);
-            if (this->channels < 2) {
-                buf[cursor++] = left;
-            } else {
-                buf[cursor++] = left;
-                buf[cursor++] = right;
+            this->mixedBlock.assign(static_cast<size_t>(span) * OutputChannelCount, 0);
+            if (ym2612Enabled) {
+                this->renderYm2612Block(this->mixedBlock.data(), span);
             }
+            this->postProcessBlock(this->mixedBlock.data(), &buf[frame * this->channels], span);
+            if (!vgm.end) {
+                vgm.positionFraction += static_cast<uint64_t>(span) * VgmSampleRate;
+                vgm.position += static_cast<uint32_t>(vgm.positionFraction / this->outputRate);
+                vgm.positionFraction %= this->outputRate;
+            }
+            frame += span;
+        }
+        if (frames * this->channels < samples) {
+            memset(&buf[frames * this->channels], 0, (samples - frames * this->channels) * 2);
         }
     }
 
@@ -592,18 +938,80 @@ class VgmDriver : public ymfm::ymfm_interface
         this->ym2612.set_channel_mute(static_cast<uint32_t>(ch), enabled);
     }
 
-  private:
-    static float clampUnit(float value)
+    // the program slot being played (-1: none or an ad hoc program)
+    int32_t getProgramSlot()
     {
-        if (value < -1.0f) {
-            return -1.0f;
+        for (const auto& program : this->programs) {
+            if (&program.second == vgm.program) {
+                return program.first;
+            }
         }
-        if (value > 1.0f) {
-            return 1.0f;
+        return -1;
+    }
+
+    // save or restore the playback and the chip state (the program must be loaded before restoring)
+    template <class Archive>
+    void saveRestore(Archive& state)
+    {
+        state.data(&vgm.cursor, sizeof(vgm.cursor));
+        state.data(&vgm.position, sizeof(vgm.position));
+        state.data(&vgm.positionFraction, sizeof(vgm.positionFraction));
+        state.data(&vgm.wait, sizeof(vgm.wait));
+        state.data(&vgm.waitFraction, sizeof(vgm.waitFraction));
+        state.data(&vgm.loopCount, sizeof(vgm.loopCount));
+        state.data(&vgm.end, sizeof(vgm.end));
+        state.data(&vgm.output_start, sizeof(vgm.output_start));
+        state.data(&vgm.pos, sizeof(vgm.pos));
+        state.data(&vgm.step, sizeof(vgm.step));
+        if (state.restoring() && vgm.program && vgm.program->events.size() <= vgm.cursor) {
+            vgm.end = true;
+        }
+
+        // pending register writes (restored from the head of the queue)
+        uint32_t count = static_cast<uint32_t>(this->ym2612_queue.count);
+        state.scratch(&count, sizeof(count));
+        if (Ym2612QueueCapacity < count) {
+            state.fail();
+            return;
+        }
+        for (uint32_t i = 0; i < count; i++) {
+            state.data(&this->ym2612_queue.writes[state.saving() ? (this->ym2612_queue.head + i) % Ym2612QueueCapacity : i], sizeof(Ym2612Write));
+        }
+        if (state.restoring()) {
+            this->ym2612_queue.head = 0;
+            this->ym2612_queue.count = count;
+        }
+        state.data(this->ym2612_frequency_low.data(), sizeof(this->ym2612_frequency_low));
+        state.data(this->ym2612_frequency_high.data(), sizeof(this->ym2612_frequency_high));
+        state.data(this->ym2612_mute.data(), sizeof(this->ym2612_mute));
+        state.data(&this->ym2612ResampleState, sizeof(this->ym2612ResampleState));
+        state.data(this->dcCutLastInput.data(), sizeof(this->dcCutLastInput));
+        state.data(this->dcCutLastOutput.data(), sizeof(this->dcCutLastOutput));
+        state.data(&this->ym2612AnalogState, sizeof(this->ym2612AnalogState));
+
+        // chip internals (ymfm serializes them by itself)
+        if (state.saving()) {
+            ymfm::ymfm_saved_state chip(this->chipState, true);
+            this->ym2612.save_restore(chip);
+        }
+        uint32_t chipSize = static_cast<uint32_t>(this->chipState.size());
+        state.scratch(&chipSize, sizeof(chipSize));
+        if (0x10000 < chipSize) {
+            state.fail();
+            return;
+        }
+        this->chipState.resize(chipSize);
+        state.scratch(this->chipState.data(), chipSize);
+        if (state.restoring()) {
+            ymfm::ymfm_saved_state chip(this->chipState, false);
+            this->ym2612.save_restore(chip);
+            for (int ch = 0; ch < YM2612ChannelCount; ch++) {
+                this->ym2612.set_channel_mute(static_cast<uint32_t>(ch), this->ym2612_mute[ch]);
+            }
         }
-        return value;
     }
 
+  private:
     void clampYm2612AnalogConfig()
     {
         this->ym2612AnalogConfig.hpAlpha = std::clamp(this->ym2612AnalogConfig.hpAlpha, 0.0f, 1.0f);
@@ -635,140 +1043,272 @@ class VgmDriver : public ymfm::ymfm_interface
         this->ym2612AnalogNotch.a2 = (1.0f - alpha) / a0;
     }
 
-    float applyYm2612AnalogNotch(size_t channel, float value)
+    void generateYm2612Output(std::array<int32_t, OutputChannelCount>& sample)
     {
-        if (!this->ym2612AnalogConfig.notchEnabled || this->ym2612AnalogConfig.notchMix <= 0.0f) {
-            return value;
-        }
-
-        const Ym2612AnalogNotchCoefficients& notch = this->ym2612AnalogNotch;
-        float filtered = (notch.b0 * value)
-                       + (notch.b1 * this->ym2612AnalogState.notchInput1[channel])
-                       + (notch.b2 * this->ym2612AnalogState.notchInput2[channel])
-                       - (notch.a1 * this->ym2612AnalogState.notchOutput1[channel])
-                       - (notch.a2 * this->ym2612AnalogState.notchOutput2[channel]);
-
-        this->ym2612AnalogState.notchInput2[channel] = this->ym2612AnalogState.notchInput1[channel];
-        this->ym2612AnalogState.notchInput1[channel] = value;
-        this->ym2612AnalogState.notchOutput2[channel] = this->ym2612AnalogState.notchOutput1[channel];
-        this->ym2612AnalogState.notchOutput1[channel] = filtered;
-
-        return (value * (1.0f - this->ym2612AnalogConfig.notchMix)) + (filtered * this->ym2612AnalogConfig.notchMix);
+        ymfm::ym2612::output_data out;
+        ym2612.generate(&out);
+        sample[0] = out.data[0];
+        sample[1] = out.data[1];
     }
 
-    float applyLegacyDcCut(size_t channel, float value)
+    void writeYm2612(uint32_t reg, uint8_t data)
     {
-        if (!this->dcCutEnabled) {
-            return value;
-        }
-        float filtered = value - this->dcCutLastInput[channel] + (this->dcCutAlpha * this->dcCutLastOutput[channel]);
-        this->dcCutLastInput[channel] = value;
-        this->dcCutLastOutput[channel] = filtered;
-        return filtered;
+        const uint32_t addr = 2 * ((reg >> 8) & 3);
+        ym2612.write(addr, reg & 0xff);
+        ym2612.write(addr + 1, data);
+        this->updateYm2612Frequency(reg, data);
     }
 
-    float applyYm2612AnalogPipeline(size_t channel, float sample)
+    void enqueueYm2612(uint32_t reg, uint8_t data)
     {
-        const Ym2612AnalogConfig& cfg = this->ym2612AnalogConfig;
-
-        // Gentle DC cut keeps the downstream nonlinearity from biasing.
-        float value = sample - this->ym2612AnalogState.hpLastInput[channel] + (cfg.hpAlpha * this->ym2612AnalogState.hpLastOutput[channel]);
-        this->ym2612AnalogState.hpLastInput[channel] = sample;
-        this->ym2612AnalogState.hpLastOutput[channel] = value;
-
-        // YM2612 character is approximated with a tiny asymmetric curve.
-        if (value >= 0.0f) {
-            value = (value * cfg.asymPosGain) + (cfg.asymPosCurve * value * value);
-        } else {
-            value = (value * cfg.asymNegGain) - (cfg.asymNegCurve * value * value);
+        auto& queue = this->ym2612_queue;
+        if (Ym2612QueueCapacity <= queue.count) {
+            // the queue overflowed: apply the oldest write now instead of dropping it
+            const Ym2612Write& oldest = queue.writes[queue.head];
+            this->writeYm2612(oldest.reg, oldest.data);
+            queue.head = (queue.head + 1) % Ym2612QueueCapacity;
+            queue.count--;
+            this->ym2612QueueOverflows++;
         }
-        value = clampUnit(value);
-
-        // A one-pole low-pass lightly rounds the sharpest digital edge.
-        float& lp = this->ym2612AnalogState.lpLastOutput[channel];
-        lp += cfg.lpAlpha * (value - lp);
-        value = lp;
-
-        if (cfg.busSaturationEnabled) {
-            float driven = value * cfg.saturatorDrive;
-            value = driven / (1.0f + ((cfg.saturatorDrive - 1.0f) * std::fabs(driven)));
+        Ym2612Write& write = queue.writes[(queue.head + queue.count) % Ym2612QueueCapacity];
+        write.time = vgm.output_start;
+        write.reg = static_cast<uint16_t>(reg);
+        write.data = data;
+        queue.count++;
+        if (this->ym2612QueuePeak < queue.count) {
+            this->ym2612QueuePeak = static_cast<uint32_t>(queue.count);
         }
-
-        float& postLp = this->ym2612AnalogState.postLpLastOutput[channel];
-        postLp += cfg.postLpAlpha * (value - postLp);
-        value = postLp;
-
-        value = this->applyYm2612AnalogNotch(channel, value);
-
-        value *= cfg.outputGain;
-        return clampUnit(value);
     }
 
-    void generateYm2612Output(std::array<int32_t, OutputChannelCount>& sample)
+    void applyYm2612Writes(emulated_time time)
     {
-        ymfm::ym2612::output_data out;
-        ym2612.generate(&out);
-        sample[0] = out.data[0];
-        sample[1] = out.data[1];
+        auto& queue = this->ym2612_queue;
+        while (queue.count && queue.writes[queue.head].time <= time) {
+            const Ym2612Write& write = queue.writes[queue.head];
+            this->writeYm2612(write.reg, write.data);
+            queue.head = (queue.head + 1) % Ym2612QueueCapacity;
+            queue.count--;
+        }
     }
 
     void primeYm2612Resampler()
     {
+        this->applyYm2612Writes(0);
         this->generateYm2612Output(this->ym2612ResampleState.previousSample);
         this->ym2612ResampleState.previousTime = 0;
         vgm.pos = vgm.step;
+        this->applyYm2612Writes(vgm.pos);
         this->generateYm2612Output(this->ym2612ResampleState.nextSample);
         this->ym2612ResampleState.nextTime = vgm.pos;
+        this->ym2612ResampleState.stepReciprocal = vgm.step ? (1ull << 48) / static_cast<uint64_t>(vgm.step) : 0;
         vgm.pos += vgm.step;
         this->ym2612ResampleState.primed = true;
     }
 
-    void advanceYm2612Resampler(emulated_time targetTime)
+    // generate count chip samples from vgm.pos, applying the queued writes at their time
+    void generateYm2612Block(ymfm::ym2612::output_data* out, size_t count)
+    {
+        while (count) {
+            this->applyYm2612Writes(vgm.pos);
+            size_t chunk = count;
+            if (this->ym2612_queue.count) {
+                const emulated_time until = this->ym2612_queue.writes[this->ym2612_queue.head].time - vgm.pos;
+                chunk = std::min(chunk, static_cast<size_t>((until + vgm.step - 1) / vgm.step));
+            }
+            ym2612.generate(out, static_cast<uint32_t>(chunk));
+            out += chunk;
+            count -= chunk;
+            vgm.pos += vgm.step * static_cast<emulated_time>(chunk);
+        }
+    }
+
+    void renderYm2612Block(int32_t* mixed, int frames)
     {
-        if (!this->ym2612ResampleState.primed) {
+        auto& state = this->ym2612ResampleState;
+        if (!state.primed) {
             this->primeYm2612Resampler();
         }
-        while (this->ym2612ResampleState.nextTime <= targetTime) {
-            this->ym2612ResampleState.previousTime = this->ym2612ResampleState.nextTime;
-            this->ym2612ResampleState.previousSample = this->ym2612ResampleState.nextSample;
-            this->generateYm2612Output(this->ym2612ResampleState.nextSample);
-            this->ym2612ResampleState.nextTime = vgm.pos;
-            vgm.pos += vgm.step;
+
+        // generate every chip sample up to the last output sample of this block in one go
+        const emulated_time lastTime = vgm.output_start + this->output_step * (frames - 1);
+        size_t count = 0;
+        if (state.nextTime <= lastTime) {
+            count = static_cast<size_t>((lastTime - state.nextTime) / vgm.step) + 1;
+        }
+        if (this->ym2612Block.size() < count) {
+            this->ym2612Block.resize(count);
+        }
+        this->generateYm2612Block(this->ym2612Block.data(), count);
+
+        // linear interpolation with a 16-bit fixed point fraction
+        const ymfm::ym2612::output_data* chip = this->ym2612Block.data();
+        emulated_time time = vgm.output_start;
+        for (int i = 0; i < frames; i++, mixed += OutputChannelCount, time += this->output_step) {
+            while (state.nextTime <= time) {
+                state.previousTime = state.nextTime;
+                state.previousSample = state.nextSample;
+                state.nextSample[0] = chip->data[0];
+                state.nextSample[1] = chip->data[1];
+                state.nextTime += vgm.step;
+                chip++;
+            }
+            const int64_t fraction = static_cast<int64_t>((static_cast<uint64_t>(time - state.previousTime) * state.stepReciprocal) >> 32);
+            for (size_t channel = 0; channel < OutputChannelCount; channel++) {
+                const int64_t previous = state.previousSample[channel];
+                const int64_t delta = state.nextSample[channel] - previous;
+                mixed[channel] += static_cast<int32_t>(previous + ((delta * fraction + 0x8000) >> 16));
+            }
         }
+        vgm.output_start = time;
     }
 
-    void sampleYm2612At(emulated_time targetTime, int32_t mixed[OutputChannelCount])
+    static int16_t roundSample(float value)
     {
-        this->advanceYm2612Resampler(targetTime);
+        if (value < -32768.0f) {
+            return -32768;
+        } else if (value > 32767.0f) {
+            return 32767;
+        }
+        return static_cast<int16_t>(value < 0.0f ? value - 0.5f : value + 0.5f);
+    }
 
-        const emulated_time interval = this->ym2612ResampleState.nextTime - this->ym2612ResampleState.previousTime;
-        double fraction = 0.0;
-        if (interval > 0) {
-            fraction = static_cast<double>(targetTime - this->ym2612ResampleState.previousTime) / static_cast<double>(interval);
+    void postProcessBlock(const int32_t* mixed, int16_t* buf, int frames)
+    {
+        // select the variant once per block so that the sample loop has no configuration branches
+        const Ym2612AnalogConfig& cfg = this->ym2612AnalogConfig;
+        if (!cfg.enabled) {
+            if (this->dcCutEnabled) {
+                this->postProcessLegacyBlock<true>(mixed, buf, frames);
+            } else {
+                this->postProcessLegacyBlock<false>(mixed, buf, frames);
+            }
+        } else if (cfg.notchEnabled && 0.0f < cfg.notchMix) {
+            if (cfg.busSaturationEnabled) {
+                this->postProcessYm2612AnalogBlock<true, true>(mixed, buf, frames);
+            } else {
+                this->postProcessYm2612AnalogBlock<false, true>(mixed, buf, frames);
+            }
+        } else {
+            if (cfg.busSaturationEnabled) {
+                this->postProcessYm2612AnalogBlock<true, false>(mixed, buf, frames);
+            } else {
+                this->postProcessYm2612AnalogBlock<false, false>(mixed, buf, frames);
+            }
         }
-        fraction = std::clamp(fraction, 0.0, 1.0);
+    }
 
-        for (size_t channel = 0; channel < OutputChannelCount; channel++) {
-            const double previous = static_cast<double>(this->ym2612ResampleState.previousSample[channel]);
-            const double next = static_cast<double>(this->ym2612ResampleState.nextSample[channel]);
-            mixed[channel] += static_cast<int32_t>(std::lround(previous + ((next - previous) * fraction)));
+    template <bool DcCut>
+    void postProcessLegacyBlock(const int32_t* mixed, int16_t* buf, int frames)
+    {
+        const float amp = this->postAmp;
+        const float alpha = this->dcCutAlpha;
+        float lastInput[OutputChannelCount];
+        float lastOutput[OutputChannelCount];
+        std::copy(this->dcCutLastInput.begin(), this->dcCutLastInput.end(), lastInput);
+        std::copy(this->dcCutLastOutput.begin(), this->dcCutLastOutput.end(), lastOutput);
+
+        const int stride = this->channels < 2 ? 1 : 2;
+        for (int i = 0; i < frames; i++, mixed += OutputChannelCount, buf += stride) {
+            float value[OutputChannelCount];
+            for (size_t ch = 0; ch < OutputChannelCount; ch++) {
+                value[ch] = static_cast<float>(mixed[ch]) * amp;
+                if (DcCut) {
+                    const float filtered = value[ch] - lastInput[ch] + (alpha * lastOutput[ch]);
+                    lastInput[ch] = value[ch];
+                    lastOutput[ch] = filtered;
+                    value[ch] = filtered;
+                }
+            }
+            buf[0] = roundSample(value[0]);
+            if (1 < stride) {
+                buf[1] = roundSample(value[1]);
+            }
         }
+
+        std::copy(lastInput, lastInput + OutputChannelCount, this->dcCutLastInput.begin());
+        std::copy(lastOutput, lastOutput + OutputChannelCount, this->dcCutLastOutput.begin());
     }
 
-    int16_t postProcessSample(size_t channel, int32_t sample)
+    // The stereo pair is processed as two lanes of the same filter chain with the state held in locals.
+    template <bool Saturation, bool Notch>
+    void postProcessYm2612AnalogBlock(const int32_t* mixed, int16_t* buf, int frames)
     {
-        float value = static_cast<float>(sample) * this->postAmp;
-        if (this->ym2612AnalogConfig.enabled) {
-            value = this->applyYm2612AnalogPipeline(channel, value / 32768.0f) * 32768.0f;
-        } else {
-            value = this->applyLegacyDcCut(channel, value);
+        const Ym2612AnalogConfig& cfg = this->ym2612AnalogConfig;
+        const Ym2612AnalogNotchCoefficients& notch = this->ym2612AnalogNotch;
+        Ym2612AnalogState& state = this->ym2612AnalogState;
+        const float inputScale = this->postAmp / 32768.0f;
+        const float saturatorKnee = cfg.saturatorDrive - 1.0f;
+        const float notchDry = 1.0f - cfg.notchMix;
+
+        float hpInput[OutputChannelCount], hpOutput[OutputChannelCount], lp[OutputChannelCount], postLp[OutputChannelCount];
+        float notchIn1[OutputChannelCount], notchIn2[OutputChannelCount], notchOut1[OutputChannelCount], notchOut2[OutputChannelCount];
+        for (size_t ch = 0; ch < OutputChannelCount; ch++) {
+            hpInput[ch] = state.hpLastInput[ch];
+            hpOutput[ch] = state.hpLastOutput[ch];
+            lp[ch] = state.lpLastOutput[ch];
+            postLp[ch] = state.postLpLastOutput[ch];
+            notchIn1[ch] = state.notchInput1[ch];
+            notchIn2[ch] = state.notchInput2[ch];
+            notchOut1[ch] = state.notchOutput1[ch];
+            notchOut2[ch] = state.notchOutput2[ch];
         }
-        if (value < -32768.0f) {
-            value = -32768.0f;
-        } else if (value > 32767.0f) {
-            value = 32767.0f;
+
+        const int stride = this->channels < 2 ? 1 : 2;
+        for (int i = 0; i < frames; i++, mixed += OutputChannelCount, buf += stride) {
+            float value[OutputChannelCount];
+            for (size_t ch = 0; ch < OutputChannelCount; ch++) {
+                // Gentle DC cut keeps the downstream nonlinearity from biasing.
+                const float input = static_cast<float>(mixed[ch]) * inputScale;
+                float v = input - hpInput[ch] + (cfg.hpAlpha * hpOutput[ch]);
+                hpInput[ch] = input;
+                hpOutput[ch] = v;
+
+                // YM2612 character is approximated with a tiny asymmetric curve.
+                const bool positive = v >= 0.0f;
+                const float gain = positive ? cfg.asymPosGain : cfg.asymNegGain;
+                const float curve = positive ? cfg.asymPosCurve : -cfg.asymNegCurve;
+                v = std::clamp((v * gain) + (curve * v * v), -1.0f, 1.0f);
+
+                // A one-pole low-pass lightly rounds the sharpest digital edge.
+                lp[ch] += cfg.lpAlpha * (v - lp[ch]);
+                v = lp[ch];
+
+                // Rational soft clip: x / (1 + k|x|) needs one division and no transcendental.
+                if (Saturation) {
+                    const float driven = v * cfg.saturatorDrive;
+                    v = driven / (1.0f + (saturatorKnee * std::fabs(driven)));
+                }
+
+                postLp[ch] += cfg.postLpAlpha * (v - postLp[ch]);
+                v = postLp[ch];
+
+                if (Notch) {
+                    const float filtered = (notch.b0 * v) + (notch.b1 * notchIn1[ch]) + (notch.b2 * notchIn2[ch]) - (notch.a1 * notchOut1[ch]) - (notch.a2 * notchOut2[ch]);
+                    notchIn2[ch] = notchIn1[ch];
+                    notchIn1[ch] = v;
+                    notchOut2[ch] = notchOut1[ch];
+                    notchOut1[ch] = filtered;
+                    v = (v * notchDry) + (filtered * cfg.notchMix);
+                }
+
+                value[ch] = std::clamp(v * cfg.outputGain, -1.0f, 1.0f) * 32768.0f;
+            }
+            buf[0] = roundSample(value[0]);
+            if (1 < stride) {
+                buf[1] = roundSample(value[1]);
+            }
+        }
+
+        for (size_t ch = 0; ch < OutputChannelCount; ch++) {
+            state.hpLastInput[ch] = hpInput[ch];
+            state.hpLastOutput[ch] = hpOutput[ch];
+            state.lpLastOutput[ch] = lp[ch];
+            state.postLpLastOutput[ch] = postLp[ch];
+            state.notchInput1[ch] = notchIn1[ch];
+            state.notchInput2[ch] = notchIn2[ch];
+            state.notchOutput1[ch] = notchOut1[ch];
+            state.notchOutput2[ch] = notchOut2[ch];
         }
-        return static_cast<int16_t>(std::lround(value));
     }
 
     void updateYm2612Frequency(uint32_t reg, uint8_t data)
@@ -787,81 +1327,100 @@ class VgmDriver : public ymfm::ymfm_interface
         }
     }
 
+    void recordCheckpoints(Program& program)
+    {
+        Ym2612Shadow shadow;
+        shadow.clear();
+        uint32_t position = 0;
+        uint32_t next = 0;
+        for (uint32_t i = 0; i < program.events.size(); i++) {
+            if (program.looped && i == program.loopIndex) {
+                program.loopPosition = position;
+            }
+            if (next <= position) {
+                program.checkpoints.push_back({i, position, shadow});
+                next = position + CheckpointInterval;
+            }
+            const Event& event = program.events[i];
+            if (EventType::Write == event.type) {
+                shadow.write(event.reg, event.data);
+            } else if (EventType::Wait == event.type) {
+                position += event.wait;
+            }
+        }
+        program.length = position;
+        program.checkpoints.shrink_to_fit();
+    }
+
+    // write the shadowed registers to the chip just after reset (frequency MSB/block before LSB, keys at last)
+    void restoreYm2612(const Ym2612Shadow& shadow)
+    {
+        for (uint16_t port = 0; port < 0x200; port += 0x100) {
+            for (uint16_t addr = 0x21; addr < 0x100; addr++) {
+                const uint16_t reg = port | addr;
+                if (0xA0 <= addr && addr < 0xB0) {
+                    continue;
+                }
+                if (shadow.written.test(reg)) {
+                    this->writeYm2612(reg, shadow.regs[reg]);
+                }
+            }
+            for (uint16_t addr = 0xA0; addr < 0xB0; addr++) {
+                // 0xA4-0xA6 (0xAC-0xAE) are latched and committed by the write to 0xA0-0xA2 (0xA8-0xAA)
+                const uint16_t reg = port | (addr ^ 0x04);
+                if (0x03 != (addr & 0x03) && shadow.written.test(reg)) {
+                    this->writeYm2612(reg, shadow.regs[reg]);
+                }
+            }
+        }
+        for (int code = 0; code < 8; code++) {
+            if (shadow.keysWritten & (1 << code)) {
+                this->writeYm2612(0x28, shadow.keys[code]);
+            }
+        }
+    }
+
+    // VGM waits are in 44100Hz samples: convert them to output frames carrying the remainder
+    void addWait(uint32_t samples)
+    {
+        vgm.waitFraction += static_cast<uint64_t>(samples) * this->outputRate;
+        vgm.wait += static_cast<int32_t>(vgm.waitFraction / VgmSampleRate);
+        vgm.waitFraction %= VgmSampleRate;
+    }
+
+    void putCompileLog(bool isError, const char* msg)
+    {
+        if (subscribedLog) {
+            logCallback(isError, msg);
+        }
+    }
+
     void execute()
     {
-        if (!vgm.data || vgm.end) {
+        if (!vgm.program || vgm.end) {
             return;
         }
-        static uint32_t seq;
+        const Event* events = vgm.program->events.data();
         while (vgm.wait < 1) {
-            uint8_t cmd = vgm.data[vgm.cursor++];
-            switch (cmd) {
-                case 0x52:
-                case 0xA2: {
-                    // YM2612 port 0, write value dd to register aa
-                    uint32_t reg = vgm.data[vgm.cursor++];
-                    uint8_t data = vgm.data[vgm.cursor++];
-                    ym2612_queue.push_back(std::make_pair(reg, data));
+            const Event& event = events[vgm.cursor++];
+            switch (event.type) {
+                case EventType::Write:
+                    this->enqueueYm2612(event.reg, event.data);
                     break;
-                }
-                case 0x53:
-                case 0xA3: {
-                    // YM2612 port 1, write value dd to register aa
-                    uint32_t reg = vgm.data[vgm.cursor++];
-                    uint8_t data = vgm.data[vgm.cursor++];
-                    ym2612_queue.push_back(std::make_pair(reg | 0x100, data));
+                case EventType::Wait:
+                    this->addWait(event.wait);
                     break;
-                }
-
-                case 0x61: {
-                    // Wait nn samples
-                    unsigned short nn;
-                    memcpy(&nn, &vgm.data[vgm.cursor], 2);
-                    vgm.cursor += 2;
-                    vgm.wait += nn;
-                    break;
-                }
-                case 0x62: vgm.wait += 735; break;
-                case 0x63: vgm.wait += 882; break;
-                case 0x66: {
-                    // End of sound data
-                    if (vgm.loopOffset) {
-                        vgm.cursor = vgm.loopOffset;
+                case EventType::End:
+                    if (vgm.program->looped) {
+                        vgm.cursor = vgm.program->loopIndex;
+                        vgm.position = vgm.program->loopPosition;
+                        vgm.positionFraction = 0;
                         vgm.loopCount++;
                         break;
                     } else {
                         vgm.end = true;
                         return;
                     }
-                }
-
-                case 0x90: // Setup Stream Control: 0x90 ss tt pp cc (ignore)
-                case 0x91: // Set Stream Data: 0x91 ss dd ll bb (ignore)
-                case 0x95: // Start Stream (fast call): 0x95 ss bb bb ff
-                    // printf("[DAC]0x%02X: %02X %02X %02X %02X\n", cmd, vgm.data[0], vgm.data[1], vgm.data[2], vgm.data[3]);
-                    vgm.cursor += 4;
-                    break;
-
-                case 0x92: // Set Stream Frequency: 0x92 ss ff ff ff ff (ignore)
-                    // printf("[DAC]0x%02X: %02X %02X %02X %02X %02X\n", cmd, vgm.data[0], vgm.data[1], vgm.data[2], vgm.data[3], vgm.data[4]);
-                    vgm.cursor += 5;
-                    break;
-
-                case 0x93: // Start Stream: 0x93 ss aa aa aa aa mm ll ll ll ll (ignored)
-                    // printf("[DAC]0x%02X: %02X %02X %02X %02X %02X %02X %02X %02X %02X %02X\n", cmd, vgm.data[0], vgm.data[1], vgm.data[2], vgm.data[3], vgm.data[4], vgm.data[5], vgm.data[6], vgm.data[7], vgm.data[8], vgm.data[9]);
-                    vgm.cursor += 10;
-                    break;
-
-                case 0x94: // Stop Stream: 0x94 ss
-                    // printf("[DAC]0x%02X: %02X\n", cmd, vgm.data[0]);
-                    vgm.cursor++;
-                    break;
-
-                default:
-                    // unsupported command
-                    printf("Detected an unknown VGM command: %02X\n", cmd);
-                    vgm.end = true;
-                    return;
             }
         }
     }
@@ -38,12 +38,22 @@
 #define VGS_ADDR_ANGLE_DEGREE 0xE00110
 #define VGS_ADDR_ANGLE_SIN 0xE00114
 #define VGS_ADDR_ANGLE_COS 0xE00118
+#define VGS_ADDR_MATH_SOURCE 0xE00200
+#define VGS_ADDR_MATH_DESTINATION 0xE00204
+#define VGS_ADDR_MATH_COUNT 0xE00208
+#define VGS_ADDR_MATH_ARGUMENT 0xE0020C
+#define VGS_ADDR_MATH_EXECUTE 0xE00210
 #define VGS_ADDR_VGM_PLAY 0xE01000
 #define VGS_ADDR_VGM_PLAY_OPT 0xE01004
 #define VGS_ADDR_VGM_MASTER 0xE01008
+#define VGS_ADDR_VGM_POSITION 0xE0100C
+#define VGS_ADDR_VGM_LENGTH 0xE01010
+#define VGS_ADDR_VGM_LOOP_POSITION 0xE01014
 #define VGS_ADDR_SFX_PLAY 0xE01100
 #define VGS_ADDR_SFX_STOP 0xE01104
 #define VGS_ADDR_SFX_MASTER 0xE01108
+#define VGS_ADDR_SFX_VOLUME 0xE0110C
+#define VGS_ADDR_SFX_PAN 0xE01110
 #define VGS_ADDR_KEY_UP 0xE02000
 #define VGS_ADDR_KEY_DOWN 0xE02004
 #define VGS_ADDR_KEY_LEFT 0xE02008
@@ -126,6 +136,20 @@
 #define VGS_ADDR_SW_PUSH7 0xE0701C
 #define VGS_ADDR_SW_PUSH8 0xE07020
 #define VGS_ADDR_SW_PUSH9 0xE07024
+#define VGS_ADDR_HIT_A_FIRST 0xE08000
+#define VGS_ADDR_HIT_A_LAST 0xE08004
+#define VGS_ADDR_HIT_A_MASK 0xE08008
+#define VGS_ADDR_HIT_B_FIRST 0xE0800C
+#define VGS_ADDR_HIT_B_LAST 0xE08010
+#define VGS_ADDR_HIT_B_MASK 0xE08014
+#define VGS_ADDR_HIT_MODE 0xE08018
+#define VGS_ADDR_HIT_BUFFER 0xE0801C
+#define VGS_ADDR_HIT_LIMIT 0xE08020
+#define VGS_ADDR_HIT_EXECUTE 0xE08024
+#define VGS_ADDR_PERF_CLOCKS 0xE09000
+#define VGS_ADDR_PERF_LAST_CLOCKS 0xE09004
+#define VGS_ADDR_PERF_TOTAL_CLOCKS 0xE09008
+#define VGS_ADDR_PERF_RENDER_TIME 0xE0900C
 #define VGS_ADDR_ABORT 0xE7FFF4
 #define VGS_ADDR_RESET 0xE7FFF8
 #define VGS_ADDR_EXIT 0xE7FFFC
@@ -145,12 +169,22 @@
 #define VGS_IO_ANGLE_DEGREE *((volatile int32_t*)VGS_ADDR_ANGLE_DEGREE)
 #define VGS_IN_ANGLE_SIN *((volatile int32_t*)VGS_ADDR_ANGLE_SIN)
 #define VGS_IN_ANGLE_COS *((volatile int32_t*)VGS_ADDR_ANGLE_COS)
+#define VGS_OUT_MATH_SOURCE *((volatile uint32_t*)VGS_ADDR_MATH_SOURCE)
+#define VGS_OUT_MATH_DESTINATION *((volatile uint32_t*)VGS_ADDR_MATH_DESTINATION)
+#define VGS_OUT_MATH_COUNT *((volatile uint32_t*)VGS_ADDR_MATH_COUNT)
+#define VGS_OUT_MATH_ARGUMENT *((volatile int32_t*)VGS_ADDR_MATH_ARGUMENT)
+#define VGS_IO_MATH_EXECUTE *((volatile uint32_t*)VGS_ADDR_MATH_EXECUTE)
 #define VGS_OUT_VGM_PLAY *((volatile uint32_t*)VGS_ADDR_VGM_PLAY)
 #define VGS_OUT_VGM_PLAY_OPT *((volatile uint32_t*)VGS_ADDR_VGM_PLAY_OPT)
 #define VGS_IO_VGM_MASTER *((volatile uint32_t*)VGS_ADDR_VGM_MASTER)
+#define VGS_IO_VGM_POSITION *((volatile uint32_t*)VGS_ADDR_VGM_POSITION)
+#define VGS_IN_VGM_LENGTH *((volatile uint32_t*)VGS_ADDR_VGM_LENGTH)
+#define VGS_IN_VGM_LOOP_POSITION *((volatile uint32_t*)VGS_ADDR_VGM_LOOP_POSITION)
 #define VGS_OUT_SFX_PLAY *((volatile uint32_t*)VGS_ADDR_SFX_PLAY)
 #define VGS_OUT_SFX_STOP *((volatile uint32_t*)VGS_ADDR_SFX_STOP)
 #define VGS_IO_SFX_MASTER *((volatile uint32_t*)VGS_ADDR_SFX_MASTER)
+#define VGS_OUT_SFX_VOLUME *((volatile uint32_t*)VGS_ADDR_SFX_VOLUME)
+#define VGS_OUT_SFX_PAN *((volatile uint32_t*)VGS_ADDR_SFX_PAN)
 #define VGS_KEY_UP *((volatile uint32_t*)VGS_ADDR_KEY_UP)
 #define VGS_KEY_DOWN *((volatile uint32_t*)VGS_ADDR_KEY_DOWN)
 #define VGS_KEY_LEFT *((volatile uint32_t*)VGS_ADDR_KEY_LEFT)
@@ -233,6 +267,20 @@
 #define VGS_IN_SW_PUSH7 *((volatile uint32_t*)VGS_ADDR_SW_PUSH7)
 #define VGS_IN_SW_PUSH8 *((volatile uint32_t*)VGS_ADDR_SW_PUSH8)
 #define VGS_IN_SW_PUSH9 *((volatile uint32_t*)VGS_ADDR_SW_PUSH9
+#define VGS_IO_HIT_A_FIRST *((volatile uint32_t*)VGS_ADDR_HIT_A_FIRST)
+#define VGS_IO_HIT_A_LAST *((volatile uint32_t*)VGS_ADDR_HIT_A_LAST)
+#define VGS_IO_HIT_A_MASK *((volatile uint32_t*)VGS_ADDR_HIT_A_MASK)
+#define VGS_IO_HIT_B_FIRST *((volatile uint32_t*)VGS_ADDR_HIT_B_FIRST)
+#define VGS_IO_HIT_B_LAST *((volatile uint32_t*)VGS_ADDR_HIT_B_LAST)
+#define VGS_IO_HIT_B_MASK *((volatile uint32_t*)VGS_ADDR_HIT_B_MASK)
+#define VGS_IO_HIT_MODE *((volatile uint32_t*)VGS_ADDR_HIT_MODE)
+#define VGS_IO_HIT_BUFFER *((volatile uint32_t*)VGS_ADDR_HIT_BUFFER)
+#define VGS_IO_HIT_LIMIT *((volatile uint32_t*)VGS_ADDR_HIT_LIMIT)
+#define VGS_IO_HIT_EXECUTE *((volatile uint32_t*)VGS_ADDR_HIT_EXECUTE)
+#define VGS_IN_PERF_CLOCKS *((volatile uint32_t*)VGS_ADDR_PERF_CLOCKS)
+#define VGS_IN_PERF_LAST_CLOCKS *((volatile uint32_t*)VGS_ADDR_PERF_LAST_CLOCKS)
+#define VGS_IN_PERF_TOTAL_CLOCKS *((volatile uint32_t*)VGS_ADDR_PERF_TOTAL_CLOCKS)
+#define VGS_IN_PERF_RENDER_TIME *((volatile uint32_t*)VGS_ADDR_PERF_RENDER_TIME)
 #define VGS_OUT_ABORT *((volatile int32_t*)VGS_ADDR_ABORT)
 #define VGS_OUT_RESET *((volatile int32_t*)VGS_ADDR_RESET)
 #define VGS_OUT_EXIT *((volatile int32_t*)VGS_ADDR_EXIT)
@@ -241,11 +289,21 @@
 #define VGS_DMA_MEMCPY 0
 #define VGS_DMA_MEMSET 1
 #define VGS_DMA_UTF8_TO_SJIS 2
+#define VGS_DMA_SORT 3
+
+#define VGS_DMA_SORT_LAYOUT(size, offset) (((uint32_t)(size) & 0xFFFF) | (((uint32_t)(offset) & 0xFF) << 16))
+#define VGS_DMA_SORT_KEY16 0x00000000
+#define VGS_DMA_SORT_KEY32 0x01000000
+#define VGS_DMA_SORT_SIGNED 0x02000000
+#define VGS_DMA_SORT_DESCENDING 0x04000000
 
 #define VGS_VGM_OPT_PAUSE 0
 #define VGS_VGM_OPT_RESUME 1
 #define VGS_VGM_OPT_FADEOUT 2
 #define VGS_MASTER_VOLUME_MAX 256
+#define VGS_SFX_PAN_LEFT 0
+#define VGS_SFX_PAN_CENTER 128
+#define VGS_SFX_PAN_RIGHT 255
 
 #define VGS_KEY_ID_UNKNOWN 0
 #define VGS_KEY_ID_KEYBOARD 1
@@ -268,3 +326,17 @@
 #define VGS_BUTTON_ID_SPACE 12
 #define VGS_BUTTON_ID_PLUS 13
 #define VGS_BUTTON_ID_OPTIONS 14
+
+#define VGS_MATH_SIN 0
+#define VGS_MATH_COS 1
+#define VGS_MATH_DEGREE 2
+#define VGS_MATH_SQRT 3
+#define VGS_MATH_HYPOT 4
+#define VGS_MATH_NORMALIZE 5
+#define VGS_MATH_ROTATE 6
+#define VGS_MATH_MAC 7
+
+#define VGS_HIT_MODE_RECT 0x00
+#define VGS_HIT_MODE_PIXEL 0x01
+#define VGS_HIT_MODE_PAIRS 0x00
+#define VGS_HIT_MODE_BITMASK 0x02
@@ -24,6 +24,8 @@
  */
 
 #include <algorithm>
+#include <chrono>
+#include <numeric>
 #include <stdarg.h>
 #include <math.h>
 #include <vector>
@@ -42,6 +44,7 @@ static VGSX* g_vgsx_instance = nullptr;
 VGSX vgsx;
 
 #define FADEOUT_FRAMES 100
+#define STATE_VERSION 3
 
 extern "C" {
 extern const int vgsx_sin[360];
@@ -491,6 +494,7 @@ extern "C" void m68k_write_memory_8(uint32_t address, uint32_t value)
 {
     if (0xF00000 <= address) {
         vgsx.ctx.ram[address & 0xFFFFF] = value & 0xFF;
+        vgsx.ramDirty.mark(address & 0xFFFFF);
     }
 }
 
@@ -531,7 +535,10 @@ static int illegal_instruction_logger(int opcode)
 VGSX::VGSX()
 {
     strcpy(this->saveDataDir, "./");
-    this->vgmdrv = new VgmDriver(44100, 2);
+    this->sampleRate = 44100;
+    memset(&this->audioStats, 0, sizeof(this->audioStats));
+    this->renderMicros = 0;
+    this->vgmdrv = new VgmDriver(this->sampleRate, 2);
     ((VgmDriver*)this->vgmdrv)->subscribeLog([&](bool isError, const char* msg) {
         putlog(isError ? LogLevel::E : LogLevel::I, "%s", msg);
     });
@@ -541,6 +548,10 @@ VGSX::VGSX()
     this->gamepadType = GamepadType::Keyboard;
     this->logCallback = {};
     this->consoleCallback = {};
+    this->frameCallback = {};
+    this->soundCallback = {};
+    this->telemetryCallback = {};
+    this->vdp.telemetry = &this->telemetry;
     this->consoleBufferLength = 0;
     this->consoleBuffer[0] = '\0';
     this->bootBios = true;
@@ -555,6 +566,22 @@ VGSX::VGSX()
     g_vgsx_instance = this;
     m68k_set_illg_instr_callback(illegal_instruction_logger);
     this->vdp.setCpuRam(this->ctx.ram);
+    this->programHash = 0;
+    for (auto& stream : this->sfxStreams) {
+        stream.table = nullptr;
+        stream.base = 0;
+        stream.frames = 0;
+    }
+    this->rewindLimit = 0;
+    this->speculative = false;
+    this->movieMode = MovieMode::None;
+    this->movieClock = 0;
+    this->movieUtcOffset = 0;
+    memset(&this->movieFrame, 0, sizeof(this->movieFrame));
+    this->rewindBuffer.addRegion(this->ctx.ram, sizeof(this->ctx.ram), this->ramDirty.bits);
+    this->rewindBuffer.addRegion(&this->vdp.ctx.ptn[0][0], sizeof(this->vdp.ctx.ptn), this->vdp.ptnDirty.bits);
+    this->rewindBuffer.addRegion((uint8_t*)this->vdp.ctx.nametbl, sizeof(this->vdp.ctx.nametbl), this->vdp.nametblDirty.bits);
+    this->rewindBuffer.addRegion((uint8_t*)this->vdp.ctx.oam, sizeof(this->vdp.ctx.oam), this->vdp.oamDirty.bits);
     this->reset();
 }
 
@@ -563,6 +590,73 @@ VGSX::~VGSX()
     delete (VgmDriver*)this->vgmdrv;
 }
 
+void VGSX::setSampleRate(int rate)
+{
+    if (rate < 8000 || 192000 < rate) {
+        putlog(LogLevel::W, "Ignored an invalid sampling rate (%d)", rate);
+        return;
+    }
+    if (rate == this->sampleRate) {
+        return;
+    }
+    this->sampleRate = rate;
+    ((VgmDriver*)this->vgmdrv)->setOutputSampleRate(rate);
+    this->sincTables.clear();
+    for (int i = 0; i < 0x100; i++) {
+        this->sfxStop((uint8_t)i);
+        if (this->ctx.sfxData[i].data) {
+            this->prepareSfx((uint8_t)i);
+        }
+    }
+}
+
+VGSX::AudioStats VGSX::getAudioStats()
+{
+    AudioStats stats = this->audioStats;
+    stats.ym2612QueuePeak = ((VgmDriver*)this->vgmdrv)->getYm2612QueuePeak();
+    stats.ym2612QueueOverflows = ((VgmDriver*)this->vgmdrv)->getYm2612QueueOverflows();
+    return stats;
+}
+
+void VGSX::resetAudioStats()
+{
+    memset(&this->audioStats, 0, sizeof(this->audioStats));
+    ((VgmDriver*)this->vgmdrv)->resetYm2612QueueStats();
+}
+
+// The host reports what the audio device did with the rendered samples (call it from the same thread as tickSound)
+void VGSX::reportAudioDevice(uint32_t consumedSamples, uint32_t underruns, uint32_t overruns)
+{
+    this->audioStats.consumedSamples += consumedSamples;
+    this->audioStats.underruns += underruns;
+    this->audioStats.overruns += overruns;
+}
+
+// Record the per-frame telemetry and hand each record over to the callback when the next tick starts (empty: stop)
+void VGSX::setTelemetryCallback(std::function<void(const Telemetry::Frame& frame)> callback)
+{
+    this->telemetryCallback = std::move(callback);
+    this->telemetry.enabled = this->telemetryCallback ? true : false;
+    this->telemetry.restart();
+}
+
+// Hand the record of the last tick over to the callback (call it at the end of the session)
+void VGSX::flushTelemetry()
+{
+    if (this->telemetry.enabled && this->telemetry.frame.spanCount) {
+        this->telemetryCallback(this->telemetry.frame);
+        this->telemetry.clear();
+    }
+}
+
+// The host reports the time spent to present the frame (startNanos: Telemetry::now at the start)
+void VGSX::reportPresent(uint64_t startNanos)
+{
+    if (this->telemetry.enabled) {
+        this->telemetry.span(Telemetry::Span::Present, startNanos);
+    }
+}
+
 void VGSX::setYm2612AnalogEnabled(bool enabled)
 {
     ((VgmDriver*)this->vgmdrv)->setYm2612AnalogEnabled(enabled);
@@ -593,6 +687,383 @@ void VGSX::useYm2612AnalogWarmPreset()
     ((VgmDriver*)this->vgmdrv)->useYm2612AnalogWarmPreset();
 }
 
+bool VGSX::seekVgm(uint32_t position)
+{
+    return ((VgmDriver*)this->vgmdrv)->seek(position);
+}
+
+uint32_t VGSX::getVgmPosition()
+{
+    return ((VgmDriver*)this->vgmdrv)->getPosition();
+}
+
+uint32_t VGSX::getVgmLength()
+{
+    return ((VgmDriver*)this->vgmdrv)->getLength();
+}
+
+uint32_t VGSX::getVgmLoopPosition()
+{
+    return ((VgmDriver*)this->vgmdrv)->getLoopPosition();
+}
+
+// Save state header (followed by the fields in the order of VGSX::saveRestore)
+struct StateHeader {
+    char magic[4];       // "VGSS"
+    uint32_t version;    // STATE_VERSION
+    uint32_t sampleRate; // output sampling rate
+    uint32_t reserved;
+    uint64_t programHash; // hash of the program loaded when saved
+};
+
+// Serializer of the save states: VGSX::saveRestore walks the same fields to save, to verify and to restore them
+class VGSX::StateArchive
+{
+  public:
+    enum class Mode {
+        Save,    // append the fields to the buffer
+        Verify,  // check the bounds without modifying the machine
+        Restore, // overwrite the machine with the fields
+    };
+
+    StateArchive(std::vector<uint8_t>& buffer, size_t offset, bool pages = true)
+    {
+        this->mode = Mode::Save;
+        this->pages = pages;
+        this->buffer = &buffer;
+        this->source = nullptr;
+        this->sourceSize = 0;
+        this->offset = offset;
+        this->error = false;
+    }
+
+    StateArchive(Mode mode, const uint8_t* source, size_t sourceSize, bool pages = true)
+    {
+        this->mode = mode;
+        this->pages = pages;
+        this->buffer = nullptr;
+        this->source = source;
+        this->sourceSize = sourceSize;
+        this->offset = 0;
+        this->error = false;
+    }
+
+    inline bool saving() const { return Mode::Save == this->mode; }
+    inline bool restoring() const { return Mode::Restore == this->mode; }
+    inline bool includesPages() const { return this->pages; } // false: WRAM and VDP memory are left to the rewind buffer
+    inline bool failed() const { return this->error; }
+    inline size_t getOffset() const { return this->offset; }
+    inline void fail() { this->error = true; }
+
+    // machine fields (not modified while verifying)
+    void data(void* ptr, size_t size)
+    {
+        if (this->saving()) {
+            this->write(ptr, size);
+        } else if (this->readable(size)) {
+            if (this->restoring()) {
+                memcpy(ptr, &this->source[this->offset], size);
+            }
+            this->offset += size;
+        }
+    }
+
+    // control values such as sizes and counts (read while verifying too)
+    void scratch(void* ptr, size_t size)
+    {
+        if (this->saving()) {
+            this->write(ptr, size);
+        } else if (this->readable(size)) {
+            memcpy(ptr, &this->source[this->offset], size);
+            this->offset += size;
+        }
+    }
+
+  private:
+    Mode mode;
+    bool pages;
+    std::vector<uint8_t>* buffer;
+    const uint8_t* source;
+    size_t sourceSize;
+    size_t offset;
+    bool error;
+
+    void write(const void* ptr, size_t size)
+    {
+        if (this->buffer->size() < this->offset + size) {
+            this->buffer->resize(std::max(this->offset + size, this->buffer->size() * 2));
+        }
+        memcpy(&(*this->buffer)[this->offset], ptr, size);
+        this->offset += size;
+    }
+
+    bool readable(size_t size)
+    {
+        if (this->error || this->sourceSize - this->offset < size) {
+            this->error = true;
+            return false;
+        }
+        return true;
+    }
+};
+
+void VGSX::saveRestore(StateArchive& state)
+{
+    // CPU (the callbacks and the cycle tables of the running context are kept)
+    m68ki_cpu_core cpu;
+    m68k_get_context(&cpu);
+    state.data(&cpu, offsetof(m68ki_cpu_core, cyc_instruction));
+    if (state.restoring()) {
+        m68k_set_context(&cpu);
+    }
+
+    // WRAM and the I/O state (the ROM data is not saved)
+    if (state.includesPages()) {
+        state.data(this->ctx.ram, sizeof(this->ctx.ram));
+        if (state.restoring()) {
+            this->ramDirty.markAll();
+        }
+    }
+    state.data(&this->ctx.randomIndex, sizeof(this->ctx.randomIndex));
+    state.data(&this->ctx.frameClocks, sizeof(this->ctx.frameClocks));
+    state.data(&this->ctx.dma, sizeof(this->ctx.dma));
+    state.data(&this->ctx.angle, sizeof(this->ctx.angle));
+    state.data(&this->ctx.math, sizeof(this->ctx.math));
+    state.data(&this->ctx.save, sizeof(this->ctx.save));
+    state.data(&this->ctx.getNameId, sizeof(this->ctx.getNameId));
+    state.data(&this->ctx.vgmPause, sizeof(this->ctx.vgmPause));
+    state.data(&this->ctx.vgmFadeout, sizeof(this->ctx.vgmFadeout));
+    state.data(&this->ctx.vgmMasterVolume, sizeof(this->ctx.vgmMasterVolume));
+    state.data(&this->ctx.sfxMasterVolume, sizeof(this->ctx.sfxMasterVolume));
+    state.data(&this->ctx.fmChip, sizeof(this->ctx.fmChip));
+    state.data(&this->ctx.fmOffset, sizeof(this->ctx.fmOffset));
+    state.data(&this->ctx.mouse, sizeof(this->ctx.mouse));
+    state.data(&this->ctx.hit, sizeof(this->ctx.hit));
+    state.data(&this->ctx.perf, sizeof(this->ctx.perf));
+    for (SequencialData* sq : {&this->ctx.sqw, &this->ctx.sqr}) {
+        uint32_t size = sq->size;
+        state.scratch(&size, sizeof(size));
+        if (sizeof(sq->buffer) < size) {
+            state.fail();
+            return;
+        }
+        state.data(sq->buffer, size);
+        state.data(&sq->readOffset, sizeof(sq->readOffset));
+        state.data(&sq->index, sizeof(sq->index));
+        if (state.restoring()) {
+            sq->size = size;
+        }
+    }
+    state.data(&this->key, sizeof(this->key));
+    uint16_t length = this->consoleBufferLength;
+    state.scratch(&length, sizeof(length));
+    if (sizeof(this->consoleBuffer) <= length) {
+        state.fail();
+        return;
+    }
+    state.data(this->consoleBuffer, length);
+    if (state.restoring()) {
+        this->consoleBufferLength = length;
+        this->consoleBuffer[length] = '\0';
+    }
+    state.data(&this->exitFlag, sizeof(this->exitFlag));
+    state.data(&this->exitCode, sizeof(this->exitCode));
+
+    // SFX voices (the active list is rebuilt from the play flags)
+    for (int i = 0; i < 0x100; i++) {
+        SfxData& sfx = this->ctx.sfxData[i];
+        state.data(&sfx.play, sizeof(sfx.play));
+        state.data(&sfx.index, sizeof(sfx.index));
+        state.data(&sfx.volume, sizeof(sfx.volume));
+        state.data(&sfx.pan, sizeof(sfx.pan));
+        state.data(&sfx.decoder, sizeof(sfx.decoder));
+    }
+    if (state.restoring()) {
+        this->ctx.sfxActiveCount = 0;
+        for (int i = 0; i < 0x100; i++) {
+            this->ctx.sfxData[i].play = this->ctx.sfxData[i].play && this->ctx.sfxData[i].data;
+            if (this->ctx.sfxData[i].play) {
+                this->ctx.sfxActive[this->ctx.sfxActiveCount++] = (uint8_t)i;
+            }
+        }
+    }
+
+    this->vdp.saveRestore(state);
+
+    // BGM (the program is loaded from its slot again before its playback state is restored)
+    auto helper = (VgmDriver*)this->vgmdrv;
+    int32_t slot = helper->getProgramSlot();
+    state.scratch(&slot, sizeof(slot));
+    if (slot < -1 || 0xFFFF < slot || (0 <= slot && !this->ctx.vgmData[slot].data)) {
+        state.fail();
+        return;
+    }
+    if (state.restoring()) {
+        if (0 <= slot) {
+            helper->load((uint16_t)slot, this->ctx.vgmData[slot].data, this->ctx.vgmData[slot].size);
+        } else {
+            helper->reset();
+        }
+    }
+    helper->saveRestore(state);
+}
+
+void VGSX::saveState(std::vector<uint8_t>& state)
+{
+    StateHeader header;
+    memcpy(header.magic, "VGSS", 4);
+    header.version = STATE_VERSION;
+    header.sampleRate = (uint32_t)this->sampleRate;
+    header.reserved = 0;
+    header.programHash = this->programHash;
+    StateArchive archive(state, 0);
+    archive.scratch(&header, sizeof(header));
+    this->saveRestore(archive);
+    state.resize(archive.getOffset());
+}
+
+bool VGSX::loadState(const void* data, size_t size)
+{
+    StateHeader header;
+    if (!data || size < sizeof(header)) {
+        setLastError("Invalid state size: %d", (int)size);
+        return false;
+    }
+    memcpy(&header, data, sizeof(header));
+    if (0 != memcmp(header.magic, "VGSS", 4) || STATE_VERSION != header.version) {
+        setLastError("Unsupported state format");
+        return false;
+    }
+    if (header.sampleRate != (uint32_t)this->sampleRate) {
+        setLastError("The state was saved at %uHz (current: %dHz)", header.sampleRate, this->sampleRate);
+        return false;
+    }
+    if (header.programHash != this->programHash) {
+        setLastError("The state was saved with another program");
+        return false;
+    }
+
+    // check the whole state before modifying the machine
+    const uint8_t* body = (const uint8_t*)data + sizeof(header);
+    const size_t bodySize = size - sizeof(header);
+    StateArchive verify(StateArchive::Mode::Verify, body, bodySize);
+    this->saveRestore(verify);
+    if (verify.failed() || verify.getOffset() != bodySize) {
+        setLastError("Broken state");
+        return false;
+    }
+    StateArchive restore(StateArchive::Mode::Restore, body, bodySize);
+    this->saveRestore(restore);
+    return true;
+}
+
+void VGSX::setRewindLimit(size_t bytes)
+{
+    this->rewindLimit = bytes;
+    if (0 == bytes) {
+        this->rewindBuffer.clear();
+    } else {
+        this->rewindBuffer.setLimit(bytes);
+    }
+}
+
+bool VGSX::rewind()
+{
+    if (!this->rewindBuffer.pop(this->rewindCore)) {
+        return false;
+    }
+    StateArchive archive(StateArchive::Mode::Restore, this->rewindCore.data(), this->rewindCore.size(), false);
+    this->saveRestore(archive);
+    this->render();
+    return true;
+}
+
+bool VGSX::startRecording()
+{
+    if (!this->ctx.elf) {
+        this->setLastError("No program is loaded.");
+        return false;
+    }
+    this->movie.clear(this->programHash);
+    memset(&this->movieFrame, 0, sizeof(this->movieFrame));
+    this->reset();
+    this->movieMode = MovieMode::Recording;
+    return true;
+}
+
+bool VGSX::stopRecording(std::vector<uint8_t>& movie)
+{
+    if (MovieMode::Recording != this->movieMode) {
+        this->setLastError("Not recording.");
+        return false;
+    }
+    this->movie.save(movie);
+    this->movieMode = MovieMode::None;
+    return true;
+}
+
+bool VGSX::startReplay(const void* data, size_t size)
+{
+    InputMovie replay;
+    const char* error = replay.load(data, size);
+    if (error) {
+        this->setLastError("%s", error);
+        return false;
+    }
+    if (!this->ctx.elf || replay.getProgramHash() != this->programHash) {
+        this->setLastError("The movie was recorded with a different program.");
+        return false;
+    }
+    this->movie = std::move(replay);
+    this->reset();
+    this->movieMode = MovieMode::Replaying;
+    return true;
+}
+
+// Seconds east of UTC of the local time at the clock (tm_gmtoff is not portable)
+static int32_t getUtcOffset(time_t clock)
+{
+    const struct tm utc = *gmtime(&clock);
+    const struct tm local = *localtime(&clock);
+    int days = local.tm_yday - utc.tm_yday;
+    if (local.tm_year != utc.tm_year) {
+        days = local.tm_year < utc.tm_year ? -1 : 1;
+    }
+    return ((days * 24 + local.tm_hour - utc.tm_hour) * 60 + local.tm_min - utc.tm_min) * 60 + local.tm_sec - utc.tm_sec;
+}
+
+// Record or replay the inputs of the frame (called at the start of every frame that is not rolled back)
+void VGSX::updateMovie()
+{
+    static_assert(sizeof(KeyStatus) == sizeof(InputMovie::Frame::key), "KeyStatus does not match the movie format");
+    if (MovieMode::Recording == this->movieMode) {
+        memcpy(this->movieFrame.key, &this->key, sizeof(this->movieFrame.key));
+        this->movieFrame.clock = (int64_t)time(nullptr);
+        this->movieFrame.utcOffset = getUtcOffset((time_t)this->movieFrame.clock);
+        this->movieClock = this->movieFrame.clock;
+        this->movieUtcOffset = this->movieFrame.utcOffset;
+        this->movie.append(this->movieFrame);
+        this->movieFrame.mouse = false;
+        this->movieFrame.samples = 0;
+        return;
+    }
+    InputMovie::Frame frame;
+    if (!this->movie.next(frame)) {
+        this->movieMode = MovieMode::None;
+        this->movieClock = 0;
+        return;
+    }
+    memcpy(&this->key, frame.key, sizeof(frame.key));
+    this->movieClock = frame.clock;
+    this->movieUtcOffset = frame.utcOffset;
+    if (frame.mouse) {
+        this->applyMouse(frame.mouseX, frame.mouseY, frame.left, frame.right, frame.scrV, frame.scrH);
+    }
+    if (this->movie.getFrames() <= this->movie.getPosition()) {
+        this->movieMode = MovieMode::None; // the host takes over the inputs from the next frame
+    }
+}
+
 void VGSX::setLastError(const char* format, ...)
 {
     va_list args;
@@ -666,6 +1137,7 @@ bool VGSX::extractRom(const uint8_t* program, int programSize)
         this->setLastError("Invalid ROM header.");
         return false;
     }
+    this->rewindBuffer.clear(); // the frames of the previous ROM cannot be restored
     const uint8_t* ptr = program + 8;
     programSize -= 8;
     int pindex = 0;
@@ -776,8 +1248,10 @@ bool VGSX::loadProgram(const void* data, size_t size)
         return false;
     }
 
+    this->rewindBuffer.clear(); // the frames of the previous program cannot be restored
     this->ctx.elf = (const uint8_t*)data;
     this->ctx.elfSize = size;
+    this->programHash = hashMemory(data, size);
     this->reset();
     return true;
 }
@@ -786,6 +1260,9 @@ bool VGSX::loadVgm(uint16_t index, const void* data, size_t size)
 {
     this->ctx.vgmData[index].data = (const uint8_t*)data;
     this->ctx.vgmData[index].size = size;
+    if (!((VgmDriver*)this->vgmdrv)->compile(index, (const uint8_t*)data, size)) {
+        this->putlog(LogLevel::W, "VGM #%d is not playable", (int)index);
+    }
     return true;
 }
 
@@ -793,7 +1270,6 @@ bool VGSX::loadWav(uint8_t index, const void* data, size_t size)
 {
     const uint8_t* wav = (const uint8_t*)data;
     int n;
-    unsigned short s;
 
     if (0 != memcmp(wav, "RIFF", 4)) {
         this->setLastError("Invalid wav format: RIFF not exist");
@@ -822,6 +1298,9 @@ bool VGSX::loadWav(uint8_t index, const void* data, size_t size)
     int bps = 0;
     short bs = 0;
     short bits = 0;
+    unsigned short format = 0;
+    unsigned short samplesPerBlock = 0;
+    int factFrames = -1;
 
     // parse and check the chunks
     while (1) {
@@ -829,40 +1308,36 @@ bool VGSX::loadWav(uint8_t index, const void* data, size_t size)
             wav += 4;
             size -= 4;
             memcpy(&n, wav, 4);
-            if (n != 16) {
+            if (n < 16 || (int)size - 4 < n) {
                 this->setLastError("Invalid wav format: Unsupported format (%d)", n);
                 return false;
             }
             wav += 4;
             size -= 4;
-
-            memcpy(&s, wav, 2);
-            if (s != 0x0001) {
-                this->setLastError("Invalid wav format: Unsupported compress type (%d)", s);
+            const uint8_t* fmt = wav;
+            memcpy(&format, &fmt[0], 2);
+            memcpy(&ch, &fmt[2], 2);
+            memcpy(&rate, &fmt[4], 4);
+            memcpy(&bps, &fmt[8], 4);
+            memcpy(&bs, &fmt[12], 2);
+            memcpy(&bits, &fmt[14], 2);
+            if (format == 0x0011 && 20 <= n) {
+                memcpy(&samplesPerBlock, &fmt[18], 2);
+            } else if (format != 0x0001) {
+                this->setLastError("Invalid wav format: Unsupported compress type (%d)", format);
                 return false;
             }
-            wav += 2;
-            size -= 2;
-
-            memcpy(&ch, wav, 2);
-            wav += 2;
-            size -= 2;
-
-            memcpy(&rate, wav, 4);
+            wav += n;
+            size -= n;
+        } else if (0 == memcmp(wav, "fact", 4)) {
             wav += 4;
             size -= 4;
-
-            memcpy(&bps, wav, 4);
-            wav += 4;
-            size -= 4;
-
-            memcpy(&bs, wav, 2);
-            wav += 2;
-            size -= 2;
-
-            memcpy(&bits, wav, 2);
-            wav += 2;
-            size -= 2;
+            memcpy(&n, wav, 4);
+            if (4 <= n) {
+                memcpy(&factFrames, wav + 4, 4);
+            }
+            wav += 4 + n;
+            size -= 4 + n;
         } else if (0 == memcmp(wav, "LIST", 4)) {
             wav += 4;
             size -= 4;
@@ -879,12 +1354,12 @@ bool VGSX::loadWav(uint8_t index, const void* data, size_t size)
         }
     }
 
-    putlog(LogLevel::I, "- PCM Format: %dHz %dbits %dch (%d bytes/sec, %d bytes/sample)", rate, bits, ch, bps, bs);
+    putlog(LogLevel::I, "- %s Format: %dHz %dbits %dch (%d bytes/sec, %d bytes/sample)", format == 0x0011 ? "IMA-ADPCM" : "PCM", rate, bits, ch, bps, bs);
     if (0 == rate) {
         this->setLastError("Invalid wav format: fmt chunk not found");
         return false;
-    } else if (rate != 44100 || bits != 16 || ch != 2) {
-        this->setLastError("Invalid wav format: Unsupported sampling format (44100Hz/16bits/2ch only)");
+    } else if (rate < 8000 || 96000 < rate || (ch != 1 && ch != 2) || bits != (format == 0x0011 ? 4 : 16)) {
+        this->setLastError("Invalid wav format: Unsupported sampling format (8000 to 96000Hz, 16bits PCM or 4bits IMA-ADPCM, 1/2ch only)");
         return false;
     }
 
@@ -896,11 +1371,100 @@ bool VGSX::loadWav(uint8_t index, const void* data, size_t size)
     }
     wav += 4;
     size -= 4;
-    this->ctx.sfxData[index].data = (const int16_t*)wav;
-    this->ctx.sfxData[index].count = size / 2;
+
+    SfxData& sfx = this->ctx.sfxData[index];
+    sfx.data = (const int16_t*)wav;
+    sfx.channels = (uint8_t)ch;
+    sfx.rate = (uint32_t)rate;
+    sfx.step = 0 == 44100 % rate ? (uint8_t)(44100 / rate) : 0;
+    if (format == 0x0011) {
+        // each block has a 4 bytes header per channel followed by 4 bytes (8 samples) per channel groups
+        const uint32_t header = 4 * ch;
+        if (bs <= (int)header || samplesPerBlock != ((bs - header) * 8) / header + 1) {
+            this->setLastError("Invalid wav format: invalid IMA-ADPCM block (align=%d, samples=%d)", bs, samplesPerBlock);
+            return false;
+        }
+        sfx.format = SfxFormat::ImaAdpcm;
+        sfx.blockAlign = (uint16_t)bs;
+        sfx.samplesPerBlock = samplesPerBlock;
+        const uint32_t blocks = (uint32_t)(size / bs);
+        const uint32_t rest = (uint32_t)(size % bs);
+        uint32_t frames = blocks * samplesPerBlock;
+        if (header <= rest) {
+            frames += 1 + ((rest - header) / header) * 8;
+        }
+        if (0 <= factFrames && (uint32_t)factFrames < frames) {
+            frames = (uint32_t)factFrames;
+        }
+        sfx.frames = frames;
+    } else {
+        sfx.format = SfxFormat::PCM16;
+        sfx.blockAlign = 0;
+        sfx.samplesPerBlock = 0;
+        sfx.frames = (uint32_t)(size / (2 * ch));
+    }
+    this->prepareSfx(index);
     return true;
 }
 
+// Windowed sinc filter (Blackman window, cutoff at the lower Nyquist frequency) from srcRate to the output sampling rate.
+// The coefficients are computed once per source rate for the phases of the rational ratio (quantized to 512 phases at most).
+const VGSX::SincTable* VGSX::getSincTable(uint32_t srcRate)
+{
+    auto it = this->sincTables.find(srcRate);
+    if (it != this->sincTables.end()) {
+        return &it->second;
+    }
+    constexpr int kZeroCrossings = 16;
+    const uint32_t dstRate = (uint32_t)this->sampleRate;
+    const double cutoff = std::min(1.0, (double)dstRate / srcRate);
+    const double radius = kZeroCrossings / cutoff; // in source frames
+    SincTable& table = this->sincTables[srcRate];
+    table.phases = std::min(dstRate / std::gcd(srcRate, dstRate), 512u);
+    table.taps = 2 * (int)ceil(radius);
+    table.h.resize((size_t)table.phases * table.taps);
+    for (uint32_t p = 0; p < table.phases; p++) {
+        float* h = &table.h[(size_t)p * table.taps];
+        double sum = 0.0;
+        for (int k = 0; k < table.taps; k++) {
+            const double x = (double)p / table.phases + table.taps / 2 - 1 - k; // distance from the output position
+            if (radius <= fabs(x)) {
+                h[k] = 0.0f;
+                continue;
+            }
+            const double t = cutoff * x * M_PI;
+            const double sinc = 0.0 == t ? 1.0 : sin(t) / t;
+            const double w = 0.5 + x / radius * 0.5; // 0 to 1 over the window
+            const double window = 0.42 - 0.5 * cos(2 * M_PI * w) + 0.08 * cos(4 * M_PI * w);
+            h[k] = (float)(sinc * window);
+            sum += h[k];
+        }
+        for (int k = 0; k < table.taps; k++) {
+            h[k] = (float)(h[k] / sum);
+        }
+    }
+    return &table;
+}
+
+// Decide how the SFX is played at the output sampling rate (directly, interpolated to 44100Hz or resampled while mixing)
+void VGSX::prepareSfx(uint8_t index)
+{
+    SfxData& sfx = this->ctx.sfxData[index];
+    SfxStream& stream = this->sfxStreams[index];
+    stream.frames = 0;
+    stream.window.clear();
+    stream.window.shrink_to_fit();
+    if (44100 == this->sampleRate && sfx.step) {
+        sfx.resample = false;
+        stream.table = nullptr;
+        sfx.count = (size_t)sfx.frames * sfx.step * 2;
+        return;
+    }
+    sfx.resample = true;
+    stream.table = this->getSincTable(sfx.rate);
+    sfx.count = (size_t)((uint64_t)sfx.frames * this->sampleRate / sfx.rate) * 2;
+}
+
 void VGSX::reset(void)
 {
     if (this->ignoreReset) {
@@ -921,6 +1485,8 @@ void VGSX::reset(void)
     this->ctx.programSize = 0;
     this->ctx.randomIndex = 0;
     this->ctx.frameClocks = 0;
+    memset(&this->ctx.perf, 0, sizeof(this->ctx.perf));
+    this->renderMicros = 0;
     this->ctx.vgmMasterVolume = VGS_MASTER_VOLUME_MAX - 1;
     this->ctx.sfxMasterVolume = VGS_MASTER_VOLUME_MAX - 1;
     this->vdp.reset();
@@ -928,7 +1494,10 @@ void VGSX::reset(void)
     ((VgmDriver*)this->vgmdrv)->reset();
     for (int i = 0; i < 0x100; i++) {
         this->ctx.sfxData[i].play = false;
+        this->ctx.sfxData[i].volume = VGS_MASTER_VOLUME_MAX - 1;
+        this->ctx.sfxData[i].pan = VGS_SFX_PAN_CENTER;
     }
+    this->ctx.sfxActiveCount = 0;
     if (!this->ctx.elf) {
         return;
     }
@@ -942,6 +1511,7 @@ void VGSX::reset(void)
 
     // Reset RAM
     memset(this->ctx.ram, 0xFF, sizeof(this->ctx.ram));
+    this->ramDirty.markAll();
 
     // Search an Executable Code and initialize RAM segments
     for (uint32_t i = 0, off = eh.e_phoff; i < eh.e_phnum; i++, off += eh.e_phentsize) {
@@ -1004,10 +1574,30 @@ void VGSX::reset(void)
     }
 }
 
-void VGSX::tick(void)
+// skipRender: leave the display as is (the frame is not presented)
+// speculative: the frame will be rolled back (run-ahead), so its host side effects are suppressed:
+//              the sound ports, the console output, the save data files, the user-defined I/O,
+//              the switch from the BIOS to the ROM, the movie and the rewind history
+void VGSX::tick(bool skipRender, bool speculative)
 {
+    uint64_t tickStart = 0;
+    if (this->telemetry.enabled) {
+        if (this->telemetry.isTicked()) {
+            this->flushTelemetry();
+        }
+        this->telemetry.frame.speculative = speculative;
+        tickStart = Telemetry::now();
+    }
     this->detectReferVSync = false;
+    this->speculative = speculative;
+    this->ctx.perf.lastClocks = this->ctx.frameClocks;
+    this->ctx.perf.totalClocks += this->ctx.frameClocks;
     this->ctx.frameClocks = 0;
+    if (MovieMode::None != this->movieMode && !speculative) {
+        this->updateMovie();
+    } else if (!speculative) {
+        this->movieClock = 0;
+    }
 
     if (this->bootBios) {
         this->bootBios = false;
@@ -1022,22 +1612,59 @@ void VGSX::tick(void)
             exit(-1);
         }
     }
-    this->vdp.render();
-    if (this->mouseEnabledFlag && !this->ctx.mouse.hidden) {
-        this->vdp.renderMouse(this->ctx.mouse.ptn, this->ctx.mouse.pal, this->ctx.mouse.cx, this->ctx.mouse.cy);
+    this->speculative = false;
+    if (this->telemetry.enabled) {
+        this->telemetry.frame.cpuClocks = this->ctx.frameClocks;
+        this->telemetry.span(Telemetry::Span::Cpu, tickStart);
+    }
+    if (!skipRender) {
+        this->render();
     }
 
-    if (this->exitFlag && this->pendingRomData.data) {
+    if (this->exitFlag && this->pendingRomData.data && !speculative) {
+        // a speculative frame stays exited until the rollback, and the real frame switches to the ROM
         this->ignoreReset = false;
         this->exitFlag = false;
         this->extractRom(this->pendingRomData.data, this->pendingRomData.size);
         this->pendingRomData.data = nullptr;
         this->pendingRomData.size = 0;
     }
+
+    if (this->rewindLimit && !speculative) {
+        StateArchive archive(this->rewindCore, 0, false);
+        this->saveRestore(archive);
+        this->rewindCore.resize(archive.getOffset());
+        this->rewindBuffer.push(this->rewindCore);
+    }
+    if (this->telemetry.enabled) {
+        this->telemetry.span(Telemetry::Span::Tick, tickStart);
+    }
+}
+
+// Render the display from the current VDP state (done by tick unless skipRender is specified)
+void VGSX::render()
+{
+    const uint64_t start = Telemetry::now();
+    this->vdp.render();
+    if (this->mouseEnabledFlag && !this->ctx.mouse.hidden) {
+        this->vdp.renderMouse(this->ctx.mouse.ptn, this->ctx.mouse.pal, this->ctx.mouse.cx, this->ctx.mouse.cy);
+    }
+    if (this->telemetry.enabled) {
+        this->renderMicros = (uint32_t)((this->telemetry.span(Telemetry::Span::Render, start) - start) / 1000);
+    } else {
+        this->renderMicros = (uint32_t)((Telemetry::now() - start) / 1000);
+    }
+    if (this->frameCallback) {
+        this->frameCallback(this->vdp.ctx.display);
+    }
 }
 
 void VGSX::tickSound(int16_t* buf, int samples)
 {
+    const auto start = std::chrono::steady_clock::now();
+    if (MovieMode::Recording == this->movieMode) {
+        this->movieFrame.samples += (uint32_t)samples;
+    }
     memset(buf, 0, samples * 2);
     auto helper = (VgmDriver*)this->vgmdrv;
     if (!helper->isEnded() && !this->ctx.vgmPause) {
@@ -1063,34 +1690,256 @@ void VGSX::tickSound(int16_t* buf, int samples)
             helper->setEnded();
         }
     }
-    for (int i = 0; i < 0x100; i++) {
-        if (this->ctx.sfxData[i].play) {
-            for (int j = 0; j < samples; j++) {
-                if (this->ctx.sfxData[i].index < this->ctx.sfxData[i].count) {
-                    int w = this->ctx.sfxData[i].data[this->ctx.sfxData[i].index];
-                    if (this->ctx.sfxMasterVolume < VGS_MASTER_VOLUME_MAX - 1) {
-                        w *= this->ctx.sfxMasterVolume;
-                        w /= VGS_MASTER_VOLUME_MAX;
-                    }
-                    w += buf[j];
-                    if (32767 < w) {
-                        w = 32767;
-                    } else if (w < -32768) {
-                        w = -32768;
-                    }
-                    buf[j] = w;
-                    this->ctx.sfxData[i].index++;
-                } else {
-                    this->ctx.sfxData[i].play = false;
-                    break;
-                }
+    this->mixSfx(buf, samples);
+
+    const uint64_t nanos = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    int bin = 0;
+    while (bin < 11 && (32000ull << bin) <= nanos) {
+        bin++;
+    }
+    this->audioStats.calls++;
+    this->audioStats.producedSamples += samples;
+    this->audioStats.totalRenderNanos += nanos;
+    this->audioStats.maxRenderNanos = std::max(this->audioStats.maxRenderNanos, nanos);
+    this->audioStats.renderHistogram[bin]++;
+    if (this->telemetry.enabled) {
+        this->telemetry.span(Telemetry::Span::TickSound, Telemetry::now() - nanos);
+    }
+    if (this->soundCallback) {
+        this->soundCallback(buf, samples);
+    }
+}
+
+void VGSX::sfxPlay(uint8_t n)
+{
+    if (this->ctx.sfxData[n].data) {
+        this->ctx.sfxData[n].index = 0;
+        this->resetSfxDecoder(this->ctx.sfxData[n]);
+        if (!this->ctx.sfxData[n].play) {
+            this->ctx.sfxData[n].play = true;
+            this->ctx.sfxActive[this->ctx.sfxActiveCount++] = n;
+        }
+    }
+}
+
+void VGSX::sfxStop(uint8_t n)
+{
+    if (this->ctx.sfxData[n].play) {
+        this->ctx.sfxData[n].play = false;
+        for (uint32_t i = 0; i < this->ctx.sfxActiveCount; i++) {
+            if (this->ctx.sfxActive[i] == n) {
+                this->ctx.sfxActive[i] = this->ctx.sfxActive[--this->ctx.sfxActiveCount];
+                break;
             }
         }
     }
 }
 
+void VGSX::mixSfx(int16_t* buf, int samples)
+{
+    if (!this->ctx.sfxActiveCount || samples < 1) {
+        return;
+    }
+
+    // Mix the playing voices into a 32-bit accumulator and clamp once at the end
+    this->sfxMix.resize(samples);
+    int32_t* acc = this->sfxMix.data();
+    for (int i = 0; i < samples; i++) {
+        acc[i] = buf[i];
+    }
+    const int32_t master = this->ctx.sfxMasterVolume < VGS_MASTER_VOLUME_MAX - 1 ? (int32_t)this->ctx.sfxMasterVolume : VGS_MASTER_VOLUME_MAX;
+    for (uint32_t i = 0; i < this->ctx.sfxActiveCount;) {
+        SfxData& sfx = this->ctx.sfxData[this->ctx.sfxActive[i]];
+        const size_t remain = sfx.index < sfx.count ? sfx.count - sfx.index : 0;
+        const int n = remain < (size_t)samples ? (int)remain : samples;
+        const int16_t* src;
+        if (sfx.resample) {
+            this->sfxDecode.resize(samples);
+            this->resampleSfx(this->ctx.sfxActive[i], this->sfxDecode.data(), n);
+            src = this->sfxDecode.data();
+        } else if (sfx.format == SfxFormat::PCM16 && sfx.channels == 2 && sfx.step == 1) {
+            src = &sfx.data[sfx.index];
+        } else {
+            // compressed, monaural or low rate: decode this block into the scratch buffer
+            this->sfxDecode.resize(samples);
+            this->decodeSfx(sfx, this->sfxDecode.data(), n);
+            src = this->sfxDecode.data();
+        }
+
+        // gain: volume x master x pan in 1/256 units (256 = 100%)
+        const int32_t volume = (sfx.volume < VGS_MASTER_VOLUME_MAX - 1 ? (int32_t)sfx.volume : VGS_MASTER_VOLUME_MAX) * master;
+        const int32_t pan = (int32_t)sfx.pan;
+        const int32_t left = (volume * (pan <= VGS_SFX_PAN_CENTER ? 256 : (VGS_SFX_PAN_RIGHT - pan) * 2)) >> 16;
+        const int32_t right = (volume * (VGS_SFX_PAN_CENTER <= pan ? 256 : pan * 2)) >> 16;
+        if (left == 256 && right == 256) {
+            for (int j = 0; j < n; j++) {
+                acc[j] += src[j];
+            }
+        } else {
+            const int32_t gain[2] = {left, right};
+            int j = 0;
+            for (; j + 1 < n; j += 2) {
+                acc[j] += (src[j] * gain[0]) >> 8;
+                acc[j + 1] += (src[j + 1] * gain[1]) >> 8;
+            }
+            if (j < n) {
+                acc[j] += (src[j] * gain[0]) >> 8;
+            }
+        }
+        sfx.index += n;
+
+        if (sfx.count <= sfx.index) {
+            // finished: remove from the active list (the last voice takes this place)
+            sfx.play = false;
+            this->ctx.sfxActive[i] = this->ctx.sfxActive[--this->ctx.sfxActiveCount];
+        } else {
+            i++;
+        }
+    }
+    for (int i = 0; i < samples; i++) {
+        buf[i] = (int16_t)std::clamp(acc[i], -32768, 32767);
+    }
+}
+
+static constexpr int16_t kImaStepTable[89] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230, 253, 279, 307,
+    337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
+    2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899,
+    15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767};
+
+static constexpr int8_t kImaIndexTable[16] = {-1, -1, -1, -1, 2, 4, 6, 8, -1, -1, -1, -1, 2, 4, 6, 8};
+
+// Read the source frames in order (IMA-ADPCM keeps the decoder state between the calls)
+void VGSX::readSfxFrame(const SfxData& sfx, SfxDecoder& decoder, uint32_t frame, int16_t* out)
+{
+    const int ch = sfx.channels;
+    if (sfx.format == SfxFormat::PCM16) {
+        out[0] = sfx.data[frame * ch];
+        out[1] = sfx.data[frame * ch + ch - 1];
+        return;
+    }
+    const uint8_t* block = (const uint8_t*)sfx.data + (size_t)(frame / sfx.samplesPerBlock) * sfx.blockAlign;
+    const uint32_t i = frame % sfx.samplesPerBlock;
+    for (int c = 0; c < ch; c++) {
+        if (0 == i) {
+            decoder.predictor[c] = (int16_t)(block[c * 4] | block[c * 4 + 1] << 8);
+            decoder.stepIndex[c] = std::clamp((int)block[c * 4 + 2], 0, 88);
+        } else {
+            const uint32_t m = i - 1;
+            const uint8_t byte = block[4 * ch + (m / 8) * 4 * ch + c * 4 + (m % 8) / 2];
+            const int nibble = (m & 1) ? byte >> 4 : byte & 0x0F;
+            const int step = kImaStepTable[decoder.stepIndex[c]];
+            int diff = step >> 3;
+            if (nibble & 1) diff += step >> 2;
+            if (nibble & 2) diff += step >> 1;
+            if (nibble & 4) diff += step;
+            decoder.predictor[c] = std::clamp(decoder.predictor[c] + ((nibble & 8) ? -diff : diff), -32768, 32767);
+            decoder.stepIndex[c] = std::clamp(decoder.stepIndex[c] + kImaIndexTable[nibble], 0, 88);
+        }
+        out[c] = (int16_t)decoder.predictor[c];
+    }
+    if (ch < 2) {
+        out[1] = out[0];
+    }
+}
+
+void VGSX::resetSfxDecoder(SfxData& sfx)
+{
+    if (sfx.resample || (sfx.format == SfxFormat::PCM16 && sfx.channels == 2 && sfx.step == 1)) {
+        return; // played directly
+    }
+    memset(&sfx.decoder, 0, sizeof(sfx.decoder));
+    if (sfx.frames) {
+        this->readSfxFrame(sfx, sfx.decoder, 0, sfx.decoder.current);
+        if (1 < sfx.frames) {
+            this->readSfxFrame(sfx, sfx.decoder, 1, sfx.decoder.next);
+        } else {
+            memcpy(sfx.decoder.next, sfx.decoder.current, sizeof(sfx.decoder.next));
+        }
+    }
+}
+
+// Convert n samples from sfx.index to 44100Hz/2ch (linear interpolation for the lower sampling rates)
+void VGSX::decodeSfx(SfxData& sfx, int16_t* dst, int n)
+{
+    SfxDecoder& dec = sfx.decoder;
+    for (int j = 0; j < n; j++) {
+        const size_t position = sfx.index + j;
+        const uint32_t output = (uint32_t)(position >> 1);
+        const uint32_t frame = output / sfx.step;
+        while (dec.frame < frame) {
+            memcpy(dec.current, dec.next, sizeof(dec.current));
+            dec.frame++;
+            if (dec.frame + 1 < sfx.frames) {
+                this->readSfxFrame(sfx, dec, dec.frame + 1, dec.next);
+            }
+        }
+        const int c = position & 1;
+        const int32_t phase = (int32_t)(output % sfx.step);
+        dst[j] = (int16_t)(dec.current[c] + (dec.next[c] - dec.current[c]) * phase / sfx.step);
+    }
+}
+
+// Source frames [first, first + frames) of the SFX in 2ch (silent outside the SFX), decoded into the window when they leave it
+const int16_t* VGSX::getSfxWindow(uint8_t index, int64_t first, int frames)
+{
+    const SfxData& sfx = this->ctx.sfxData[index];
+    SfxStream& stream = this->sfxStreams[index];
+    if (stream.base <= first && first + frames <= stream.base + (int64_t)stream.frames) {
+        return &stream.window[(size_t)(first - stream.base) * 2];
+    }
+    constexpr int kAhead = 1024; // frames decoded beyond the request to refill once per kAhead frames
+    stream.base = first;
+    stream.frames = (uint32_t)(frames + kAhead);
+    stream.window.resize((size_t)stream.frames * 2);
+    int16_t* out = stream.window.data();
+    SfxDecoder decoder;
+    memset(&decoder, 0, sizeof(decoder));
+    int64_t frame = std::max((int64_t)0, first);
+    if (sfx.format == SfxFormat::ImaAdpcm) {
+        frame -= frame % sfx.samplesPerBlock; // each block restarts the decoder
+    }
+    for (int64_t i = first; i < first + stream.frames; i++) {
+        int16_t* dst = &out[(size_t)(i - first) * 2];
+        if (i < 0 || (int64_t)sfx.frames <= i) {
+            dst[0] = 0;
+            dst[1] = 0;
+            continue;
+        }
+        for (; frame <= i; frame++) {
+            this->readSfxFrame(sfx, decoder, (uint32_t)frame, dst);
+        }
+    }
+    return out;
+}
+
+// Convert n samples from sfx.index to the output sampling rate/2ch with the windowed sinc filter of the SFX
+void VGSX::resampleSfx(uint8_t index, int16_t* dst, int n)
+{
+    const SfxData& sfx = this->ctx.sfxData[index];
+    const SincTable& table = *this->sfxStreams[index].table;
+    const uint64_t dstRate = (uint64_t)this->sampleRate;
+    for (int j = 0; j < n;) {
+        const size_t position = sfx.index + j;
+        const uint64_t center = (uint64_t)(position >> 1) * sfx.rate; // in source frames x dstRate
+        const int64_t first = (int64_t)(center / dstRate) - table.taps / 2 + 1;
+        const float* h = &table.h[(size_t)(center % dstRate * table.phases / dstRate) * table.taps];
+        const int16_t* src = this->getSfxWindow(index, first, table.taps);
+        float acc[2] = {0.0f, 0.0f};
+        for (int k = 0; k < table.taps; k++) {
+            acc[0] += src[k * 2] * h[k];
+            acc[1] += src[k * 2 + 1] * h[k];
+        }
+        for (int c = position & 1; c < 2 && j < n; c++, j++) {
+            dst[j] = (int16_t)std::clamp((int)lrintf(acc[c]), -32768, 32767);
+        }
+    }
+}
+
 uint32_t VGSX::inPort(uint32_t address)
 {
+    this->telemetry.frame.inPorts++;
     switch (address) {
         case VGS_ADDR_VSYNC: // V-SYNC
             this->detectReferVSync = true;
@@ -1112,8 +1961,12 @@ uint32_t VGSX::inPort(uint32_t address)
         }
         case VGS_ADDR_ANGLE_SIN: return vgsx_sin[this->ctx.angle.degree];
         case VGS_ADDR_ANGLE_COS: return vgsx_cos[this->ctx.angle.degree];
+        case VGS_ADDR_MATH_EXECUTE: return this->ctx.math.result;
 
         case VGS_ADDR_VGM_MASTER: return this->ctx.vgmMasterVolume;
+        case VGS_ADDR_VGM_POSITION: return this->getVgmPosition();
+        case VGS_ADDR_VGM_LENGTH: return this->getVgmLength();
+        case VGS_ADDR_VGM_LOOP_POSITION: return this->getVgmLoopPosition();
         case VGS_ADDR_SFX_MASTER: return this->ctx.sfxMasterVolume;
 
         case VGS_ADDR_KEY_UP: return this->key.up;
@@ -1171,6 +2024,7 @@ uint32_t VGSX::inPort(uint32_t address)
                 fclose(fp);
                 return 0;
             }
+            this->markRamDirty(this->ctx.save.address, size);
             if (size != fread(&this->ctx.ram[this->ctx.save.address & 0xFFFFF], 1, size, fp)) {
                 putlog(LogLevel::E, "failed load request (Read Failed!)");
                 fclose(fp);
@@ -1271,8 +2125,22 @@ uint32_t VGSX::inPort(uint32_t address)
         case VGS_ADDR_YM2612_MUTE3: return ((VgmDriver*)this->vgmdrv)->getMute(ChipType::YM2612, 3) ? 1 : 0;
         case VGS_ADDR_YM2612_MUTE4: return ((VgmDriver*)this->vgmdrv)->getMute(ChipType::YM2612, 4) ? 1 : 0;
         case VGS_ADDR_YM2612_MUTE5: return ((VgmDriver*)this->vgmdrv)->getMute(ChipType::YM2612, 5) ? 1 : 0;
-    }
-    if (VGS_ADDR_USER <= address) {
+        case VGS_ADDR_HIT_A_FIRST: return this->ctx.hit.aFirst;
+        case VGS_ADDR_HIT_A_LAST: return this->ctx.hit.aLast;
+        case VGS_ADDR_HIT_A_MASK: return this->ctx.hit.aMask;
+        case VGS_ADDR_HIT_B_FIRST: return this->ctx.hit.bFirst;
+        case VGS_ADDR_HIT_B_LAST: return this->ctx.hit.bLast;
+        case VGS_ADDR_HIT_B_MASK: return this->ctx.hit.bMask;
+        case VGS_ADDR_HIT_MODE: return this->ctx.hit.mode;
+        case VGS_ADDR_HIT_BUFFER: return this->ctx.hit.buffer;
+        case VGS_ADDR_HIT_LIMIT: return this->ctx.hit.limit;
+        case VGS_ADDR_HIT_EXECUTE: return this->ctx.hit.count;
+        case VGS_ADDR_PERF_CLOCKS: return this->ctx.frameClocks;
+        case VGS_ADDR_PERF_LAST_CLOCKS: return this->ctx.perf.lastClocks;
+        case VGS_ADDR_PERF_TOTAL_CLOCKS: return (uint32_t)(this->ctx.perf.totalClocks + this->ctx.frameClocks);
+        case VGS_ADDR_PERF_RENDER_TIME: return MovieMode::None == this->movieMode ? this->renderMicros : 0; // host dependent (a movie must replay the same)
+    }
+    if (VGS_ADDR_USER <= address && !this->speculative) {
         if (!this->subscribedInput) {
             putlog(LogLevel::W, "Ignored an user-defined I/O (IN:0x%X)", address);
         } else {
@@ -1284,6 +2152,16 @@ uint32_t VGSX::inPort(uint32_t address)
 
 void VGSX::outPort(uint32_t address, uint32_t value)
 {
+    this->telemetry.frame.outPorts++;
+    if (this->speculative) {
+        const uint32_t page = address & 0xFFFF00;
+        if (VGS_ADDR_CONSOLE == address || (VGS_ADDR_VGM_PLAY & 0xFFFF00) == page || (VGS_ADDR_SFX_PLAY & 0xFFFF00) == page || (VGS_ADDR_YM2612_FREQ0 & 0xFFF000) == (address & 0xFFF000)) {
+            return;
+        }
+        if (VGS_ADDR_SAVE_EXECUTE == address || VGS_ADDR_SEQ_COMMIT == address || VGS_ADDR_USER <= address) {
+            return; // the real frame writes the file or calls the host again after the rollback
+        }
+    }
     switch (address) {
         case VGS_ADDR_CONSOLE: // Console Output
             if (this->consoleCallback) {
@@ -1316,6 +2194,7 @@ void VGSX::outPort(uint32_t address, uint32_t value)
                 case 0: this->dmaMemcpy(); break;
                 case 1: this->dmaMemset(); break;
                 case 2: this->dmaU2S(); break;
+                case 3: this->dmaSort(); break;
             }
             return;
 
@@ -1332,11 +2211,18 @@ void VGSX::outPort(uint32_t address, uint32_t value)
             }
             return;
 
+        // Math Array
+        case VGS_ADDR_MATH_SOURCE: this->ctx.math.source = value; return;
+        case VGS_ADDR_MATH_DESTINATION: this->ctx.math.destination = value; return;
+        case VGS_ADDR_MATH_COUNT: this->ctx.math.count = value; return;
+        case VGS_ADDR_MATH_ARGUMENT: this->ctx.math.argument = (int32_t)value; return;
+        case VGS_ADDR_MATH_EXECUTE: this->mathExecute(value); return;
+
         case VGS_ADDR_VGM_PLAY: // Play VGM
             value &= 0xFFFF;
             if (this->ctx.vgmData[value].data) {
                 auto helper = (VgmDriver*)this->vgmdrv;
-                if (!helper->load(this->ctx.vgmData[value].data, this->ctx.vgmData[value].size)) {
+                if (!helper->load(value, this->ctx.vgmData[value].data, this->ctx.vgmData[value].size)) {
                     helper->setEnded();
                 }
                 this->ctx.vgmPause = false;
@@ -1360,20 +2246,30 @@ void VGSX::outPort(uint32_t address, uint32_t value)
             this->ctx.vgmMasterVolume = value < VGS_MASTER_VOLUME_MAX ? value : VGS_MASTER_VOLUME_MAX - 1;
             return;
 
+        case VGS_ADDR_VGM_POSITION:
+            if (!this->seekVgm(value)) {
+                this->putlog(LogLevel::W, "Ignored an invalid VGM seek (no BGM is loaded)");
+            }
+            return;
+
         case VGS_ADDR_SFX_MASTER:
             this->ctx.sfxMasterVolume = value < VGS_MASTER_VOLUME_MAX ? value : VGS_MASTER_VOLUME_MAX - 1;
             return;
 
         case VGS_ADDR_SFX_PLAY: // Play SFX
-            value &= 0xFF;
-            if (this->ctx.sfxData[value].data) {
-                this->ctx.sfxData[value].index = 0;
-                this->ctx.sfxData[value].play = true;
-            }
+            this->sfxPlay(value & 0xFF);
             return;
 
         case VGS_ADDR_SFX_STOP:
-            this->ctx.sfxData[value & 0xFF].play = false;
+            this->sfxStop(value & 0xFF);
+            return;
+
+        case VGS_ADDR_SFX_VOLUME: // (n << 16) | volume
+            this->ctx.sfxData[(value >> 16) & 0xFF].volume = value & 0xFF;
+            return;
+
+        case VGS_ADDR_SFX_PAN: // (n << 16) | pan
+            this->ctx.sfxData[(value >> 16) & 0xFF].pan = value & 0xFF;
             return;
 
         case VGS_ADDR_YM2612_MUTE0: ((VgmDriver*)this->vgmdrv)->setMute(ChipType::YM2612, 0, 0 != value); return;
@@ -1383,6 +2279,18 @@ void VGSX::outPort(uint32_t address, uint32_t value)
         case VGS_ADDR_YM2612_MUTE4: ((VgmDriver*)this->vgmdrv)->setMute(ChipType::YM2612, 4, 0 != value); return;
         case VGS_ADDR_YM2612_MUTE5: ((VgmDriver*)this->vgmdrv)->setMute(ChipType::YM2612, 5, 0 != value); return;
 
+        // Sprite Hit
+        case VGS_ADDR_HIT_A_FIRST: this->ctx.hit.aFirst = value; return;
+        case VGS_ADDR_HIT_A_LAST: this->ctx.hit.aLast = value; return;
+        case VGS_ADDR_HIT_A_MASK: this->ctx.hit.aMask = value; return;
+        case VGS_ADDR_HIT_B_FIRST: this->ctx.hit.bFirst = value; return;
+        case VGS_ADDR_HIT_B_LAST: this->ctx.hit.bLast = value; return;
+        case VGS_ADDR_HIT_B_MASK: this->ctx.hit.bMask = value; return;
+        case VGS_ADDR_HIT_MODE: this->ctx.hit.mode = value; return;
+        case VGS_ADDR_HIT_BUFFER: this->ctx.hit.buffer = value; return;
+        case VGS_ADDR_HIT_LIMIT: this->ctx.hit.limit = value; return;
+        case VGS_ADDR_HIT_EXECUTE: this->detectSpriteHits(); return;
+
         case VGS_ADDR_SAVE_ADDRESS: // Save Data
             this->ctx.save.address = value;
             return;
@@ -1491,6 +2399,7 @@ void VGSX::outPort(uint32_t address, uint32_t value)
                 addr &= 0x0FFFFF;
                 auto str = getButtonIdString(this->ctx.getNameId);
                 memcpy(&this->ctx.ram[addr], str.c_str(), str.length() + 1);
+                this->markRamDirty(addr, str.length() + 1);
             }
             return;
         }
@@ -1553,6 +2462,8 @@ void VGSX::dmaMemcpy()
                     memcpy(&this->ctx.ram[destination & 0x0FFFFF],
                            &this->ctx.program[source],
                            size);
+                    this->markRamDirty(destination, size);
+                    this->telemetry.frame.dmaBytes += size;
                     return;
                 }
             } else if (0xF00000 <= source) {
@@ -1562,6 +2473,8 @@ void VGSX::dmaMemcpy()
                     memmove(&this->ctx.ram[destination & 0x0FFFFF],
                             &this->ctx.ram[source & 0x0FFFFF],
                             size);
+                    this->markRamDirty(destination, size);
+                    this->telemetry.frame.dmaBytes += size;
                     return;
                 }
             }
@@ -1585,6 +2498,8 @@ void VGSX::dmaMemset()
         if (0xF00000 <= destination && destinationEnd <= 0x1000000ULL) {
             // Bulk set to RAM
             memset(&this->ctx.ram[destination & 0x0FFFFF], c, size);
+            this->markRamDirty(destination, size);
+            this->telemetry.frame.dmaBytes += size;
             return;
         }
     }
@@ -1631,23 +2546,126 @@ void VGSX::dmaU2S()
 
     // validate destination
     if (0xF00000 <= destination && destination <= 0xFFFFFF) {
+        const size_t destinationSize = 0x100000 - (destination & 0x0FFFFF);
+        this->markRamDirty(destination, destinationSize);
         // validate source
         if (source < this->ctx.programSize) {
             u2s(&this->ctx.ram[destination & 0x0FFFFF],
-                &this->ctx.program[source]);
+                destinationSize,
+                &this->ctx.program[source],
+                this->ctx.programSize - source);
             return;
         } else if (0xF00000 <= source && source <= 0xFFFFFF) {
             u2s(&this->ctx.ram[destination & 0x0FFFFF],
-                &this->ctx.ram[source & 0x0FFFFF]);
+                destinationSize,
+                &this->ctx.ram[source & 0x0FFFFF],
+                0x100000 - (source & 0x0FFFFF));
             return;
         }
     }
     putlog(LogLevel::W, "Ignored an invalid DMA_u2s(0x%06X, 0x%06X)", destination, source);
 }
 
-void VGSX::u2s(uint8_t* dest, const uint8_t* src)
+void VGSX::dmaSort()
+{
+    uint32_t destination = this->ctx.dma.destination & 0x00FFFFFF;
+    const uint32_t count = this->ctx.dma.source;
+    const uint32_t size = this->ctx.dma.argument & 0xFFFF;
+    const uint32_t offset = (this->ctx.dma.argument >> 16) & 0xFF;
+    const bool key32 = this->ctx.dma.argument & VGS_DMA_SORT_KEY32;
+    const uint32_t keySize = key32 ? 4 : 2;
+
+    // validate layout and range (RAM: 0xF00000..0xFFFFFF, end-exclusive: 0x1000000)
+    const uint64_t destinationEnd = static_cast<uint64_t>(destination) + static_cast<uint64_t>(count) * size;
+    if (count <= 0x100000 && offset + keySize <= size && 0xF00000 <= destination && destinationEnd <= 0x1000000ULL) {
+        if (count < 2) {
+            return;
+        }
+        uint8_t* base = &this->ctx.ram[destination & 0x0FFFFF];
+        this->markRamDirty(destination, (size_t)count * size);
+        this->telemetry.frame.dmaBytes += count * size;
+
+        // Normalize the keys so that an unsigned ascending order gives the requested order
+        uint32_t flip = 0;
+        if (this->ctx.dma.argument & VGS_DMA_SORT_SIGNED) {
+            flip ^= key32 ? 0x80000000 : 0x8000;
+        }
+        if (this->ctx.dma.argument & VGS_DMA_SORT_DESCENDING) {
+            flip ^= key32 ? 0xFFFFFFFF : 0xFFFF;
+        }
+        auto& items = this->sortItems[0];
+        auto& work = this->sortItems[1];
+        items.resize(count);
+        work.resize(count);
+        uint32_t histogram[4][256] = {};
+        const uint8_t* key = base + offset;
+        for (uint32_t i = 0; i < count; i++, key += size) {
+            uint32_t k = key32 ? (uint32_t)key[0] << 24 | (uint32_t)key[1] << 16 | (uint32_t)key[2] << 8 | key[3]
+                               : (uint32_t)key[0] << 8 | key[1];
+            k ^= flip;
+            items[i] = (uint64_t)k << 32 | i;
+            histogram[0][k & 0xFF]++;
+            histogram[1][(k >> 8) & 0xFF]++;
+            histogram[2][(k >> 16) & 0xFF]++;
+            histogram[3][k >> 24]++;
+        }
+
+        // Stable LSD radix sort (skip the digits that every key shares)
+        bool moved = false;
+        for (uint32_t pass = 0; pass < keySize; pass++) {
+            const int shift = 32 + pass * 8;
+            if (histogram[pass][(items[0] >> shift) & 0xFF] == count) {
+                continue;
+            }
+            uint32_t position[256];
+            uint32_t sum = 0;
+            for (int i = 0; i < 256; i++) {
+                position[i] = sum;
+                sum += histogram[pass][i];
+            }
+            for (uint32_t i = 0; i < count; i++) {
+                work[position[(items[i] >> shift) & 0xFF]++] = items[i];
+            }
+            items.swap(work);
+            moved = true;
+        }
+        if (!moved) {
+            return;
+        }
+
+        // Gather the records in sorted order
+        this->sortRecords.resize(static_cast<size_t>(count) * size);
+        uint8_t* ptr = this->sortRecords.data();
+        for (uint32_t i = 0; i < count; i++, ptr += size) {
+            memcpy(ptr, base + (items[i] & 0xFFFFFFFF) * size, size);
+        }
+        memcpy(base, this->sortRecords.data(), this->sortRecords.size());
+        return;
+    }
+    putlog(LogLevel::W, "Ignored an invalid DMA_sort(0x%06X, %u, 0x%08X)", destination, count, this->ctx.dma.argument);
+}
+
+void VGSX::u2s(uint8_t* dest, size_t destSize, const uint8_t* src, size_t srcSize)
 {
-    while (*src) {
+    constexpr uint64_t ONES = 0x0101010101010101ULL;
+    constexpr uint64_t HIGHS = 0x8080808080808080ULL;
+    uint8_t* destLast = dest + destSize - 1; // reserve the terminator
+    const uint8_t* srcEnd = src + srcSize;
+    while (src < srcEnd && *src && dest < destLast) {
+        // ASCII run: copy 8 bytes at once while the block has no zero and no multi byte character
+        while (8 <= srcEnd - src && 8 <= destLast - dest) {
+            uint64_t block;
+            memcpy(&block, src, 8);
+            if ((block | (block - ONES)) & HIGHS) {
+                break;
+            }
+            memcpy(dest, &block, 8);
+            dest += 8;
+            src += 8;
+        }
+        if (srcEnd <= src || 0 == *src || destLast <= dest) {
+            break;
+        }
         if ((0b11000000 & *src) == 0b11000000) {
             // Multi bytes character
             int length;
@@ -1661,20 +2679,23 @@ void VGSX::u2s(uint8_t* dest, const uint8_t* src)
                 length = 1; // do not infinity loop
             }
             uint32_t mbcs = 0;
-            for (int i = 0; i < length; i++) {
+            int i;
+            for (i = 0; i < length && src + i < srcEnd && (0 == i || src[i]); i++) {
                 mbcs <<= 8;
                 mbcs |= src[i];
             }
-            uint32_t sjis = utf8_to_sjis(mbcs);
-            if (sjis) {
+            uint32_t sjis = i == length ? utf8_to_sjis(mbcs) : 0; // truncated sequence is not JIS
+            if (sjis && 2 <= destLast - dest) {
                 dest[0] = (sjis & 0xFF00) >> 8;
                 dest[1] = sjis & 0xFF;
                 dest += 2;
+            } else if (sjis) {
+                break; // no room for the 2 bytes character
             } else {
                 dest[0] = '?'; // not JIS
                 dest++;
             }
-            src += length;
+            src += i;
         } else {
             // Single Byte Character
             *dest = *src;
@@ -1754,9 +2775,23 @@ void VGSX::subscribeOutput(std::function<void(uint32_t port, uint32_t value)> ca
 
 void VGSX::mouseUpdate(int x, int y, bool left, bool right, int scrV, int scrH)
 {
-    if (!this->mouseEnabledFlag) {
-        return;
-    }
+    if (!this->mouseEnabledFlag || MovieMode::Replaying == this->movieMode) {
+        return; // the replay drives the mouse
+    }
+    if (MovieMode::Recording == this->movieMode) {
+        this->movieFrame.mouse = true;
+        this->movieFrame.mouseX = x;
+        this->movieFrame.mouseY = y;
+        this->movieFrame.left = left;
+        this->movieFrame.right = right;
+        this->movieFrame.scrV = scrV;
+        this->movieFrame.scrH = scrH;
+    }
+    this->applyMouse(x, y, left, right, scrV, scrH);
+}
+
+void VGSX::applyMouse(int x, int y, bool left, bool right, int scrV, int scrH)
+{
     this->ctx.mouse.px = this->ctx.mouse.cx;
     this->ctx.mouse.py = this->ctx.mouse.cy;
     this->ctx.mouse.cx = x;
@@ -1796,3 +2831,180 @@ void VGSX::updateMouseButtonStatus(MouseButtonStatus* button, bool pushing, int
         }
     }
 }
+
+void VGSX::detectSpriteHits()
+{
+    VDP::HitQuery query;
+    query.aFirst = (uint16_t)std::min<uint32_t>(this->ctx.hit.aFirst, 1023);
+    query.aLast = (uint16_t)std::min<uint32_t>(this->ctx.hit.aLast, 1023);
+    query.aMask = this->ctx.hit.aMask;
+    query.bFirst = (uint16_t)std::min<uint32_t>(this->ctx.hit.bFirst, 1023);
+    query.bLast = (uint16_t)std::min<uint32_t>(this->ctx.hit.bLast, 1023);
+    query.bMask = this->ctx.hit.bMask;
+    query.pixel = (this->ctx.hit.mode & VGS_HIT_MODE_PIXEL) ? true : false;
+    this->ctx.hit.count = 0;
+
+    const uint32_t buffer = this->ctx.hit.buffer & 0x00FFFFFF;
+    const bool bitmask = (this->ctx.hit.mode & VGS_HIT_MODE_BITMASK) ? true : false;
+    const uint32_t required = bitmask ? 128 : 4;
+    if (buffer < 0xF00000 || 0x1000000 < buffer + required) {
+        putlog(LogLevel::W, "Ignored an invalid sprite hit buffer (0x%06X)", buffer);
+        return;
+    }
+    this->vdp.detectSpriteHits(query, this->hitPairs);
+    this->ctx.hit.count = (uint32_t)this->hitPairs.size();
+
+    uint8_t* out = &this->ctx.ram[buffer & 0x0FFFFF];
+    this->markRamDirty(buffer, bitmask ? 128 : (size_t)std::min<uint32_t>(this->ctx.hit.limit, (0x1000000 - buffer) / 4) * 4);
+    if (bitmask) {
+        // 1024 bits (32 x 32-bit big endian words): bit n of word n/32 is set if OAM[n] hit anything
+        uint32_t bits[32];
+        memset(bits, 0, sizeof(bits));
+        for (const auto& pair : this->hitPairs) {
+            bits[pair.first >> 5] |= 1U << (pair.first & 31);
+            bits[pair.second >> 5] |= 1U << (pair.second & 31);
+        }
+        for (int i = 0; i < 32; i++) {
+            out[i * 4 + 0] = (bits[i] >> 24) & 0xFF;
+            out[i * 4 + 1] = (bits[i] >> 16) & 0xFF;
+            out[i * 4 + 2] = (bits[i] >> 8) & 0xFF;
+            out[i * 4 + 3] = bits[i] & 0xFF;
+        }
+    } else {
+        // pairs of 16-bit big endian OAM indexes (A, B)
+        uint32_t n = std::min<uint32_t>(this->ctx.hit.count, this->ctx.hit.limit);
+        n = std::min<uint32_t>(n, (0x1000000 - buffer) / 4);
+        for (uint32_t i = 0; i < n; i++) {
+            out[i * 4 + 0] = this->hitPairs[i].first >> 8;
+            out[i * 4 + 1] = this->hitPairs[i].first & 0xFF;
+            out[i * 4 + 2] = this->hitPairs[i].second >> 8;
+            out[i * 4 + 3] = this->hitPairs[i].second & 0xFF;
+        }
+    }
+}
+
+static inline int32_t readBE32(const uint8_t* ptr)
+{
+    return (int32_t)(((uint32_t)ptr[0] << 24) | ((uint32_t)ptr[1] << 16) | ((uint32_t)ptr[2] << 8) | ptr[3]);
+}
+
+static inline void writeBE32(uint8_t* ptr, int32_t value)
+{
+    ptr[0] = ((uint32_t)value >> 24) & 0xFF;
+    ptr[1] = ((uint32_t)value >> 16) & 0xFF;
+    ptr[2] = ((uint32_t)value >> 8) & 0xFF;
+    ptr[3] = (uint32_t)value & 0xFF;
+}
+
+static inline int normalizeDegree(int32_t degree)
+{
+    degree %= 360;
+    return degree < 0 ? degree + 360 : degree;
+}
+
+static inline uint32_t isqrt64(uint64_t n)
+{
+    uint64_t r = (uint64_t)sqrt((double)n);
+    while (n < r * r) {
+        r--;
+    }
+    while ((r + 1) * (r + 1) <= n) {
+        r++;
+    }
+    return (uint32_t)r;
+}
+
+void VGSX::mathExecute(uint32_t op)
+{
+    const uint32_t source = this->ctx.math.source & 0x00FFFFFF;
+    const uint32_t destination = this->ctx.math.destination & 0x00FFFFFF;
+    const uint32_t count = this->ctx.math.count;
+    const int32_t arg = this->ctx.math.argument;
+    this->ctx.math.result = 0;
+
+    // element size of the source and the destination (int32_t or int32_t[2])
+    static const uint8_t sourceStride[] = {4, 4, 8, 4, 8, 8, 8, 4};
+    static const uint8_t destinationStride[] = {4, 4, 4, 4, 4, 8, 8, 4};
+    if (sizeof(sourceStride) <= op) {
+        putlog(LogLevel::W, "Ignored an invalid Math operation (%u)", op);
+        return;
+    }
+    const uint64_t sourceSize = (uint64_t)count * sourceStride[op];
+    const uint64_t destinationSize = (uint64_t)count * destinationStride[op];
+
+    // validate destination (RAM only)
+    if (0 == count || destination < 0xF00000 || 0x1000000ULL < destination + destinationSize) {
+        putlog(LogLevel::W, "Ignored an invalid Math(%u, 0x%06X, 0x%06X, %u)", op, destination, source, count);
+        return;
+    }
+    // validate source (program or RAM)
+    const uint8_t* src;
+    if (source < this->ctx.programSize && source + sourceSize <= this->ctx.programSize) {
+        src = &this->ctx.program[source];
+    } else if (0xF00000 <= source && source + sourceSize <= 0x1000000ULL) {
+        src = &this->ctx.ram[source & 0x0FFFFF];
+    } else {
+        putlog(LogLevel::W, "Ignored an invalid Math(%u, 0x%06X, 0x%06X, %u)", op, destination, source, count);
+        return;
+    }
+    uint8_t* dst = &this->ctx.ram[destination & 0x0FFFFF];
+    this->markRamDirty(destination, (size_t)destinationSize);
+
+    switch (op) {
+        case VGS_MATH_SIN:
+            for (uint32_t i = 0; i < count; i++, src += 4, dst += 4) {
+                writeBE32(dst, vgsx_sin[normalizeDegree(readBE32(src))]);
+            }
+            break;
+        case VGS_MATH_COS:
+            for (uint32_t i = 0; i < count; i++, src += 4, dst += 4) {
+                writeBE32(dst, vgsx_cos[normalizeDegree(readBE32(src))]);
+            }
+            break;
+        case VGS_MATH_DEGREE:
+            for (uint32_t i = 0; i < count; i++, src += 8, dst += 4) {
+                auto rad = atan2(readBE32(src + 4), readBE32(src));
+                writeBE32(dst, normalizeDegree((int32_t)(rad * 180 / M_PI)));
+            }
+            break;
+        case VGS_MATH_SQRT:
+            for (uint32_t i = 0; i < count; i++, src += 4, dst += 4) {
+                writeBE32(dst, (int32_t)isqrt64((uint32_t)readBE32(src)));
+            }
+            break;
+        case VGS_MATH_HYPOT:
+            for (uint32_t i = 0; i < count; i++, src += 8, dst += 4) {
+                const int64_t x = readBE32(src);
+                const int64_t y = readBE32(src + 4);
+                writeBE32(dst, (int32_t)std::min<uint32_t>(isqrt64((uint64_t)(x * x) + (uint64_t)(y * y)), 0x7FFFFFFF));
+            }
+            break;
+        case VGS_MATH_NORMALIZE:
+            for (uint32_t i = 0; i < count; i++, src += 8, dst += 8) {
+                const int64_t x = readBE32(src);
+                const int64_t y = readBE32(src + 4);
+                const int64_t length = isqrt64((uint64_t)(x * x) + (uint64_t)(y * y));
+                writeBE32(dst, length ? (int32_t)(x * arg / length) : 0);
+                writeBE32(dst + 4, length ? (int32_t)(y * arg / length) : 0);
+            }
+            break;
+        case VGS_MATH_ROTATE: {
+            const int64_t s = vgsx_sin[normalizeDegree(arg)];
+            const int64_t c = vgsx_cos[normalizeDegree(arg)];
+            for (uint32_t i = 0; i < count; i++, src += 8, dst += 8) {
+                const int64_t x = readBE32(src);
+                const int64_t y = readBE32(src + 4);
+                writeBE32(dst, (int32_t)((x * c - y * s) / 256));
+                writeBE32(dst + 4, (int32_t)((x * s + y * c) / 256));
+            }
+            break;
+        }
+        case VGS_MATH_MAC:
+            for (uint32_t i = 0; i < count; i++, src += 4, dst += 4) {
+                const int64_t product = (int64_t)readBE32(src) * arg;
+                writeBE32(dst, (int32_t)((uint32_t)readBE32(dst) + (uint32_t)(int32_t)(product >> 16)));
+            }
+            break;
+    }
+    this->ctx.math.result = count;
+}
@@ -29,8 +29,13 @@
 #include <math.h>
 #include <time.h>
 #include <functional>
+#include <map>
 #include <utility>
+#include <vector>
 #include "vdp.hpp"
+#include "rewind.hpp"
+#include "movie.hpp"
+#include "telemetry.hpp"
 
 class VGSX
 {
@@ -66,13 +71,50 @@ class VGSX
         size_t size;
     } Binary;
 
+    enum class SfxFormat : uint8_t {
+        PCM16,    // 16-bit linear PCM
+        ImaAdpcm, // IMA-ADPCM (WAVE_FORMAT_IMA_ADPCM)
+    };
+
+    typedef struct {
+        uint32_t frame;       // source frame index of `current`
+        int32_t predictor[2]; // IMA-ADPCM predictor (per channel)
+        int32_t stepIndex[2]; // IMA-ADPCM step index (per channel)
+        int16_t current[2];   // source frame at `frame`
+        int16_t next[2];      // source frame at `frame + 1`
+    } SfxDecoder;
+
     typedef struct {
         const int16_t* data;
-        size_t count;
+        size_t count; // number of samples after conversion to the output sampling rate/2ch
         bool play;
         size_t index;
+        uint32_t volume; // 0 to 255
+        uint32_t pan;    // 0 (left) to 255 (right), 128: center
+        SfxFormat format;
+        uint8_t channels;          // 1 or 2
+        uint8_t step;              // 44100 / sampling rate (0: not a divisor of 44100)
+        uint32_t rate;             // sampling rate
+        uint16_t blockAlign;       // IMA-ADPCM block size in bytes
+        uint32_t samplesPerBlock;  // IMA-ADPCM frames per block
+        uint32_t frames;           // number of source frames
+        SfxDecoder decoder;
+        bool resample;        // resampled with the windowed sinc while mixing (false: played directly or interpolated to 44100Hz)
     } SfxData;
 
+    typedef struct {
+        uint64_t calls;                // VGSX::tickSound calls
+        uint64_t producedSamples;      // samples rendered by VGSX::tickSound
+        uint64_t consumedSamples;      // samples played by the audio device (reported by the host)
+        uint64_t totalRenderNanos;     // total time spent in VGSX::tickSound
+        uint64_t maxRenderNanos;       // worst time spent in a VGSX::tickSound call
+        uint32_t renderHistogram[12];  // VGSX::tickSound time: [0] < 32us, [n] < 32us << n, [11] >= 32ms
+        uint32_t underruns;            // device requests that could not be filled (reported by the host)
+        uint32_t overruns;             // rendered samples that did not fit in the device buffer (reported by the host)
+        uint32_t ym2612QueuePeak;      // maximum depth of the YM2612 write queue
+        uint32_t ym2612QueueOverflows; // writes applied early because the YM2612 write queue was full
+    } AudioStats;
+
     typedef struct {
         uint32_t source;
         uint32_t destination;
@@ -87,11 +129,37 @@ class VGSX
         int32_t degree;
     } Angle;
 
+    typedef struct {
+        uint32_t source;      // Source array (program or RAM)
+        uint32_t destination; // Destination array (RAM)
+        uint32_t count;       // Number of elements
+        int32_t argument;     // Operation argument
+        uint32_t result;      // Number of processed elements
+    } MathArray;
+
     typedef struct {
         uint32_t address;
         uint32_t size;
     } SaveData;
 
+    typedef struct {
+        uint32_t aFirst; // Group A: first OAM index
+        uint32_t aLast;  // Group A: last OAM index
+        uint32_t aMask;  // Group A: collision group mask (0: all)
+        uint32_t bFirst; // Group B: first OAM index
+        uint32_t bLast;  // Group B: last OAM index
+        uint32_t bMask;  // Group B: collision group mask (0: all)
+        uint32_t mode;   // bit0: pixel exact, bit1: bitmask output
+        uint32_t buffer; // Output buffer (RAM address)
+        uint32_t limit;  // Maximum number of pairs to output
+        uint32_t count;  // Number of detected pairs
+    } SpriteHit;
+
+    typedef struct {
+        uint32_t lastClocks;  // clocks of the previous frame
+        uint64_t totalClocks; // clocks of the frames before the current one
+    } PerfClocks;
+
     typedef struct {
         uint8_t buffer[1024 * 1024];
         uint32_t size;
@@ -135,6 +203,7 @@ class VGSX
         uint32_t frameClocks;
         DMA dma;
         Angle angle;
+        MathArray math;
         SaveData save;
         SequencialData sqw;
         SequencialData sqr;
@@ -143,9 +212,13 @@ class VGSX
         uint32_t vgmFadeout;
         uint32_t vgmMasterVolume;
         uint32_t sfxMasterVolume;
+        uint8_t sfxActive[0x100]; // indexes of the playing sfxData
+        uint32_t sfxActiveCount;
         uint32_t fmChip;
         uint32_t fmOffset;
         MouseInfo mouse;
+        SpriteHit hit;
+        PerfClocks perf;
     } ctx;
 
     struct KeyStatus {
@@ -170,6 +243,7 @@ class VGSX
 
     VDP vdp;
     void* vgmdrv;
+    DirtyPages<sizeof(Context::ram)> ramDirty; // WRAM pages written since the last rewind frame
 
     VGSX();
     ~VGSX();
@@ -183,7 +257,8 @@ class VGSX
     bool loadWav(uint8_t index, const void* data, size_t size);
     const char* getLastError() { return this->lastError; }
     void reset();
-    void tick();
+    void tick(bool skipRender = false, bool speculative = false);
+    void render();
     void tickSound(int16_t* buf, int samples);
     inline uint32_t* getDisplay() { return this->vdp.ctx.display; }
     inline int getDisplayWidth() { return VDP_DISPLAY_WIDTH; }
@@ -195,6 +270,8 @@ class VGSX
     void putlog(LogLevel level, const char* format, ...);
     void setLogCallback(std::function<void(LogLevel level, const char* msg)> callback) { this->logCallback = std::move(callback); }
     void setConsoleCallback(std::function<void(const char* msg)> callback) { this->consoleCallback = std::move(callback); }
+    void setFrameCallback(std::function<void(const uint32_t* display)> callback) { this->frameCallback = std::move(callback); }
+    void setSoundCallback(std::function<void(const int16_t* buf, int samples)> callback) { this->soundCallback = std::move(callback); }
     inline void setGamepadType(GamepadType type) { this->gamepadType = type; }
     ButtonId getButtonIdA();
     ButtonId getButtonIdB();
@@ -209,6 +286,36 @@ class VGSX
     void useYm2612AnalogRealPreset();
     void useYm2612AnalogRe1ePreset();
     void useYm2612AnalogWarmPreset();
+    void setSampleRate(int rate);
+    inline int getSampleRate() { return this->sampleRate; }
+    bool seekVgm(uint32_t position);
+    AudioStats getAudioStats();
+    void resetAudioStats();
+    void reportAudioDevice(uint32_t consumedSamples, uint32_t underruns, uint32_t overruns);
+    void setTelemetryCallback(std::function<void(const Telemetry::Frame& frame)> callback);
+    void flushTelemetry();
+    void reportPresent(uint64_t startNanos);
+    uint32_t getVgmPosition();
+    uint32_t getVgmLength();
+    uint32_t getVgmLoopPosition();
+    void saveState(std::vector<uint8_t>& state);
+    bool loadState(const void* data, size_t size);
+    void setRewindLimit(size_t bytes);
+    bool rewind();
+    inline int getRewindFrames() { return (int)this->rewindBuffer.getFrames(); }
+    inline size_t getRewindMemory() { return this->rewindBuffer.getMemory(); }
+    inline void markRamDirty(uint32_t offset, size_t size) { this->ramDirty.mark(offset & 0xFFFFF, size); }
+    bool startRecording();
+    bool stopRecording(std::vector<uint8_t>& movie);
+    bool startReplay(const void* data, size_t size);
+    inline void stopReplay() { this->movieMode = MovieMode::None; }
+    inline bool isRecording() { return MovieMode::Recording == this->movieMode; }
+    inline bool isReplaying() { return MovieMode::Replaying == this->movieMode; }
+    inline int getMovieFrame() { return (int)(this->isRecording() ? this->movie.getFrames() : this->movie.getPosition()); }
+    inline int getMovieFrames() { return (int)this->movie.getFrames(); }
+    inline int getMovieSamples() { return this->isReplaying() && this->movie.peek() ? (int)this->movie.peek()->samples : 0; }
+    inline uint64_t getRamHash() { return hashMemory(this->ctx.ram, sizeof(this->ctx.ram)); }
+    inline uint64_t getDisplayHash() { return hashMemory(this->vdp.ctx.display, sizeof(this->vdp.ctx.display)); }
 
     void setSaveDataDirectory(const char* dir)
     {
@@ -235,18 +342,31 @@ class VGSX
     void mouseUpdate(int x, int y, bool left, bool right, int scrV, int scrH);
 
   private:
+    class StateArchive;
+    void saveRestore(StateArchive& state);
     void updateMouseButtonStatus(MouseButtonStatus* button, bool pushing, int x, int y);
 
-    static struct tm* now()
+    enum class MovieMode {
+        None,
+        Recording,
+        Replaying,
+    };
+
+    struct tm* now()
     {
-        time_t now = time(nullptr);
+        time_t now = this->movieClock ? (time_t)this->movieClock : time(nullptr);
         return gmtime(&now);
     }
 
-    static struct tm* now2()
+    struct tm* now2()
     {
-        time_t now = time(nullptr);
-        return localtime(&now);
+        if (!this->movieClock) {
+            time_t now = time(nullptr);
+            return localtime(&now);
+        }
+        // the local time of the recording host (not of the replaying host)
+        time_t now = (time_t)(this->movieClock + this->movieUtcOffset);
+        return gmtime(&now);
     }
 
     char saveDataDir[1024];
@@ -266,6 +386,10 @@ class VGSX
     bool extractRom(const uint8_t* program, int programSize);
     std::function<void(LogLevel level, const char* msg)> logCallback;
     std::function<void(const char* msg)> consoleCallback;
+    std::function<void(const uint32_t* display)> frameCallback;       // called with every rendered display
+    std::function<void(const int16_t* buf, int samples)> soundCallback; // called with every buffer rendered by tickSound
+    std::function<void(const Telemetry::Frame& frame)> telemetryCallback; // called with the record of every tick
+    Telemetry telemetry;
     char consoleBuffer[1024];
     uint16_t consoleBufferLength;
     GamepadType gamepadType;
@@ -274,11 +398,57 @@ class VGSX
     char lastError[256];
     void setLastError(const char* format, ...);
     volatile bool detectReferVSync;
+    bool speculative; // ticking a frame that will be rolled back (run-ahead)
     void dmaMemcpy();
     void dmaMemset();
     uint32_t dmaSearch();
     void dmaU2S();
-    void u2s(uint8_t* dest, const uint8_t* src);
+    void dmaSort();
+    void mathExecute(uint32_t op);
+    void u2s(uint8_t* dest, size_t destSize, const uint8_t* src, size_t srcSize);
+    std::vector<uint64_t> sortItems[2];
+    std::vector<uint8_t> sortRecords;
+    std::vector<int32_t> sfxMix;
+    void sfxPlay(uint8_t n);
+    void sfxStop(uint8_t n);
+    void mixSfx(int16_t* buf, int samples);
+    std::vector<int16_t> sfxDecode;
+    void readSfxFrame(const SfxData& sfx, SfxDecoder& decoder, uint32_t frame, int16_t* out);
+    void resetSfxDecoder(SfxData& sfx);
+    void decodeSfx(SfxData& sfx, int16_t* dst, int n);
+    int sampleRate;
+    AudioStats audioStats;
+    uint32_t renderMicros; // host time of the last VGSX::render (read by the program, not saved)
+    struct SincTable {
+        uint32_t phases;       // fractional positions between two source frames
+        int taps;              // source frames per output frame
+        std::vector<float> h;  // phases x taps coefficients (unity gain per phase)
+    };
+    struct SfxStream {
+        const SincTable* table;      // filter of the SFX (nullptr: not resampled)
+        int64_t base;                // source frame of the first frame in the window
+        uint32_t frames;             // source frames in the window
+        std::vector<int16_t> window; // 2ch source frames decoded around the playing position
+    };
+    std::map<uint32_t, SincTable> sincTables; // by the source sampling rate (built once for the output sampling rate)
+    SfxStream sfxStreams[0x100];
+    const SincTable* getSincTable(uint32_t srcRate);
+    const int16_t* getSfxWindow(uint8_t index, int64_t first, int frames);
+    void resampleSfx(uint8_t index, int16_t* dst, int n);
+    void prepareSfx(uint8_t index);
+    std::vector<VDP::HitPair> hitPairs;
+    void detectSpriteHits();
+    uint64_t programHash; // hash of the loaded program (identifies the program of the states and the movies)
+    size_t rewindLimit;
+    RewindBuffer rewindBuffer;
+    std::vector<uint8_t> rewindCore;
+    MovieMode movieMode;
+    InputMovie movie;
+    InputMovie::Frame movieFrame; // inputs of the frame being recorded
+    int64_t movieClock; // clock of the recorded/replayed frame (0: wall clock)
+    int32_t movieUtcOffset; // UTC offset of the recording host at movieClock (seconds)
+    void updateMovie();
+    void applyMouse(int x, int y, bool left, bool right, int scrV, int scrH);
 };
 
 extern VGSX vgsx;
@@ -2323,6 +2323,14 @@ void fm_engine_base<RegisterType>::reset()
     // reset all status bits
     set_reset_status(0, 0xff);
 
+    // reset the free running counters so that a reset chip behaves like a new one
+    m_env_counter = 0;
+    m_timer_running[0] = m_timer_running[1] = 0;
+    m_total_clocks = 0;
+    m_active_channels = ALL_CHANNELS;
+    m_modified_channels = ALL_CHANNELS;
+    m_prepare_count = 0;
+
     // register type-specific initialization
     m_regs.reset();
 
@@ -3181,6 +3189,8 @@ template <bool IsOpnA>
 void opn_registers_base<IsOpnA>::reset()
 {
     std::fill_n(&m_regdata[0], REGISTERS, 0);
+    m_lfo_counter = 0;
+    m_lfo_am = 0;
     if (IsOpnA) {
         // enable output on both channels by default
         m_regdata[0xb4] = m_regdata[0xb5] = m_regdata[0xb6] = 0xc0;
@@ -3606,6 +3616,9 @@ void ym2612::reset()
 {
     // reset the engines
     m_fm.reset();
+    m_address = 0;
+    m_dac_data = 0;
+    m_dac_enable = 0;
     m_pin_ch_out_valid = 0;
     m_pin_output_valid = 0;
     m_pin_ch_out_value.fill(0);
@@ -0,0 +1,34 @@
+// Print the audio timing statistics of VGSX (shared by the frontends)
+#pragma once
+#include <stdio.h>
+#include "vgsx.h"
+
+static void printAudioStats(const VGSX::AudioStats& stats, int sampleRate)
+{
+    printf("\n[AUDIO]\n");
+    if (0 == stats.calls) {
+        printf("No audio was rendered.\n");
+        return;
+    }
+    const double average = (double)stats.totalRenderNanos / stats.calls / 1000.0;
+    const double budget = (double)stats.producedSamples / stats.calls / 2 * 1000000.0 / sampleRate;
+    printf("Render: %llu calls, average %.1fus, maximum %.1fus (%.1fus of audio per call)\n",
+           (unsigned long long)stats.calls,
+           average,
+           (double)stats.maxRenderNanos / 1000.0,
+           budget);
+    printf("Render time histogram:");
+    for (int i = 0; i < 12; i++) {
+        if (stats.renderHistogram[i]) {
+            if (i < 11) {
+                printf(" <%dus:%u", 32 << i, stats.renderHistogram[i]);
+            } else {
+                printf(" >=%dus:%u", 32 << 10, stats.renderHistogram[i]);
+            }
+        }
+    }
+    printf("\n");
+    printf("Samples: %llu produced, %llu consumed\n", (unsigned long long)stats.producedSamples, (unsigned long long)stats.consumedSamples);
+    printf("Underruns: %u, Overruns: %u\n", stats.underruns, stats.overruns);
+    printf("YM2612 write queue: peak %u, overflows %u\n", stats.ym2612QueuePeak, stats.ym2612QueueOverflows);
+}
@@ -0,0 +1,231 @@
+// Capture the frames and the sound of VGSX on a background thread (shared by the frontends)
+#pragma once
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "vgsx.h"
+#include "wav_writer.h"
+
+// Include stb_image_write.h (with its implementation in one translation unit) before this header.
+//
+// The emulation thread copies each rendered frame into a bounded queue. When the queue is full, a real-time
+// frontend drops the frame and counts it, and an offline runner (wait) waits for the encoder to free a slot.
+//
+// Png: <path>/frame_NNNNNN.png (NNNNNN: frame number, so the dropped frames are visible as gaps)
+// Raw: <path> holds the RGB24 frames back to back (dropped frames are filled with the previous frame)
+//      e.g. ffmpeg -f rawvideo -pix_fmt rgb24 -s 640x400 -r <getFrameRate()> -i <path> -i <path>.wav out.mp4
+// The sound is written to <path>/sound.wav (Png) or <path>.wav (Raw) without drops.
+class FrameCapture
+{
+  public:
+    enum class Format {
+        Png,
+        Raw,
+    };
+
+    ~FrameCapture() { this->stop(); }
+
+    // interval: capture every N-th frame, queueFrames: frames buffered for the encoder
+    // wait: wait for a free slot instead of dropping the frame when the queue is full
+    bool start(VGSX& vgsx, const char* path, Format format, int interval = 1, int queueFrames = 16, bool wait = false)
+    {
+        this->stop();
+        this->vgsx = &vgsx;
+        this->wait = wait;
+        this->format = format;
+        this->width = vgsx.getDisplayWidth();
+        this->height = vgsx.getDisplayHeight();
+        this->interval = 0 < interval ? interval : 1;
+        this->path = path;
+        if (Format::Raw == format) {
+            this->raw = fopen(path, "wb");
+            if (!this->raw) {
+                return false;
+            }
+        }
+        if (!this->wav.open((this->path + (Format::Png == format ? "/sound.wav" : ".wav")).c_str(), vgsx.getSampleRate())) {
+            this->closeFiles();
+            return false;
+        }
+        this->slots.assign((size_t)(0 < queueFrames ? queueFrames : 1), Slot());
+        for (auto& slot : this->slots) {
+            slot.pixels.resize((size_t)this->width * this->height);
+        }
+        this->head = 0;
+        this->tail = 0;
+        this->frame = 0;
+        this->captured = 0;
+        this->dropped = 0;
+        this->lastWritten = -1;
+        this->failed = false;
+        this->quit = false;
+        this->pcm.clear();
+        this->thread = std::thread([this]() { this->encoder(); });
+        vgsx.setFrameCallback([this](const uint32_t* display) { this->pushFrame(display); });
+        vgsx.setSoundCallback([this](const int16_t* buf, int samples) { this->pushSound(buf, samples); });
+        return true;
+    }
+
+    // wait for the encoder to write the queued frames and close the files
+    void stop()
+    {
+        if (!this->thread.joinable()) {
+            return;
+        }
+        this->vgsx->setFrameCallback({});
+        this->vgsx->setSoundCallback({});
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->quit = true;
+        }
+        this->ready.notify_one();
+        this->thread.join();
+        this->closeFiles();
+    }
+
+    inline bool isCapturing() const { return this->thread.joinable(); }
+    inline int getCapturedFrames() const { return this->captured.load(); }
+    inline int getDroppedFrames() const { return this->dropped.load(); }
+    inline bool isFailed() const { return this->failed.load(); }
+    inline double getFrameRate() const { return 60.0 / this->interval; } // frames per second of the capture
+
+    // print the command line that converts the raw capture to a video
+    void printRawHint() const
+    {
+        if (Format::Raw == this->format) {
+            printf("To make a video: ffmpeg -f rawvideo -pix_fmt rgb24 -s %dx%d -r %g -i %s -i %s.wav out.mp4\n", this->width, this->height, this->getFrameRate(), this->path.c_str(), this->path.c_str());
+        }
+    }
+
+  private:
+    struct Slot {
+        int frame;
+        std::vector<uint32_t> pixels;
+    };
+
+    VGSX* vgsx = nullptr;
+    Format format = Format::Png;
+    int width = 0;
+    int height = 0;
+    int interval = 1;
+    bool wait = false;
+    std::string path;
+    FILE* raw = nullptr;
+    WavWriter wav;
+    std::vector<Slot> slots;
+    std::atomic<size_t> head{0}; // read position (updated by the encoder)
+    std::atomic<size_t> tail{0}; // write position (updated by the emulation thread)
+    int frame = 0;
+    std::atomic<int> captured{0};
+    std::atomic<int> dropped{0};
+    std::atomic<bool> failed{false};
+    int lastWritten = -1;
+    std::vector<uint8_t> last; // RGB24 of the last written frame (Raw)
+    bool quit = false;
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::condition_variable freed; // notified by the encoder when it frees a slot (wait)
+    std::vector<int16_t> pcm; // sound not written yet (guarded by mutex)
+    std::thread thread;
+
+    void pushFrame(const uint32_t* display)
+    {
+        const int number = this->frame++;
+        if (0 != number % this->interval) {
+            return;
+        }
+        const size_t tail = this->tail.load(std::memory_order_relaxed);
+        auto full = [this, tail]() { return this->slots.size() <= tail - this->head.load(std::memory_order_acquire); };
+        if (full()) {
+            if (!this->wait) {
+                this->dropped++;
+                return;
+            }
+            std::unique_lock<std::mutex> lock(this->mutex);
+            while (full()) {
+                this->ready.notify_one();
+                this->freed.wait_for(lock, std::chrono::milliseconds(10));
+            }
+        }
+        Slot& slot = this->slots[tail % this->slots.size()];
+        slot.frame = number / this->interval;
+        memcpy(slot.pixels.data(), display, slot.pixels.size() * sizeof(uint32_t));
+        this->tail.store(tail + 1, std::memory_order_release);
+        this->captured++;
+        this->ready.notify_one();
+    }
+
+    void pushSound(const int16_t* buf, int samples)
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->pcm.insert(this->pcm.end(), buf, buf + samples);
+    }
+
+    void encoder()
+    {
+        std::vector<int16_t> sound;
+        std::vector<uint8_t> rgb((size_t)this->width * this->height * 3);
+        this->last.resize(rgb.size());
+        while (true) {
+            bool quit;
+            {
+                std::unique_lock<std::mutex> lock(this->mutex);
+                this->ready.wait_for(lock, std::chrono::milliseconds(10), [this]() { return this->quit || this->head.load() != this->tail.load(); });
+                quit = this->quit;
+                sound.swap(this->pcm);
+            }
+            this->wav.write(sound.data(), (int)sound.size());
+            sound.clear();
+            for (size_t head = this->head.load(); head != this->tail.load(std::memory_order_acquire); head++) {
+                this->write(this->slots[head % this->slots.size()], rgb);
+                this->head.store(head + 1, std::memory_order_release);
+                this->freed.notify_one();
+            }
+            if (quit) {
+                return;
+            }
+        }
+    }
+
+    void write(const Slot& slot, std::vector<uint8_t>& rgb)
+    {
+        const uint32_t* src = slot.pixels.data();
+        for (size_t i = 0, count = slot.pixels.size(); i < count; i++) {
+            rgb[i * 3] = (src[i] >> 16) & 0xFF;
+            rgb[i * 3 + 1] = (src[i] >> 8) & 0xFF;
+            rgb[i * 3 + 2] = src[i] & 0xFF;
+        }
+        bool result;
+        if (Format::Png == this->format) {
+            char name[32];
+            snprintf(name, sizeof(name), "/frame_%06d.png", slot.frame);
+            result = 0 != stbi_write_png((this->path + name).c_str(), this->width, this->height, 3, rgb.data(), this->width * 3);
+        } else {
+            // keep the timing of the video by repeating the last frame for the dropped ones
+            result = true;
+            for (int i = this->lastWritten + 1; result && i <= slot.frame; i++) {
+                result = 1 == fwrite(i == slot.frame || this->lastWritten < 0 ? rgb.data() : this->last.data(), rgb.size(), 1, this->raw);
+            }
+            this->last.swap(rgb);
+        }
+        this->lastWritten = slot.frame;
+        if (!result) {
+            this->failed = true;
+        }
+    }
+
+    void closeFiles()
+    {
+        if (this->raw) {
+            fclose(this->raw);
+            this->raw = nullptr;
+        }
+        this->wav.close();
+    }
+};
@@ -0,0 +1,22 @@
+// Read a whole file into memory, or exit when the file is not found (shared by the frontends and the host tools)
+#pragma once
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <fstream>
+#include <vector>
+
+static std::vector<uint8_t> loadBinary(const char* path)
+{
+    std::vector<uint8_t> data;
+    std::ifstream ifs(path, std::ios::binary);
+    if (!ifs) {
+        printf("File not found: %s\n", path);
+        exit(255);
+    }
+    ifs.seekg(0, std::ios::end);
+    data.resize((size_t)ifs.tellg());
+    ifs.seekg(0);
+    ifs.read((char*)data.data(), (std::streamsize)data.size());
+    return data;
+}
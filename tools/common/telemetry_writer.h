@@ -0,0 +1,135 @@
+// Write the per-frame telemetry of VGSX as JSON lines or Chrome trace events (shared by the frontends)
+#pragma once
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "vgsx.h"
+
+// Lines: one JSON object per tick (counters, host time per part and the spans)
+//        e.g. {"frame":0,"speculative":false,"cycles":1234,"cpu_us":0.512,...,"spans":[{"name":"tick","ts":0.000,"dur":1.234},...]}
+// Trace: Chrome trace events (JSON array format) to open with about:tracing or https://ui.perfetto.dev
+//        The spans are complete events ("ph":"X") and the counters are counter events ("ph":"C").
+// The times are in microseconds from the first recorded span. The file is written through a large stdio
+// buffer on the emulation thread, so the disk is not touched every frame.
+class TelemetryWriter
+{
+  public:
+    enum class Format {
+        Lines,
+        Trace,
+    };
+
+    ~TelemetryWriter() { this->stop(); }
+
+    bool start(VGSX& vgsx, const char* path, Format format)
+    {
+        this->stop();
+        this->fp = fopen(path, "w");
+        if (!this->fp) {
+            return false;
+        }
+        setvbuf(this->fp, nullptr, _IOFBF, 1024 * 1024);
+        this->vgsx = &vgsx;
+        this->format = format;
+        this->base = 0;
+        this->frames = 0;
+        if (Format::Trace == format) {
+            fputs("[\n", this->fp);
+            fputs("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"emulation\"}}", this->fp);
+        }
+        vgsx.setTelemetryCallback([this](const Telemetry::Frame& frame) { this->write(frame); });
+        return true;
+    }
+
+    void stop()
+    {
+        if (!this->fp) {
+            return;
+        }
+        this->vgsx->flushTelemetry();
+        this->vgsx->setTelemetryCallback({});
+        if (Format::Trace == this->format) {
+            fputs("\n]\n", this->fp);
+        }
+        fclose(this->fp);
+        this->fp = nullptr;
+    }
+
+    inline bool isRecording() const { return this->fp != nullptr; }
+    inline int getFrames() const { return this->frames; }
+
+  private:
+    VGSX* vgsx = nullptr;
+    FILE* fp = nullptr;
+    Format format = Format::Lines;
+    uint64_t base = 0;
+    int frames = 0;
+
+    inline double us(uint64_t nanos) const { return (double)(int64_t)(nanos - this->base) / 1000.0; }
+
+    static uint64_t beginOf(const Telemetry::Frame& frame)
+    {
+        uint64_t begin = frame.spans[0].begin;
+        for (int i = 1; i < frame.spanCount; i++) {
+            begin = frame.spans[i].begin < begin ? frame.spans[i].begin : begin;
+        }
+        return begin;
+    }
+
+    static void spanName(const Telemetry::SpanRecord& span, char* name, size_t size)
+    {
+        if (Telemetry::Span::RenderBG == span.span) {
+            snprintf(name, size, "renderBG(%d)", span.arg);
+        } else {
+            snprintf(name, size, "%s", Telemetry::name(span.span));
+        }
+    }
+
+    void write(const Telemetry::Frame& frame)
+    {
+        if (0 == this->frames) {
+            this->base = beginOf(frame);
+        }
+        this->frames++;
+        if (Format::Lines == this->format) {
+            this->writeLine(frame);
+        } else {
+            this->writeTrace(frame);
+        }
+    }
+
+    void writeLine(const Telemetry::Frame& frame)
+    {
+        fprintf(this->fp, "{\"frame\":%u,\"speculative\":%s,\"cycles\":%u,", frame.frame, frame.speculative ? "true" : "false", frame.cpuClocks);
+        fprintf(this->fp, "\"cpu_us\":%.3f,\"render_us\":%.3f,\"sound_us\":%.3f,\"present_us\":%.3f,", frame.cpuNanos / 1000.0, frame.renderNanos / 1000.0, frame.soundNanos / 1000.0, frame.presentNanos / 1000.0);
+        fprintf(this->fp, "\"in_ports\":%u,\"out_ports\":%u,\"dma_bytes\":%u,\"sprites\":%u,\"spans\":[", frame.inPorts, frame.outPorts, frame.dmaBytes, frame.sprites);
+        for (int i = 0; i < frame.spanCount; i++) {
+            const auto& span = frame.spans[i];
+            char name[32];
+            spanName(span, name, sizeof(name));
+            fprintf(this->fp, "%s{\"name\":\"%s\",\"ts\":%.3f,\"dur\":%.3f}", i ? "," : "", name, this->us(span.begin), (span.end - span.begin) / 1000.0);
+        }
+        fputs("]}\n", this->fp);
+    }
+
+    void writeTrace(const Telemetry::Frame& frame)
+    {
+        for (int i = 0; i < frame.spanCount; i++) {
+            const auto& span = frame.spans[i];
+            char name[32];
+            spanName(span, name, sizeof(name));
+            fprintf(this->fp, ",\n{\"name\":\"%s\",\"cat\":\"vgsx\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f", name, this->us(span.begin), (span.end - span.begin) / 1000.0);
+            if (Telemetry::Span::Tick == span.span) {
+                fprintf(this->fp, ",\"args\":{\"frame\":%u,\"speculative\":%s,\"cycles\":%u,\"in_ports\":%u,\"out_ports\":%u,\"dma_bytes\":%u,\"sprites\":%u}", frame.frame, frame.speculative ? "true" : "false", frame.cpuClocks, frame.inPorts, frame.outPorts, frame.dmaBytes, frame.sprites);
+            }
+            fputs("}", this->fp);
+        }
+        if (frame.spanCount) {
+            const double ts = this->us(beginOf(frame));
+            fprintf(this->fp, ",\n{\"name\":\"cycles\",\"ph\":\"C\",\"pid\":1,\"ts\":%.3f,\"args\":{\"cycles\":%u}}", ts, frame.cpuClocks);
+            fprintf(this->fp, ",\n{\"name\":\"ports\",\"ph\":\"C\",\"pid\":1,\"ts\":%.3f,\"args\":{\"in\":%u,\"out\":%u}}", ts, frame.inPorts, frame.outPorts);
+            fprintf(this->fp, ",\n{\"name\":\"dma_bytes\",\"ph\":\"C\",\"pid\":1,\"ts\":%.3f,\"args\":{\"bytes\":%u}}", ts, frame.dmaBytes);
+            fprintf(this->fp, ",\n{\"name\":\"sprites\",\"ph\":\"C\",\"pid\":1,\"ts\":%.3f,\"args\":{\"sprites\":%u}}", ts, frame.sprites);
+        }
+    }
+};
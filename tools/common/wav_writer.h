@@ -0,0 +1,59 @@
+// WAV file writer (shared by the frontends)
+#pragma once
+#include <stdint.h>
+#include <stdio.h>
+
+// 16-bit stereo WAV written while running (the sizes are filled in by close)
+class WavWriter
+{
+  public:
+    bool open(const char* path, int sampleRate)
+    {
+        this->fp = fopen(path, "wb");
+        if (!this->fp) {
+            return false;
+        }
+        const uint8_t header[44] = {'R', 'I', 'F', 'F', 0, 0, 0, 0, 'W', 'A', 'V', 'E', 'f', 'm', 't', ' ', 16, 0, 0, 0, 1, 0, 2, 0};
+        fwrite(header, 1, sizeof(header), this->fp);
+        this->bytes = 0;
+        this->sampleRate = sampleRate;
+        return true;
+    }
+
+    void write(const int16_t* samples, int count)
+    {
+        if (this->fp) {
+            fwrite(samples, 2, count, this->fp);
+            this->bytes += (uint32_t)count * 2;
+        }
+    }
+
+    void close()
+    {
+        if (!this->fp) {
+            return;
+        }
+        fseek(this->fp, 4, SEEK_SET);
+        putLe32(36 + this->bytes);
+        fseek(this->fp, 24, SEEK_SET);
+        putLe32(this->sampleRate);
+        putLe32(this->sampleRate * 4);
+        const uint8_t format[4] = {4, 0, 16, 0}; // block align, bits per sample
+        fwrite(format, 1, sizeof(format), this->fp);
+        fwrite("data", 1, 4, this->fp);
+        putLe32(this->bytes);
+        fclose(this->fp);
+        this->fp = nullptr;
+    }
+
+  private:
+    FILE* fp = nullptr;
+    uint32_t bytes = 0;
+    uint32_t sampleRate = 0;
+
+    void putLe32(uint32_t value)
+    {
+        const uint8_t bytes[4] = {(uint8_t)value, (uint8_t)(value >> 8), (uint8_t)(value >> 16), (uint8_t)(value >> 24)};
+        fwrite(bytes, 1, sizeof(bytes), this->fp);
+    }
+};
@@ -0,0 +1,290 @@
+// VGS-X headless runner: runs a program without SDL at unlimited speed (benchmarks, replays and regression tests)
+#include <ctype.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "vgsx.h"
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "../common/stb_image_write.h"
+#include "../common/audio_stats.h"
+#include "../common/frame_capture.h"
+#include "../common/load_binary.h"
+#include "../common/telemetry_writer.h"
+#include "../common/wav_writer.h"
+
+// total and worst time of a part of the frame
+struct PerfCounter {
+    uint64_t totalNanos = 0;
+    uint64_t maxNanos = 0;
+
+    void add(std::chrono::steady_clock::time_point start)
+    {
+        const uint64_t nanos = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        this->totalNanos += nanos;
+        this->maxNanos = this->maxNanos < nanos ? nanos : this->maxNanos;
+    }
+
+    void print(const char* name, int frames) const
+    {
+        printf("%-7s average %.3fms, maximum %.3fms per frame\n", name, frames ? this->totalNanos / 1000000.0 / frames : 0.0, this->maxNanos / 1000000.0);
+    }
+
+    void json(FILE* fp, const char* name, int frames) const
+    {
+        fprintf(fp, "  \"%s\": {\"average_ms\": %.4f, \"max_ms\": %.4f},\n", name, frames ? this->totalNanos / 1000000.0 / frames : 0.0, this->maxNanos / 1000000.0);
+    }
+};
+
+// write a JSON string literal (the paths may contain quotes, backslashes or control characters)
+static void putJsonString(FILE* fp, const char* str)
+{
+    fputc('"', fp);
+    for (; *str; str++) {
+        const unsigned char c = (unsigned char)*str;
+        if ('"' == c || '\\' == c) {
+            fprintf(fp, "\\%c", c);
+        } else if (c < 0x20) {
+            fprintf(fp, "\\u%04x", c);
+        } else {
+            fputc(c, fp);
+        }
+    }
+    fputc('"', fp);
+}
+
+static void put_usage()
+{
+    puts("usage: vgsx-headless [-g /path/to/pattern.chr]");
+    puts("                     [-c /path/to/palette.bin]");
+    puts("                     [-b /path/to/bgm.vgm]");
+    puts("                     [-s /path/to/sfx.wav]");
+    puts("                     [--frames=number_of_frames]");
+    puts("                     [--replay=/path/to/movie.vgsm]");
+    puts("                     [--hash=/path/to/hashes.txt]");
+    puts("                     [--capture=/path/to/output]");
+    puts("                     [--capture-format=png|raw]");
+    puts("                     [--capture-interval=frames]");
+    puts("                     [--wav=/path/to/output.wav]");
+    puts("                     [--json=/path/to/result.json]");
+    puts("                     [--telemetry=/path/to/telemetry.json]");
+    puts("                     [--telemetry-format=jsonl|trace]");
+    puts("                     { /path/to/program.elf | /path/to/program.rom }");
+}
+
+int main(int argc, char* argv[])
+{
+    vgsx.setLogCallback([](VGSX::LogLevel level, const char* msg) {
+        if (VGSX::LogLevel::W <= level) {
+            printf("[%s] %s\n", VGSX::LogLevel::W == level ? "warning" : "error", msg);
+        }
+    });
+    vgsx.disableBootBios();
+
+    // the assets must be kept while running
+    std::vector<std::vector<uint8_t>> assets;
+    const char* programPath = nullptr;
+    const char* replayPath = nullptr;
+    const char* hashPath = nullptr;
+    const char* jsonPath = nullptr;
+    const char* capturePath = nullptr;
+    const char* wavPath = nullptr;
+    const char* telemetryPath = nullptr;
+    TelemetryWriter::Format telemetryFormat = TelemetryWriter::Format::Lines;
+    FrameCapture::Format captureFormat = FrameCapture::Format::Png;
+    int captureInterval = 1;
+    int frames = -1;
+    uint16_t pindex = 0;
+    uint16_t bindex = 0;
+    uint8_t sindex = 0;
+    for (int i = 1; i < argc; i++) {
+        if (0 == strncmp(argv[i], "--frames=", 9)) {
+            frames = atoi(argv[i] + 9);
+        } else if (0 == strncmp(argv[i], "--replay=", 9)) {
+            replayPath = argv[i] + 9;
+        } else if (0 == strncmp(argv[i], "--hash=", 7)) {
+            hashPath = argv[i] + 7;
+        } else if (0 == strncmp(argv[i], "--json=", 7)) {
+            jsonPath = argv[i] + 7;
+        } else if (0 == strncmp(argv[i], "--capture=", 10)) {
+            capturePath = argv[i] + 10;
+        } else if (0 == strcmp(argv[i], "--capture-format=png")) {
+            captureFormat = FrameCapture::Format::Png;
+        } else if (0 == strcmp(argv[i], "--capture-format=raw")) {
+            captureFormat = FrameCapture::Format::Raw;
+        } else if (0 == strncmp(argv[i], "--capture-interval=", 19)) {
+            captureInterval = atoi(argv[i] + 19);
+            if (captureInterval < 1) {
+                put_usage();
+                return 1;
+            }
+        } else if (0 == strncmp(argv[i], "--wav=", 6)) {
+            wavPath = argv[i] + 6;
+        } else if (0 == strncmp(argv[i], "--telemetry=", 12)) {
+            telemetryPath = argv[i] + 12;
+        } else if (0 == strcmp(argv[i], "--telemetry-format=jsonl")) {
+            telemetryFormat = TelemetryWriter::Format::Lines;
+        } else if (0 == strcmp(argv[i], "--telemetry-format=trace")) {
+            telemetryFormat = TelemetryWriter::Format::Trace;
+        } else if ('-' == argv[i][0]) {
+            if (argc <= i + 1 || argv[i][2]) {
+                put_usage();
+                return 1;
+            }
+            const char option = (char)tolower(argv[i][1]);
+            i++;
+            assets.push_back(loadBinary(argv[i]));
+            const auto& data = assets.back();
+            bool succeed;
+            switch (option) {
+                case 'g':
+                    succeed = vgsx.loadPattern(pindex, data.data(), data.size());
+                    pindex += (uint16_t)(data.size() / 32);
+                    break;
+                case 'c': succeed = vgsx.loadPalette(data.data(), data.size()); break;
+                case 'b': succeed = vgsx.loadVgm(bindex++, data.data(), data.size()); break;
+                case 's': succeed = vgsx.loadWav(sindex++, data.data(), data.size()); break;
+                default: put_usage(); return 1;
+            }
+            if (!succeed) {
+                printf("Load failed: %s (%s)\n", vgsx.getLastError(), argv[i]);
+                return 255;
+            }
+        } else if (programPath) {
+            put_usage();
+            return 1;
+        } else {
+            programPath = argv[i];
+        }
+    }
+    if (!programPath) {
+        put_usage();
+        return 1;
+    }
+
+    assets.push_back(loadBinary(programPath));
+    const auto& program = assets.back();
+    if (program.size() < 4 || !(0 == memcmp(program.data(), "VGSX", 4) ? vgsx.loadRom(program.data(), program.size()) : vgsx.loadProgram(program.data(), program.size()))) {
+        printf("Load failed: %s\n", vgsx.getLastError());
+        return 255;
+    }
+
+    if (replayPath) {
+        auto movie = loadBinary(replayPath);
+        if (!vgsx.startReplay(movie.data(), movie.size())) {
+            printf("Replay failed: %s\n", vgsx.getLastError());
+            return 255;
+        }
+        if (frames < 0) {
+            frames = vgsx.getMovieFrames();
+        }
+    }
+    if (frames < 0) {
+        frames = 0x7FFFFFFF; // until the program exits
+    }
+    FILE* hashFile = nullptr;
+    if (hashPath) {
+        hashFile = fopen(hashPath, "w");
+        if (!hashFile) {
+            printf("Cannot write: %s\n", hashPath);
+            return 255;
+        }
+    }
+    WavWriter wav;
+    if (wavPath && !wav.open(wavPath, vgsx.getSampleRate())) {
+        printf("Cannot write: %s\n", wavPath);
+        return 255;
+    }
+    FrameCapture capture;
+    if (capturePath && !capture.start(vgsx, capturePath, captureFormat, captureInterval, 64, true)) {
+        printf("Cannot write: %s\n", capturePath);
+        return 255;
+    }
+    TelemetryWriter telemetry;
+    if (telemetryPath && !telemetry.start(vgsx, telemetryPath, telemetryFormat)) {
+        printf("Cannot write: %s\n", telemetryPath);
+        return 255;
+    }
+
+    // the BGM advances by one frame of samples between the frames (or as recorded in the movie)
+    const int samplesPerFrame = vgsx.getSampleRate() * 2 / 60;
+    std::vector<int16_t> soundBuffer;
+    PerfCounter cpuPerf;
+    PerfCounter renderPerf;
+    PerfCounter soundPerf;
+    uint64_t totalClocks = 0;
+    uint32_t maxClocks = 0;
+    int frame = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (; frame < frames && !vgsx.isExit(); frame++) {
+        const int samples = vgsx.isReplaying() ? vgsx.getMovieSamples() : samplesPerFrame;
+        if (0 < samples) {
+            soundBuffer.resize(samples);
+            auto t = std::chrono::steady_clock::now();
+            vgsx.tickSound(soundBuffer.data(), samples);
+            soundPerf.add(t);
+            wav.write(soundBuffer.data(), samples);
+        }
+        auto t = std::chrono::steady_clock::now();
+        vgsx.tick(true);
+        cpuPerf.add(t);
+        t = std::chrono::steady_clock::now();
+        vgsx.render();
+        renderPerf.add(t);
+        totalClocks += vgsx.ctx.frameClocks;
+        maxClocks = maxClocks < vgsx.ctx.frameClocks ? vgsx.ctx.frameClocks : maxClocks;
+        if (hashFile) {
+            fprintf(hashFile, "%d %016llx %016llx\n", frame, (unsigned long long)vgsx.getRamHash(), (unsigned long long)vgsx.getDisplayHash());
+        }
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (hashFile) {
+        fclose(hashFile);
+    }
+    wav.close();
+    capture.stop();
+    telemetry.stop();
+
+    printf("\n[PERFORMANCE]\n");
+    printf("%d frames in %.3f seconds (%.1f fps, %.1fx real time)\n", frame, seconds, frame / seconds, frame / seconds / 60.0);
+    printf("Cycles: average %.0f, maximum %u per frame\n", frame ? (double)totalClocks / frame : 0.0, maxClocks);
+    cpuPerf.print("CPU:", frame);
+    renderPerf.print("Render:", frame);
+    soundPerf.print("Sound:", frame);
+    if (capturePath) {
+        printf("Captured %d frames to %s (%d dropped%s)\n", capture.getCapturedFrames(), capturePath, capture.getDroppedFrames(), capture.isFailed() ? ", write error" : "");
+        capture.printRawHint();
+    }
+    if (telemetryPath) {
+        printf("Wrote the telemetry of %d frames to %s\n", telemetry.getFrames(), telemetryPath);
+    }
+    printAudioStats(vgsx.getAudioStats(), vgsx.getSampleRate());
+    if (jsonPath) {
+        // the same summary for tracking the performance over time
+        FILE* fp = fopen(jsonPath, "w");
+        if (!fp) {
+            printf("Cannot write: %s\n", jsonPath);
+            return 255;
+        }
+        fprintf(fp, "{\n");
+        fprintf(fp, "  \"program\": ");
+        putJsonString(fp, programPath);
+        fprintf(fp, ",\n");
+        fprintf(fp, "  \"frames\": %d,\n", frame);
+        fprintf(fp, "  \"seconds\": %.4f,\n", seconds);
+        fprintf(fp, "  \"fps\": %.1f,\n", frame / seconds);
+        fprintf(fp, "  \"cycles\": {\"average\": %.0f, \"max\": %u},\n", frame ? (double)totalClocks / frame : 0.0, maxClocks);
+        cpuPerf.json(fp, "cpu", frame);
+        renderPerf.json(fp, "render", frame);
+        soundPerf.json(fp, "sound", frame);
+        fprintf(fp, "  \"exit_code\": %d\n", vgsx.isExit() ? vgsx.getExitCode() : 0);
+        fprintf(fp, "}\n");
+        fclose(fp);
+    }
+    if (replayPath && vgsx.isReplaying()) {
+        printf("Replay stopped at frame %d of %d\n", vgsx.getMovieFrame(), vgsx.getMovieFrames());
+    }
+    return vgsx.isExit() ? vgsx.getExitCode() : 0;
+}
@@ -0,0 +1,268 @@
+// Microbenchmarks of the core (VDP, CRT filter, YM2612, SFX mixer and the memory bus of the CPU)
+//
+// usage: bench [--filter=substring] [--time=seconds] [--json=/path/to/result.json]
+// The summary is printed to stderr and the results are written as JSON to stdout (or --json).
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "vgsx.h"
+#include "vgs_io.h"
+#include "crt_helper.hpp"
+#include "elf_fixture.h"
+#include "../common/load_binary.h"
+
+struct Benchmark {
+    const char* name;
+    const char* description;
+    std::function<void()> setup;
+    std::function<void()> run; // one iteration (a frame)
+};
+
+struct Result {
+    const char* name;
+    int iterations;
+    double meanNanos;
+    double medianNanos;
+    double minNanos;
+    double maxNanos;
+    double clocks; // emulated CPU clocks per iteration (0: not applicable)
+};
+
+static uint32_t xorshift()
+{
+    static uint32_t seed = 2463534242u;
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return seed;
+}
+
+// random patterns (mostly opaque) and palettes for the VDP benchmarks
+static void setupVdp()
+{
+    auto& ctx = vgsx.vdp.ctx;
+    vgsx.vdp.reset();
+    for (int i = 0; i < 1024; i++) {
+        for (int j = 0; j < 32; j++) {
+            ctx.ptn[i][j] = (uint8_t)(xorshift() | 0x11);
+        }
+    }
+    for (int i = 0; i < 16; i++) {
+        for (int j = 0; j < VDP_PALETTE_COLOR_NUM; j++) {
+            ctx.palette[i][j] = xorshift() & 0xFFFFFF;
+        }
+    }
+    ctx.reg.skip0 = 1;
+    ctx.reg.skip1 = 1;
+    ctx.reg.skip2 = 1;
+    ctx.reg.skip3 = 1;
+}
+
+static void setupBG(int count, bool bitmap)
+{
+    auto& ctx = vgsx.vdp.ctx;
+    setupVdp();
+    for (int n = 0; n < count; n++) {
+        ((uint32_t*)&ctx.reg.skip0)[n] = 0;
+        ctx.reg.bmp[n] = bitmap ? 1 : 0;
+        ctx.reg.scrollX[n] = 13 * (n + 1);
+        ctx.reg.scrollY[n] = 7 * (n + 1);
+        for (int i = 0; i < 65536; i++) {
+            const uint32_t r = xorshift();
+            ctx.nametbl[n][i] = bitmap ? (r & 0xFFFFFF) : (((r >> 16) & 0x0F) << 16 | (r & 0x3FF));
+        }
+    }
+}
+
+static void setupSprites(int count, int size, int rotate, int scale, uint32_t alpha)
+{
+    auto& ctx = vgsx.vdp.ctx;
+    setupVdp();
+    for (int i = 0; i < count; i++) {
+        auto& oam = ctx.oam[i];
+        oam.visible = 1;
+        oam.x = (int32_t)(xorshift() % (VDP_WIDTH - 8 * (size + 1)));
+        oam.y = (int32_t)(xorshift() % (VDP_HEIGHT - 8 * (size + 1)));
+        oam.size = size;
+        oam.attr = (i & 0x0F) << 16 | ((i * 4) & 0x3FF);
+        oam.rotate = rotate ? rotate + i % 90 : 0;
+        oam.scale = scale;
+        oam.alpha = alpha;
+    }
+}
+
+// copy 16KB per frame with move.l (a0)+,(a1)+ from WRAM to the destination, then wait for V-SYNC
+static void setupBus(uint32_t destination)
+{
+    static std::vector<uint8_t> elf;
+    elf = makeElf({
+        0x41F9, 0x00F0, 0x0000,                                         // lea ($F00000).l, a0
+        0x43F9, (uint16_t)(destination >> 16), (uint16_t)destination, // lea (destination).l, a1
+        0x303C, 0x0FFF,                                                 // move.w #4095, d0
+        0x22D8,                                                         // move.l (a0)+, (a1)+
+        0x51C8, 0xFFFC,                                                 // dbra d0, copy
+        0x4AB9, 0x00E0, 0x0000,                                         // tst.l ($E00000).l (V-SYNC)
+        0x60E2,                                                         // bra.s loop
+    });
+    if (!vgsx.loadProgram(elf.data(), elf.size())) {
+        std::fprintf(stderr, "Load failed: %s\n", vgsx.getLastError());
+        exit(255);
+    }
+}
+
+static std::vector<Benchmark> makeBenchmarks()
+{
+    static std::vector<uint32_t> crtOutput(VDP_DISPLAY_PIXELS * 4);
+    static crt_helper::Filter crtFilter;
+    static std::vector<int16_t> sound;
+    static std::vector<uint8_t> vgm;
+    static std::vector<uint8_t> wav;
+    auto render = []() { vgsx.vdp.render(); };
+    auto tickSound = []() { vgsx.tickSound(sound.data(), (int)sound.size()); };
+    auto setupSound = []() {
+        vgsx.reset();
+        sound.resize(vgsx.getSampleRate() * 2 / 60);
+    };
+
+    std::vector<Benchmark> benchmarks;
+    benchmarks.push_back({"vdp_bg_character_1", "BG0 in character pattern mode", []() { setupBG(1, false); }, render});
+    benchmarks.push_back({"vdp_bg_character_4", "BG0-3 in character pattern mode", []() { setupBG(4, false); }, render});
+    benchmarks.push_back({"vdp_bg_bitmap_1", "BG0 in bitmap mode", []() { setupBG(1, true); }, render});
+    benchmarks.push_back({"vdp_bg_bitmap_4", "BG0-3 in bitmap mode", []() { setupBG(4, true); }, render});
+    benchmarks.push_back({"vdp_sprite_plain", "256 sprites of 16x16", []() { setupSprites(256, 1, 0, 100, 0xFFFFFF); }, render});
+    benchmarks.push_back({"vdp_sprite_rotate", "256 rotated sprites of 16x16", []() { setupSprites(256, 1, 15, 100, 0xFFFFFF); }, render});
+    benchmarks.push_back({"vdp_sprite_scale", "256 sprites of 16x16 at 200%", []() { setupSprites(256, 1, 0, 200, 0xFFFFFF); }, render});
+    benchmarks.push_back({"vdp_sprite_alpha", "256 sprites of 16x16 with alpha", []() { setupSprites(256, 1, 0, 100, 0x808080); }, render});
+    benchmarks.push_back({"vdp_sprite_rotate_alpha_1024", "1024 rotated sprites of 16x16 with alpha", []() { setupSprites(1024, 1, 15, 100, 0x808080); }, render});
+    benchmarks.push_back({"vdp_sprite_large", "16 rotated sprites of 128x128 at 150%", []() { setupSprites(16, 15, 30, 150, 0xFFFFFF); }, render});
+    benchmarks.push_back({"crt_filter", "CRT filter of the display", []() { setupBG(1, true); vgsx.vdp.render(); crtFilter.init(); }, []() { crtFilter.apply(vgsx.vdp.ctx.display, crtOutput.data(), VDP_DISPLAY_WIDTH, VDP_DISPLAY_HEIGHT); }});
+    benchmarks.push_back({"crt_filter_2x", "CRT filter of the display (2x)", []() { setupBG(1, true); vgsx.vdp.render(); crtFilter.init(); }, []() { crtFilter.apply2x(vgsx.vdp.ctx.display, crtOutput.data(), VDP_DISPLAY_WIDTH, VDP_DISPLAY_HEIGHT); }});
+    benchmarks.push_back({"ym2612_render", "YM2612 (example/10_ym2612) per frame of samples", [=]() {
+        setupSound();
+        vgm = loadBinary("../../example/10_ym2612/test.vgm");
+        if (!vgsx.loadVgm(0, vgm.data(), vgm.size())) {
+            std::fprintf(stderr, "Load failed: %s\n", vgsx.getLastError());
+            exit(255);
+        }
+        vgsx.outPort(VGS_ADDR_VGM_PLAY, 0); }, tickSound});
+    benchmarks.push_back({"sfx_mix_16", "16 SFX voices (example/01_hello) per frame of samples", [=]() {
+        setupSound();
+        wav = loadBinary("../../example/01_hello/test.wav");
+        for (int i = 0; i < 16; i++) {
+            if (!vgsx.loadWav(i, wav.data(), wav.size())) {
+                std::fprintf(stderr, "Load failed: %s\n", vgsx.getLastError());
+                exit(255);
+            }
+        } }, [=]() {
+        for (int i = 0; i < 16; i++) {
+            if (!vgsx.ctx.sfxData[i].play) {
+                vgsx.outPort(VGS_ADDR_SFX_PLAY, i);
+            }
+        }
+        vgsx.tickSound(sound.data(), (int)sound.size()); }});
+    benchmarks.push_back({"bus_ram_copy", "CPU copying 16KB from WRAM to WRAM per frame", []() { setupBus(0xF10000); }, []() { vgsx.tick(true); }});
+    benchmarks.push_back({"bus_vram_copy", "CPU copying 16KB from WRAM to the name table per frame", []() { setupBus(0xC00000); }, []() { vgsx.tick(true); }});
+    return benchmarks;
+}
+
+static Result measure(const Benchmark& benchmark, double seconds)
+{
+    benchmark.setup();
+    for (int i = 0; i < 3; i++) {
+        benchmark.run(); // warm up
+    }
+    std::vector<double> samples;
+    uint64_t clocks = 0;
+    const auto start = std::chrono::steady_clock::now();
+    do {
+        const auto t = std::chrono::steady_clock::now();
+        benchmark.run();
+        samples.push_back(std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t).count());
+        clocks += vgsx.ctx.frameClocks;
+    } while (samples.size() < 10 || std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() < seconds);
+    Result result;
+    result.name = benchmark.name;
+    result.iterations = (int)samples.size();
+    double total = 0;
+    for (double sample : samples) {
+        total += sample;
+    }
+    result.meanNanos = total / samples.size();
+    std::sort(samples.begin(), samples.end());
+    result.medianNanos = samples[samples.size() / 2];
+    result.minNanos = samples.front();
+    result.maxNanos = samples.back();
+    result.clocks = 0 == strncmp(benchmark.name, "bus_", 4) ? (double)clocks / samples.size() : 0;
+    return result;
+}
+
+static void writeJson(FILE* fp, const std::vector<Result>& results)
+{
+    fprintf(fp, "{\n");
+    fprintf(fp, "  \"version\": 1,\n");
+    fprintf(fp, "  \"compiler\": \"%s\",\n", __VERSION__);
+    fprintf(fp, "  \"unit\": \"ns\",\n");
+    fprintf(fp, "  \"benchmarks\": [\n");
+    for (size_t i = 0; i < results.size(); i++) {
+        const auto& r = results[i];
+        fprintf(fp, "    {\"name\": \"%s\", \"iterations\": %d, \"mean\": %.0f, \"median\": %.0f, \"min\": %.0f, \"max\": %.0f", r.name, r.iterations, r.meanNanos, r.medianNanos, r.minNanos, r.maxNanos);
+        if (r.clocks) {
+            fprintf(fp, ", \"clocks\": %.0f", r.clocks);
+        }
+        fprintf(fp, "}%s\n", i + 1 < results.size() ? "," : "");
+    }
+    fprintf(fp, "  ]\n");
+    fprintf(fp, "}\n");
+}
+
+int main(int argc, char* argv[])
+{
+    const char* filter = nullptr;
+    const char* jsonPath = nullptr;
+    double seconds = 0.5;
+    for (int i = 1; i < argc; i++) {
+        if (0 == strncmp(argv[i], "--filter=", 9)) {
+            filter = argv[i] + 9;
+        } else if (0 == strncmp(argv[i], "--time=", 7)) {
+            seconds = atof(argv[i] + 7);
+        } else if (0 == strncmp(argv[i], "--json=", 7)) {
+            jsonPath = argv[i] + 7;
+        } else {
+            std::fprintf(stderr, "usage: bench [--filter=substring] [--time=seconds] [--json=/path/to/result.json]\n");
+            return 1;
+        }
+    }
+
+    vgsx.disableBootBios();
+    std::vector<Result> results;
+    for (const auto& benchmark : makeBenchmarks()) {
+        if (filter && !strstr(benchmark.name, filter)) {
+            continue;
+        }
+        results.push_back(measure(benchmark, seconds));
+        const auto& r = results.back();
+        std::fprintf(stderr, "%-30s %10.3fms median %10.3fms min", r.name, r.medianNanos / 1000000.0, r.minNanos / 1000000.0);
+        if (r.clocks) {
+            std::fprintf(stderr, " (%.1f MHz emulated)", r.clocks * 1000.0 / r.medianNanos);
+        }
+        std::fprintf(stderr, "  %s\n", benchmark.description);
+    }
+
+    FILE* fp = jsonPath ? fopen(jsonPath, "w") : stdout;
+    if (!fp) {
+        std::fprintf(stderr, "Cannot write: %s\n", jsonPath);
+        return 255;
+    }
+    writeJson(fp, results);
+    if (jsonPath) {
+        fclose(fp);
+    }
+    return 0;
+}
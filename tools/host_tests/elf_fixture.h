@@ -0,0 +1,37 @@
+// Test fixture of the host tools: build a program from raw MC68000 code (shared by test_io and bench)
+#pragma once
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+// minimal ELF (big endian MC68000) that runs the code from 0x1000
+static std::vector<uint8_t> makeElf(const std::vector<uint16_t>& code)
+{
+    std::vector<uint8_t> elf(0x2000, 0);
+    auto put16 = [&](size_t offset, uint16_t value) {
+        elf[offset] = (uint8_t)(value >> 8);
+        elf[offset + 1] = (uint8_t)value;
+    };
+    auto put32 = [&](size_t offset, uint32_t value) {
+        put16(offset, (uint16_t)(value >> 16));
+        put16(offset + 2, (uint16_t)value);
+    };
+    const uint8_t ident[] = {0x7F, 'E', 'L', 'F', 1, 2, 1};
+    memcpy(elf.data(), ident, sizeof(ident));
+    put16(16, 2);      // e_type: EXEC
+    put16(18, 4);      // e_machine: MC68000
+    put32(20, 1);      // e_version
+    put32(24, 0x1000); // e_entry
+    put32(28, 52);     // e_phoff
+    put16(40, 52);     // e_ehsize
+    put16(42, 32);     // e_phentsize
+    put16(44, 1);      // e_phnum
+    put32(52, 1);      // p_type: LOAD
+    put32(68, 0x2000); // p_filesz
+    put32(72, 0x2000); // p_memsz
+    put32(76, 5);      // p_flags: R+X
+    for (size_t i = 0; i < code.size(); i++) {
+        put16(0x1000 + i * 2, code[i]);
+    }
+    return elf;
+}
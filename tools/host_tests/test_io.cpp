@@ -1,10 +1,15 @@
+#include <algorithm>
 #include <cstdint>
+#include <cstdlib>
 #include <cstdio>
+#include <cstring>
+#include <string>
 #include <vector>
 
 #include "vdp.hpp"
 #include "vgsx.h"
 #include "vgs_io.h"
+#include "elf_fixture.h"
 
 static int fail(const char* msg)
 {
@@ -78,6 +83,30 @@ static int test_dma_memset_last_byte(VGSX& vgs)
     return 0;
 }
 
+static int test_dma_u2s_ascii_run_and_kanji(VGSX& vgs)
+{
+    // "Hello, VGS-X world! " + "あいう" + "ABCDEFGHIJ"
+    const uint8_t utf8[] = "Hello, VGS-X world! \xE3\x81\x82\xE3\x81\x84\xE3\x81\x86" "ABCDEFGHIJ";
+    const uint8_t sjis[] = "Hello, VGS-X world! \x82\xA0\x82\xA2\x82\xA4" "ABCDEFGHIJ";
+    memcpy(&vgs.ctx.ram[0x10000], utf8, sizeof(utf8));
+    memset(&vgs.ctx.ram[0x20000], 0xFF, 0x100);
+    vgs.outPort(VGS_ADDR_DMA_DESTINATION, 0xF20000);
+    vgs.outPort(VGS_ADDR_DMA_SOURCE, 0xF10000);
+    vgs.outPort(VGS_ADDR_DMA_EXECUTE, VGS_DMA_UTF8_TO_SJIS);
+    if (0 != memcmp(&vgs.ctx.ram[0x20000], sjis, sizeof(sjis))) {
+        return fail("DMA u2s result mismatch");
+    }
+
+    // The destination must not overflow the end of RAM.
+    memcpy(&vgs.ctx.ram[0x10000], utf8, sizeof(utf8));
+    vgs.outPort(VGS_ADDR_DMA_DESTINATION, 0xFFFFF8);
+    vgs.outPort(VGS_ADDR_DMA_EXECUTE, VGS_DMA_UTF8_TO_SJIS);
+    if (0 != memcmp(&vgs.ctx.ram[0xFFFF8], "Hello, ", 7) || vgs.ctx.ram[0xFFFFF] != 0) {
+        return fail("DMA u2s did not clamp to the end of RAM");
+    }
+    return 0;
+}
+
 static int test_seq_write_clamps_to_1mb(VGSX& vgs)
 {
     vgs.outPort(VGS_ADDR_SEQ_OPEN_W, 0);
@@ -121,7 +150,7 @@ static int test_sprite_size_63_renders_512_pixels()
 
 static int test_palette_1024_addressing_and_rendering(VGSX& vgs)
 {
-    std::vector<uint32_t> palette(VDP_PALETTE_NUM * VDP_PALETTE_COLOR_NUM, 0);
+    static std::vector<uint32_t> palette(VDP_PALETTE_NUM * VDP_PALETTE_COLOR_NUM, 0); // referred by VGSX::reset
     if (!vgs.loadPalette(palette.data(), palette.size() * sizeof(palette[0]))) {
         return fail("64KB palette data was rejected");
     }
@@ -168,6 +197,1521 @@ static int test_palette_1024_addressing_and_rendering(VGSX& vgs)
     return 0;
 }
 
+static int test_vdp_string_draw_and_advance()
+{
+    VDP vdp;
+    std::vector<uint8_t> ram(1024 * 1024, 0);
+    static const char kSjis[] = "A\x82\xA0" "B";
+    std::memcpy(&ram[0x100], kSjis, sizeof(kSjis));
+    vdp.setCpuRam(ram.data());
+    vdp.reset();
+
+    // k8x12 string must match drawing each glyph individually
+    constexpr uint32_t kColor = 0xFFFFFF;
+    vdp.write(0xD2004C, 0);
+    vdp.write(0xD20050, 10);
+    vdp.write(0xD20054, 20);
+    vdp.write(0xD20060, kColor);
+    vdp.write(0xD20064, 0xF00100);
+    vdp.write(0xD20068, 9);
+    if (vdp.read(0xD200A8) != 16) {
+        return fail("k8x12 string advance width mismatch");
+    }
+    std::vector<uint32_t> stringDrawn(vdp.ctx.nametbl[0], vdp.ctx.nametbl[0] + VDP_WIDTH * VDP_HEIGHT);
+    vdp.reset();
+    vdp.write(0xD20060, kColor);
+    vdp.write(0xD20054, 20);
+    const struct {
+        int x;
+        uint32_t code;
+        uint32_t op;
+    } glyphs[] = {{10, 'A', 5}, {14, 3 * 94 + 1, 6}, {22, 'B', 5}};
+    for (const auto& glyph : glyphs) {
+        vdp.write(0xD20050, glyph.x);
+        vdp.write(0xD20064, glyph.code);
+        vdp.write(0xD20068, glyph.op);
+    }
+    if (0 != std::memcmp(stringDrawn.data(), vdp.ctx.nametbl[0], stringDrawn.size() * sizeof(uint32_t))) {
+        return fail("k8x12 string draw differs from per-glyph draw");
+    }
+    bool drawn = false;
+    for (uint32_t pixel : stringDrawn) {
+        drawn |= pixel == kColor;
+    }
+    if (!drawn) {
+        return fail("k8x12 string did not draw any pixel");
+    }
+
+    // proportional font string advances by the registered widths
+    vdp.reset();
+    memset(vdp.ctx.pinfo, 0, sizeof(vdp.ctx.pinfo));
+    vdp.ctx.pinfo['A'].width = 5;
+    vdp.ctx.ptn[0x200 + 'A'][0] = 0x10;
+    vdp.ctx.palette[3][1] = kColor;
+    std::memcpy(&ram[0x200], "AB", 3);
+    vdp.write(0xD20050, -3);
+    vdp.write(0xD20054, 0);
+    vdp.write(0xD20060, 3);
+    vdp.write(0xD200A4, 0x200);
+    vdp.write(0xD20064, 0xF00200);
+    vdp.write(0xD20068, 10);
+    if (vdp.read(0xD200A8) != 13) {
+        return fail("proportional string advance width mismatch");
+    }
+    if (vdp.ctx.nametbl[0][0] != 0) {
+        return fail("proportional string drew a clipped glyph");
+    }
+    vdp.write(0xD20050, 0);
+    vdp.write(0xD20068, 10);
+    if (vdp.ctx.nametbl[0][0] != kColor) {
+        return fail("proportional string did not draw the first glyph");
+    }
+
+    // invalid string address draws nothing
+    vdp.write(0xD20064, 0xD00000);
+    vdp.write(0xD20068, 10);
+    if (vdp.read(0xD200A8) != 0) {
+        return fail("string draw with an invalid address reported an advance width");
+    }
+    return 0;
+}
+
+static int test_sprite_hit_unit(VGSX& vgs)
+{
+    VDP& vdp = vgs.vdp;
+    vdp.reset();
+    auto putSprite = [&](int n, int x, int y, int size, uint32_t group) {
+        vdp.ctx.oam[n].visible = 1;
+        vdp.ctx.oam[n].x = x;
+        vdp.ctx.oam[n].y = y;
+        vdp.ctx.oam[n].size = size;
+        vdp.ctx.oam[n].scale = 100;
+        vdp.ctx.oam[n].group = group;
+    };
+
+    // player bullets (0-1) vs enemies (10-12)
+    putSprite(0, 100, 100, 0, 1);
+    putSprite(1, 200, 50, 0, 1);
+    putSprite(10, 104, 104, 1, 2); // overlaps bullet 0
+    putSprite(11, 108, 100, 0, 2); // touches bullet 0 edge only (no hit)
+    putSprite(12, 196, 46, 0, 4);  // overlaps bullet 1 but masked out
+    vgs.outPort(VGS_ADDR_HIT_A_FIRST, 0);
+    vgs.outPort(VGS_ADDR_HIT_A_LAST, 9);
+    vgs.outPort(VGS_ADDR_HIT_A_MASK, 0);
+    vgs.outPort(VGS_ADDR_HIT_B_FIRST, 10);
+    vgs.outPort(VGS_ADDR_HIT_B_LAST, 19);
+    vgs.outPort(VGS_ADDR_HIT_B_MASK, 2);
+    vgs.outPort(VGS_ADDR_HIT_MODE, VGS_HIT_MODE_RECT | VGS_HIT_MODE_PAIRS);
+    vgs.outPort(VGS_ADDR_HIT_BUFFER, 0xF00000);
+    vgs.outPort(VGS_ADDR_HIT_LIMIT, 16);
+    vgs.outPort(VGS_ADDR_HIT_EXECUTE, 0);
+    if (vgs.inPort(VGS_ADDR_HIT_EXECUTE) != 1) {
+        return fail("sprite hit count mismatch");
+    }
+    static const uint8_t kPair[] = {0x00, 0x00, 0x00, 0x0A};
+    if (0 != std::memcmp(vgs.ctx.ram, kPair, sizeof(kPair))) {
+        return fail("sprite hit pair mismatch");
+    }
+
+    // bitmask output marks both sides
+    vgs.outPort(VGS_ADDR_HIT_MODE, VGS_HIT_MODE_RECT | VGS_HIT_MODE_BITMASK);
+    vgs.outPort(VGS_ADDR_HIT_EXECUTE, 0);
+    if (vgs.ctx.ram[3] != 0x01 || vgs.ctx.ram[2] != 0x04 || vgs.ctx.ram[1] != 0 || vgs.ctx.ram[0] != 0) {
+        return fail("sprite hit bitmask mismatch");
+    }
+
+    // pixel exact: the overlapping area of bullet 0 and enemy 10 is transparent
+    vdp.ctx.oam[0].attr = 0x100;
+    vdp.ctx.oam[10].attr = 0x200;
+    memset(vdp.ctx.ptn[0x100], 0, 32);
+    memset(vdp.ctx.ptn[0x200], 0, 32 * 4);
+    vdp.ctx.ptn[0x100][0] = 0x10; // (0, 0) of bullet 0
+    vgs.outPort(VGS_ADDR_HIT_MODE, VGS_HIT_MODE_PIXEL | VGS_HIT_MODE_PAIRS);
+    vgs.outPort(VGS_ADDR_HIT_EXECUTE, 0);
+    if (vgs.inPort(VGS_ADDR_HIT_EXECUTE) != 0) {
+        return fail("pixel exact sprite hit detected a transparent overlap");
+    }
+    vdp.ctx.ptn[0x100][7 * 4 + 3] = 0x01; // (7, 7) of bullet 0
+    vdp.ctx.ptn[0x200][3 * 4 + 1] = 0x01; // (3, 3) of enemy 10
+    vgs.outPort(VGS_ADDR_HIT_EXECUTE, 0);
+    if (vgs.inPort(VGS_ADDR_HIT_EXECUTE) != 1) {
+        return fail("pixel exact sprite hit was not detected");
+    }
+
+    // flipped sprites: the renderer and the pixel exact hit test agree on where the solid pixel is
+    memset(vdp.ctx.ptn[0x100], 0, 32);
+    vdp.ctx.ptn[0x100][0] = 0x10; // (0, 0) of bullet 0 appears at (0, 7) by flipV
+    vdp.ctx.oam[0].attr = 0x40000000 | 0x100;
+    vdp.ctx.oam[0].alpha = 0xFFFFFF;
+    vdp.ctx.palette[0][1] = 0x123456;
+    vdp.render();
+    if (vdp.ctx.display[107 * 2 * VDP_DISPLAY_WIDTH + 100 * 2] != 0x123456 || vdp.ctx.display[100 * 2 * VDP_DISPLAY_WIDTH + 100 * 2] == 0x123456) {
+        return fail("vertically flipped sprite was not rendered upside down");
+    }
+    putSprite(13, 100, 107, 0, 2);
+    vdp.ctx.oam[13].attr = 0x300;
+    memset(vdp.ctx.ptn[0x300], 0, 32);
+    vdp.ctx.ptn[0x300][0] = 0x10; // (0, 0) of enemy 13
+    vgs.outPort(VGS_ADDR_HIT_EXECUTE, 0);
+    if (vgs.inPort(VGS_ADDR_HIT_EXECUTE) != 1 || vgs.ctx.ram[3] != 13) {
+        return fail("pixel exact sprite hit missed the vertically flipped pixel");
+    }
+    vdp.ctx.oam[0].attr = 0x80000000 | 0x100;
+    vgs.outPort(VGS_ADDR_HIT_EXECUTE, 0);
+    if (vgs.inPort(VGS_ADDR_HIT_EXECUTE) != 0) {
+        return fail("pixel exact sprite hit flipped the pixel of a horizontally flipped sprite vertically");
+    }
+
+    // the grid broadphase must match brute force for 1024 random sprites in one group
+    vdp.reset();
+    uint32_t seed = 12345;
+    auto rnd = [&seed](int n) {
+        seed = seed * 1103515245 + 12345;
+        return (int)((seed >> 16) % n);
+    };
+    for (int i = 0; i < 1024; i++) {
+        putSprite(i, rnd(400) - 40, rnd(300) - 50, rnd(8) ? 0 : rnd(4), 0);
+        vdp.ctx.oam[i].visible = rnd(10) ? 1 : 0;
+    }
+    VDP::HitQuery query = {0, 1023, 0, 1023, 0, 0, false};
+    std::vector<VDP::HitPair> hits;
+    vdp.detectSpriteHits(query, hits);
+    std::vector<VDP::HitPair> expected;
+    for (int i = 0; i < 1024; i++) {
+        for (int j = i + 1; j < 1024; j++) {
+            const auto& a = vdp.ctx.oam[i];
+            const auto& b = vdp.ctx.oam[j];
+            int as = (a.size + 1) * 8;
+            int bs = (b.size + 1) * 8;
+            if (a.visible && b.visible && a.x < b.x + bs && b.x < a.x + as && a.y < b.y + bs && b.y < a.y + as) {
+                expected.push_back(VDP::HitPair(i, j));
+            }
+        }
+    }
+    if (expected.empty() || hits != expected) {
+        return fail("sprite hit broadphase differs from brute force");
+    }
+    vdp.reset();
+    return 0;
+}
+
+static void putBE32(uint8_t* ptr, int32_t value)
+{
+    ptr[0] = ((uint32_t)value >> 24) & 0xFF;
+    ptr[1] = ((uint32_t)value >> 16) & 0xFF;
+    ptr[2] = ((uint32_t)value >> 8) & 0xFF;
+    ptr[3] = (uint32_t)value & 0xFF;
+}
+
+static int32_t getBE32(const uint8_t* ptr)
+{
+    return (int32_t)(((uint32_t)ptr[0] << 24) | ((uint32_t)ptr[1] << 16) | ((uint32_t)ptr[2] << 8) | ptr[3]);
+}
+
+static int test_math_array(VGSX& vgs)
+{
+    uint8_t* src = &vgs.ctx.ram[0x1000];
+    uint8_t* dst = &vgs.ctx.ram[0x2000];
+    auto execute = [&](uint32_t op, uint32_t count, int32_t arg) {
+        vgs.outPort(VGS_ADDR_MATH_SOURCE, 0xF01000);
+        vgs.outPort(VGS_ADDR_MATH_DESTINATION, 0xF02000);
+        vgs.outPort(VGS_ADDR_MATH_COUNT, count);
+        vgs.outPort(VGS_ADDR_MATH_ARGUMENT, (uint32_t)arg);
+        vgs.outPort(VGS_ADDR_MATH_EXECUTE, op);
+        return vgs.inPort(VGS_ADDR_MATH_EXECUTE);
+    };
+
+    // sin/cos must match the angle unit
+    for (int i = 0; i < 720; i++) {
+        putBE32(&src[i * 4], i - 360);
+    }
+    if (execute(VGS_MATH_SIN, 720, 0) != 720) {
+        return fail("math sin was rejected");
+    }
+    for (int i = 0; i < 720; i++) {
+        vgs.outPort(VGS_ADDR_ANGLE_DEGREE, (uint32_t)(i - 360));
+        if (getBE32(&dst[i * 4]) != (int32_t)vgs.inPort(VGS_ADDR_ANGLE_SIN)) {
+            return fail("math sin differs from the angle unit");
+        }
+    }
+
+    // atan2 must match the angle unit
+    static const int32_t kVectors[][2] = {{10, 0}, {0, 10}, {-10, 0}, {0, -10}, {3, 4}, {-7, -2}, {100000, -1}};
+    const int vectors = (int)(sizeof(kVectors) / sizeof(kVectors[0]));
+    for (int i = 0; i < vectors; i++) {
+        putBE32(&src[i * 8], kVectors[i][0]);
+        putBE32(&src[i * 8 + 4], kVectors[i][1]);
+    }
+    execute(VGS_MATH_DEGREE, vectors, 0);
+    for (int i = 0; i < vectors; i++) {
+        vgs.outPort(VGS_ADDR_ANGLE_X1, 0);
+        vgs.outPort(VGS_ADDR_ANGLE_Y1, 0);
+        vgs.outPort(VGS_ADDR_ANGLE_X2, (uint32_t)kVectors[i][0]);
+        vgs.outPort(VGS_ADDR_ANGLE_Y2, (uint32_t)kVectors[i][1]);
+        if (getBE32(&dst[i * 4]) != (int32_t)vgs.inPort(VGS_ADDR_ANGLE_DEGREE)) {
+            return fail("math degree differs from the angle unit");
+        }
+    }
+
+    // hypot / normalize / rotate
+    putBE32(&src[0], 3);
+    putBE32(&src[4], 4);
+    execute(VGS_MATH_HYPOT, 1, 0);
+    if (getBE32(&dst[0]) != 5) {
+        return fail("math hypot mismatch");
+    }
+    execute(VGS_MATH_NORMALIZE, 1, 256);
+    if (getBE32(&dst[0]) != 153 || getBE32(&dst[4]) != 204) {
+        return fail("math normalize mismatch");
+    }
+    // the sum of the squares of the most negative vector is 2^63
+    putBE32(&src[0], INT32_MIN);
+    putBE32(&src[4], INT32_MIN);
+    execute(VGS_MATH_HYPOT, 1, 0);
+    if (getBE32(&dst[0]) != INT32_MAX) {
+        return fail("math hypot of INT32_MIN must saturate");
+    }
+    execute(VGS_MATH_NORMALIZE, 1, 256);
+    if (getBE32(&dst[0]) != -181 || getBE32(&dst[4]) != -181) {
+        return fail("math normalize of INT32_MIN mismatch");
+    }
+    putBE32(&src[0], 256);
+    putBE32(&src[4], 0);
+    execute(VGS_MATH_ROTATE, 1, 90);
+    if (getBE32(&dst[0]) != 0 || getBE32(&dst[4]) != 256) {
+        return fail("math rotate mismatch");
+    }
+
+    // sqrt of the full unsigned range
+    static const uint32_t kSquares[] = {0, 1, 2, 15, 16, 17, 0xFFFE0001, 0xFFFFFFFF};
+    static const int32_t kRoots[] = {0, 1, 1, 3, 4, 4, 0xFFFF, 0xFFFF};
+    for (int i = 0; i < 8; i++) {
+        putBE32(&src[i * 4], (int32_t)kSquares[i]);
+    }
+    execute(VGS_MATH_SQRT, 8, 0);
+    for (int i = 0; i < 8; i++) {
+        if (getBE32(&dst[i * 4]) != kRoots[i]) {
+            return fail("math sqrt mismatch");
+        }
+    }
+
+    // 16.16 multiply-accumulate: dst += src * 1.5
+    putBE32(&src[0], 0x00020000);
+    putBE32(&src[4], -0x00010000);
+    putBE32(&dst[0], 0x00010000);
+    putBE32(&dst[4], 0);
+    execute(VGS_MATH_MAC, 2, 0x00018000);
+    if (getBE32(&dst[0]) != 0x00040000 || getBE32(&dst[4]) != -0x00018000) {
+        return fail("math mac mismatch");
+    }
+
+    // destination must be RAM
+    vgs.outPort(VGS_ADDR_MATH_DESTINATION, 0x000000);
+    vgs.outPort(VGS_ADDR_MATH_EXECUTE, VGS_MATH_SIN);
+    if (vgs.inPort(VGS_ADDR_MATH_EXECUTE) != 0) {
+        return fail("math accepted a non-RAM destination");
+    }
+    return 0;
+}
+
+static int test_dma_sort(VGSX& vgs)
+{
+    // 1024 records of 8 bytes: { uint16 id, int16 y, int32 score }
+    constexpr uint32_t kCount = 1024;
+    constexpr uint32_t kSize = 8;
+    struct Record {
+        uint16_t id;
+        int16_t y;
+        int32_t score;
+    };
+    std::vector<Record> records(kCount);
+    uint32_t seed = 12345;
+    for (uint32_t i = 0; i < kCount; i++) {
+        seed = seed * 1103515245 + 12345;
+        records[i].id = (uint16_t)i;
+        records[i].y = (int16_t)((int)((seed >> 16) % 200) - 100);
+        records[i].score = (int32_t)(seed >> 8) % 50 * 100000 - 2000000;
+    }
+    auto store = [&]() {
+        for (uint32_t i = 0; i < kCount; i++) {
+            uint8_t* ptr = &vgs.ctx.ram[0x30000 + i * kSize];
+            ptr[0] = records[i].id >> 8;
+            ptr[1] = records[i].id & 0xFF;
+            ptr[2] = (uint16_t)records[i].y >> 8;
+            ptr[3] = (uint16_t)records[i].y & 0xFF;
+            putBE32(ptr + 4, records[i].score);
+        }
+    };
+    auto verify = [&](const std::vector<Record>& expect) {
+        for (uint32_t i = 0; i < kCount; i++) {
+            const uint8_t* ptr = &vgs.ctx.ram[0x30000 + i * kSize];
+            if ((ptr[0] << 8 | ptr[1]) != expect[i].id || getBE32(ptr + 4) != expect[i].score) {
+                return false;
+            }
+        }
+        return true;
+    };
+    auto sort = [&](uint32_t offset, uint32_t flags) {
+        vgs.outPort(VGS_ADDR_DMA_DESTINATION, 0xF30000);
+        vgs.outPort(VGS_ADDR_DMA_SOURCE, kCount);
+        vgs.outPort(VGS_ADDR_DMA_ARGUMENT, VGS_DMA_SORT_LAYOUT(kSize, offset) | flags);
+        vgs.outPort(VGS_ADDR_DMA_EXECUTE, VGS_DMA_SORT);
+    };
+
+    // signed 16-bit ascending (stable)
+    store();
+    sort(2, VGS_DMA_SORT_KEY16 | VGS_DMA_SORT_SIGNED);
+    std::vector<Record> expect = records;
+    std::stable_sort(expect.begin(), expect.end(), [](const Record& a, const Record& b) { return a.y < b.y; });
+    if (!verify(expect)) {
+        return fail("DMA sort (signed 16-bit ascending) mismatch");
+    }
+
+    // signed 32-bit descending (stable)
+    store();
+    sort(4, VGS_DMA_SORT_KEY32 | VGS_DMA_SORT_SIGNED | VGS_DMA_SORT_DESCENDING);
+    expect = records;
+    std::stable_sort(expect.begin(), expect.end(), [](const Record& a, const Record& b) { return a.score > b.score; });
+    if (!verify(expect)) {
+        return fail("DMA sort (signed 32-bit descending) mismatch");
+    }
+
+    // unsigned 16-bit ascending on the id of the shuffled array restores the original order
+    sort(0, VGS_DMA_SORT_KEY16);
+    if (!verify(records)) {
+        return fail("DMA sort (unsigned 16-bit ascending) mismatch");
+    }
+
+    // key out of the record must be ignored
+    store();
+    sort(6, VGS_DMA_SORT_KEY32);
+    if (!verify(records)) {
+        return fail("DMA sort with an invalid layout must be ignored");
+    }
+    return 0;
+}
+
+static int test_vgm_register_burst(VGSX& vgs)
+{
+    // A register burst must be applied at its own time instead of one write per output sample
+    static std::vector<uint8_t> vgm;
+    for (int burst : {30, 3000}) {
+        vgm.assign(0x100, 0);
+        std::memcpy(&vgm[0x00], "Vgm ", 4);
+        const uint32_t version = 0x161;
+        const uint32_t clock = 7670453;
+        const uint32_t dataOffset = 0x100 - 0x34;
+        std::memcpy(&vgm[0x08], &version, 4);
+        std::memcpy(&vgm[0x2C], &clock, 4);
+        std::memcpy(&vgm[0x34], &dataOffset, 4);
+        for (int i = 0; i < burst; i++) {
+            const uint16_t freq = (uint16_t)((i * 37) & 0x3FFF);
+            vgm.insert(vgm.end(), {0x52, 0xA4, (uint8_t)(freq >> 8), 0x52, 0xA0, (uint8_t)(freq & 0xFF)});
+            vgm.insert(vgm.end(), {0x53, 0xA5, (uint8_t)(freq >> 8), 0x53, 0xA1, (uint8_t)(freq & 0xFF)});
+        }
+        vgm.insert(vgm.end(), {0x61, 0x00, 0x01, 0x66});
+        const uint16_t last = (uint16_t)(((burst - 1) * 37) & 0x3FFF);
+
+        vgs.ctx.vgmData[0].data = vgm.data();
+        vgs.ctx.vgmData[0].size = vgm.size();
+        vgs.outPort(VGS_ADDR_VGM_PLAY, 0);
+        int16_t buf[2];
+        vgs.tickSound(buf, 2);
+        if (vgs.inPort(VGS_ADDR_YM2612_FREQ0) != last || vgs.inPort(VGS_ADDR_YM2612_FREQ4) != last) {
+            std::fprintf(stderr, "burst=%d: freq0=0x%04X, freq4=0x%04X, expected=0x%04X\n", burst, vgs.inPort(VGS_ADDR_YM2612_FREQ0), vgs.inPort(VGS_ADDR_YM2612_FREQ4), last);
+            return fail("VGM register burst was not applied within one output sample");
+        }
+    }
+    vgs.ctx.vgmData[0].data = nullptr;
+    vgs.ctx.vgmData[0].size = 0;
+    return 0;
+}
+
+// compact: write the waits with 0x7n and mix in the ignored PSG/DAC stream commands (must render the same)
+static std::vector<uint8_t> makeToneVgm(bool compact = false)
+{
+    std::vector<uint8_t> vgm(0x100, 0);
+    std::memcpy(&vgm[0x00], "Vgm ", 4);
+    const uint32_t version = 0x161;
+    const uint32_t clock = 7670453;
+    const uint32_t dataOffset = 0x100 - 0x34;
+    std::memcpy(&vgm[0x08], &version, 4);
+    std::memcpy(&vgm[0x2C], &clock, 4);
+    std::memcpy(&vgm[0x34], &dataOffset, 4);
+    auto write = [&](uint8_t port, uint8_t reg, uint8_t data) { vgm.insert(vgm.end(), {(uint8_t)(0x52 + port), reg, data}); };
+    auto wait = [&](uint16_t n) {
+        if (!compact) {
+            vgm.insert(vgm.end(), {0x61, (uint8_t)(n & 0xFF), (uint8_t)(n >> 8)});
+            return;
+        }
+        vgm.insert(vgm.end(), {0x50, 0x9F, 0x94, 0x00});
+        for (; 16 < n; n -= 16) {
+            vgm.push_back(0x7F);
+        }
+        vgm.push_back((uint8_t)(0x70 + n - 1));
+    };
+    for (uint8_t port = 0; port < 2; port++) {
+        write(port, 0xB0, 0x32);
+        write(port, 0xB4, port ? 0x80 : 0xC0);
+        for (uint8_t op = 0; op < 4; op++) {
+            write(port, 0x30 + op * 4, 0x01 + op);
+            write(port, 0x40 + op * 4, op == 3 ? 0x08 : 0x20);
+            write(port, 0x50 + op * 4, 0x1F);
+            write(port, 0x60 + op * 4, 0x05);
+            write(port, 0x70 + op * 4, 0x02);
+            write(port, 0x80 + op * 4, 0x36);
+        }
+        write(port, 0xA4, 0x22);
+        write(port, 0xA0, 0x69);
+    }
+    write(0, 0x28, 0xF0);
+    write(0, 0x28, 0xF4);
+    wait(100);
+    write(0, 0xA4, 0x1A);
+    write(0, 0xA0, 0x8F);
+    wait(333);
+    write(0, 0x28, 0x00);
+    wait(501);
+    write(1, 0xA4, 0x2C);
+    write(1, 0xA0, 0x10);
+    write(0, 0x28, 0xF4);
+    vgm.insert(vgm.end(), {0x62});
+    write(0, 0x28, 0x04);
+    vgm.insert(vgm.end(), {0x66});
+    return vgm;
+}
+
+static int test_vgm_block_render_tolerance(VGSX& vgs)
+{
+    // Every 23rd sample of the per-sample renderer (4 x 735 stereo frames, subtle analog preset)
+    static const int16_t kReference[] = {
+        1578, -354, -7229, 4348, 2175, 2692, -2415, -558, -590, 1820, 1749, -2523, -5833, 460, 4102, -2708,
+        -2539, -438, 6924, 3861, 1719, -3278, 1135, -1498, -3227, -3092, 161, 4467, -1477, -417, 2888, 4196,
+        -2354, -4085, 2923, 632, 3488, -609, 2860, 3266, -50, -3464, 1328, -756, -1522, -3591, -33, 4369,
+        -213, 417, -1556, 2654, -4853, -3702, -2957, 3217, 993, 2172, -3569, 1688, 7564, -840, -3425, -965,
+        3463, -293, 1573, 3103, -75, -3919, -1632, 321, -3469, -3768, -6342, 2305, 4994, 2720, -4773, 77,
+        4670, -2367, -4661, -1833, 5130, 3907, 4258, -95, 1098, 3509, 243, -3595, -2261, 130, -2380, 1112,
+        3075, 79, -4166, -2224, -2025, -2384, -4366, -1948, 4262, 3749, 1350, -2558, 3843, 835, -1357, -3804,
+        -1155, 3429, 3280, 1687, 2831, 3099, 2564, -2719, -5985, -776, 520, 163, 845, 3650, -2761, -3723,
+        77, -1105, -1952, -3431, -815, 3508, 5662, 1090, -755, 3036, -2648, -2529, -1402, -425, 1438, 3602,
+    };
+    constexpr int64_t kReferenceEnergy = 40341580638LL;
+    constexpr int kTolerance = 2;
+
+    static std::vector<uint8_t> vgm = makeToneVgm();
+    vgs.ctx.vgmData[0].data = vgm.data();
+    vgs.ctx.vgmData[0].size = vgm.size();
+    vgs.outPort(VGS_ADDR_VGM_PLAY, 0);
+    std::vector<int16_t> out;
+    int16_t buf[735 * 2];
+    for (int i = 0; i < 4; i++) {
+        vgs.tickSound(buf, 735 * 2);
+        out.insert(out.end(), buf, buf + 735 * 2);
+    }
+    vgs.ctx.vgmData[0].data = nullptr;
+    vgs.ctx.vgmData[0].size = 0;
+
+    for (size_t i = 0; i < sizeof(kReference) / sizeof(kReference[0]); i++) {
+        const int diff = out[i * 23] - kReference[i];
+        if (diff < -kTolerance || kTolerance < diff) {
+            std::fprintf(stderr, "sample[%zu]: %d (expected %d)\n", i * 23, out[i * 23], kReference[i]);
+            return fail("VGM block renderer differs from the reference");
+        }
+    }
+    int64_t energy = 0;
+    for (int16_t w : out) {
+        energy += (int64_t)w * w;
+    }
+    if (std::llabs(energy - kReferenceEnergy) > kReferenceEnergy / 1000) {
+        std::fprintf(stderr, "energy: %lld (expected %lld)\n", (long long)energy, (long long)kReferenceEnergy);
+        return fail("VGM block renderer energy differs from the reference");
+    }
+    return 0;
+}
+
+static int test_vgm_analog_presets(VGSX& vgs)
+{
+    // Every 61st sample and the energy of the per-sample post-processing for each analog preset
+    struct Reference {
+        const char* name;
+        void (VGSX::*use)();
+        int64_t energy;
+        int16_t samples[48];
+    };
+    static const Reference kReferences[] = {
+        {"Clean",
+         &VGSX::useYm2612AnalogCleanPreset,
+         47789543354LL,
+         {
+             4492, 3736, 8301, -512, -4117, 1506, -2784, 4213, -2266, -3332, 5538, -986, -2237, 661, -2310, -3591,
+             -1825, -2965, -911, 3815, -3351, 4154, -4398, -2433, 2287, 1388, -4540, -1019, -832, 2529, 7323, -3696,
+             450, 1268, -4177, -15, 747, -3872, 1734, 1551, -1107, 1514, -111, 3267, -1352, -4294, -1034, 3575,
+         }},
+        {"Subtle",
+         &VGSX::useYm2612AnalogSubtlePreset,
+         40341542958LL,
+         {
+             1578, 2017, 7847, 7, -3246, 1179, -1854, 4554, -1675, -3249, 5007, -682, -236, 474, -3261, -2485,
+             -754, -3431, -492, 2258, -3833, 4370, -4407, -840, 328, 1040, -3935, -639, -3398, 2871, 7439, -3834,
+             2695, 950, -1784, -20, 834, -3927, -123, 355, 510, 2354, -806, 3696, 257, -3957, 520, 3269,
+         }},
+        {"Real",
+         &VGSX::useYm2612AnalogRealPreset,
+         39391168096LL,
+         {
+             2475, 2952, 7978, -227, -3519, 1375, -1977, 4105, -1890, -3082, 5206, -740, -1222, 682, -2559, -2917,
+             -1273, -3018, -787, 3175, -3238, 4012, -4177, -1592, 1446, 1232, -3962, -812, -1966, 2505, 7183, -3548,
+             1354, 1122, -2620, 37, 251, -3642, 738, 909, -82, 1766, -84, 3261, -604, -3874, -213, 3286,
+         }},
+        {"Re1e",
+         &VGSX::useYm2612AnalogRe1ePreset,
+         47780973750LL,
+         {
+             4485, 3735, 8301, -512, -4117, 1506, -2782, 4213, -2266, -3332, 5538, -986, -2236, 661, -2311, -3591,
+             -1824, -2966, -911, 3815, -3351, 4154, -4398, -2432, 2286, 1387, -4540, -1019, -834, 2529, 7324, -3696,
+             452, 1267, -4174, -15, 744, -3872, 1732, 1550, -1104, 1514, -110, 3268, -1351, -4294, -1033, 3574,
+         }},
+        {"Warm",
+         &VGSX::useYm2612AnalogWarmPreset,
+         38678284051LL,
+         {
+             1288, 1472, 7328, 52, -2927, 955, -1973, 4643, -1510, -3236, 4599, -628, 251, 258, -3350, -2155,
+             -574, -3502, -227, 1694, -4071, 4398, -4297, -466, -253, 888, -3811, -546, -3879, 3029, 7043, -3829,
+             3145, 825, -1553, -96, 1106, -3933, -387, 116, 767, 2509, -1280, 3826, 543, -3842, 605, 3147,
+         }},
+        {"Legacy",
+         nullptr,
+         47789543354LL,
+         {
+             4492, 3736, 8301, -512, -4117, 1506, -2784, 4213, -2266, -3332, 5538, -986, -2237, 661, -2310, -3591,
+             -1825, -2965, -911, 3815, -3351, 4154, -4398, -2433, 2287, 1388, -4540, -1019, -832, 2529, 7323, -3696,
+             450, 1268, -4177, -15, 747, -3872, 1734, 1551, -1107, 1514, -111, 3267, -1352, -4294, -1034, 3575,
+         }},
+    };
+    constexpr int kTolerance = 2;
+
+    static std::vector<uint8_t> vgm = makeToneVgm();
+    for (const auto& ref : kReferences) {
+        if (ref.use) {
+            (vgs.*ref.use)();
+        } else {
+            vgs.setYm2612AnalogEnabled(false);
+        }
+        vgs.ctx.vgmData[0].data = vgm.data();
+        vgs.ctx.vgmData[0].size = vgm.size();
+        vgs.outPort(VGS_ADDR_VGM_PLAY, 0);
+        std::vector<int16_t> out;
+        int16_t buf[735 * 2];
+        for (int i = 0; i < 4; i++) {
+            vgs.tickSound(buf, 735 * 2);
+            out.insert(out.end(), buf, buf + 735 * 2);
+        }
+        for (int i = 0; i < 48; i++) {
+            const int diff = out[i * 61] - ref.samples[i];
+            if (diff < -kTolerance || kTolerance < diff) {
+                std::fprintf(stderr, "%s: sample[%d]: %d (expected %d)\n", ref.name, i * 61, out[i * 61], ref.samples[i]);
+                return fail("YM2612 analog post-processing differs from the reference");
+            }
+        }
+        int64_t energy = 0;
+        for (int16_t w : out) {
+            energy += (int64_t)w * w;
+        }
+        if (std::llabs(energy - ref.energy) > ref.energy / 1000) {
+            std::fprintf(stderr, "%s: energy: %lld (expected %lld)\n", ref.name, (long long)energy, (long long)ref.energy);
+            return fail("YM2612 analog post-processing energy differs from the reference");
+        }
+    }
+    vgs.useYm2612AnalogSubtlePreset();
+    vgs.ctx.vgmData[0].data = nullptr;
+    vgs.ctx.vgmData[0].size = 0;
+    return 0;
+}
+
+static int test_vgm_compile(VGSX& vgs)
+{
+    auto render = [&](uint16_t index, int frames) {
+        std::vector<int16_t> out;
+        int16_t buf[735 * 2];
+        vgs.outPort(VGS_ADDR_VGM_PLAY, index);
+        for (int i = 0; i < frames; i++) {
+            vgs.tickSound(buf, 735 * 2);
+            out.insert(out.end(), buf, buf + 735 * 2);
+        }
+        return out;
+    };
+    auto silent = [](const std::vector<int16_t>& out, size_t from) {
+        for (size_t i = from; i < out.size(); i++) {
+            if (out[i]) {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    // the short waits and the ignored commands must compile to the same events
+    static std::vector<uint8_t> tone = makeToneVgm();
+    static std::vector<uint8_t> compact = makeToneVgm(true);
+    vgs.loadVgm(0, tone.data(), tone.size());
+    vgs.loadVgm(1, compact.data(), compact.size());
+    if (render(0, 4) != render(1, 4)) {
+        return fail("VGM with 0x7n waits and ignored commands renders differently");
+    }
+
+    // the loop point (the last key-on) is resolved at load time (the song ends within 3 frames without the loop)
+    static std::vector<uint8_t> looped = makeToneVgm();
+    const uint32_t loopOffset = (uint32_t)(looped.size() - 8 - 0x1C);
+    looped.insert(looped.end() - 1, {0x62});
+    std::memcpy(&looped[0x1C], &loopOffset, 4);
+    vgs.loadVgm(2, looped.data(), looped.size());
+    if (silent(render(2, 8), 6 * 735 * 2)) {
+        return fail("Looped VGM stopped");
+    }
+    if (!silent(render(0, 4), 3 * 735 * 2)) {
+        return fail("Non looped VGM did not stop");
+    }
+
+    // an unsupported command fails at load time and plays nothing
+    static std::vector<uint8_t> broken = makeToneVgm();
+    broken.insert(broken.begin() + 0x100, {0x30, 0x00});
+    vgs.loadVgm(3, broken.data(), broken.size());
+    if (!silent(render(3, 1), 0)) {
+        return fail("VGM with an unsupported command was played");
+    }
+
+    // a truncated command must not read beyond the data
+    static std::vector<uint8_t> truncated = makeToneVgm();
+    truncated.resize(truncated.size() - 2);
+    truncated.back() = 0x61;
+    vgs.loadVgm(4, truncated.data(), truncated.size());
+    if (!silent(render(4, 1), 0)) {
+        return fail("Truncated VGM was played");
+    }
+
+    for (uint16_t i = 0; i < 5; i++) {
+        vgs.ctx.vgmData[i].data = nullptr;
+        vgs.ctx.vgmData[i].size = 0;
+    }
+    return 0;
+}
+
+static int test_audio_stats(VGSX& vgs)
+{
+    // a burst beyond the YM2612 write queue capacity is counted as overflows
+    static std::vector<uint8_t> vgm = makeToneVgm();
+    vgm.pop_back();
+    for (int i = 0; i < 1500; i++) {
+        vgm.insert(vgm.end(), {0x52, 0xA0, (uint8_t)i});
+    }
+    vgm.insert(vgm.end(), {0x62, 0x66});
+    vgs.resetAudioStats();
+    vgs.ctx.vgmData[0].data = vgm.data();
+    vgs.ctx.vgmData[0].size = vgm.size();
+    vgs.outPort(VGS_ADDR_VGM_PLAY, 0);
+    int16_t buf[735 * 2];
+    for (int i = 0; i < 4; i++) {
+        vgs.tickSound(buf, 735 * 2);
+    }
+    vgs.reportAudioDevice(735 * 2 * 3, 1, 0);
+    vgs.reportAudioDevice(735 * 2, 0, 2);
+
+    auto stats = vgs.getAudioStats();
+    uint32_t histogram = 0;
+    for (uint32_t n : stats.renderHistogram) {
+        histogram += n;
+    }
+    if (stats.calls != 4 || histogram != 4 || stats.producedSamples != 735 * 2 * 4 || stats.consumedSamples != 735 * 2 * 4) {
+        return fail("Audio render statistics mismatch");
+    }
+    if (stats.maxRenderNanos == 0 || stats.totalRenderNanos < stats.maxRenderNanos || stats.underruns != 1 || stats.overruns != 2) {
+        return fail("Audio timing statistics mismatch");
+    }
+    if (stats.ym2612QueuePeak != 1024 || stats.ym2612QueueOverflows == 0) {
+        std::fprintf(stderr, "peak=%u, overflows=%u\n", stats.ym2612QueuePeak, stats.ym2612QueueOverflows);
+        return fail("YM2612 write queue statistics mismatch");
+    }
+    vgs.resetAudioStats();
+    stats = vgs.getAudioStats();
+    if (stats.calls || stats.producedSamples || stats.renderHistogram[0] || stats.ym2612QueuePeak) {
+        return fail("Audio statistics were not reset");
+    }
+    vgs.ctx.vgmData[0].data = nullptr;
+    vgs.ctx.vgmData[0].size = 0;
+    return 0;
+}
+
+static int test_vgm_seek(VGSX& vgs)
+{
+    // 24 notes of 12352 samples (the loop starts from the 4th note)
+    static std::vector<uint8_t> vgm = makeToneVgm();
+    vgm.resize(vgm.size() - 1);
+    const uint32_t intro = 100 + 333 + 501 + 735;
+    const uint32_t loopOffset = (uint32_t)(vgm.size() + 3 * 21 - 0x1C);
+    std::memcpy(&vgm[0x1C], &loopOffset, 4);
+    for (int i = 0; i < 24; i++) {
+        const uint16_t freq = (uint16_t)(0x2000 + i * 0x30);
+        vgm.insert(vgm.end(), {0x52, 0xA4, (uint8_t)(freq >> 8), 0x52, 0xA0, (uint8_t)(freq & 0xFF), 0x52, 0x28, 0xF0});
+        vgm.insert(vgm.end(), {0x61, 0x40, 0x1F, 0x52, 0x28, 0x00, 0x61, 0xD0, 0x07});
+        vgm.insert(vgm.end(), {0x62, 0x62, 0x63});
+    }
+    vgm.push_back(0x66);
+    const uint32_t noteLength = 8000 + 2000 + 735 * 2 + 882;
+    const uint32_t length = intro + 24 * noteLength;
+    const uint32_t loopPosition = intro + 3 * noteLength;
+    vgs.loadVgm(0, vgm.data(), vgm.size());
+
+    int16_t buf[735 * 2];
+    auto nonSilent = [&]() {
+        vgs.tickSound(buf, 735 * 2);
+        for (int16_t w : buf) {
+            if (w) {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    // render from the beginning to the position and compare with the seek
+    const uint32_t position = intro + 13 * noteLength + 5000;
+    vgs.outPort(VGS_ADDR_VGM_PLAY, 0);
+    if (vgs.inPort(VGS_ADDR_VGM_LENGTH) != length || vgs.inPort(VGS_ADDR_VGM_LOOP_POSITION) != loopPosition) {
+        std::fprintf(stderr, "length=%u, loop=%u\n", vgs.inPort(VGS_ADDR_VGM_LENGTH), vgs.inPort(VGS_ADDR_VGM_LOOP_POSITION));
+        return fail("Unexpected VGM length or loop position");
+    }
+    std::vector<int16_t> skip((size_t)position * 2);
+    vgs.tickSound(skip.data(), (int)skip.size());
+    const uint32_t rendered = vgs.inPort(VGS_ADDR_YM2612_FREQ0);
+    if (vgs.inPort(VGS_ADDR_VGM_POSITION) != position) {
+        return fail("VGM position differs from the rendered samples");
+    }
+    vgs.outPort(VGS_ADDR_VGM_PLAY, 0);
+    vgs.outPort(VGS_ADDR_VGM_POSITION, position);
+    if (vgs.inPort(VGS_ADDR_VGM_POSITION) != position || vgs.inPort(VGS_ADDR_YM2612_FREQ0) != rendered) {
+        return fail("VGM seek did not restore the register state");
+    }
+    if (!nonSilent() || vgs.getVgmPosition() != position + 735) {
+        return fail("VGM seek did not resume the playing note");
+    }
+
+    // the end of the song wraps to the loop point both by seeking and by playing
+    vgs.seekVgm(length + 100);
+    if (vgs.getVgmPosition() != loopPosition + 100) {
+        return fail("VGM seek beyond the end did not wrap to the loop point");
+    }
+    vgs.seekVgm(length - 100);
+    vgs.tickSound(buf, 735 * 2);
+    if (vgs.getVgmPosition() != loopPosition + 635) {
+        std::fprintf(stderr, "position=%u (expected %u)\n", vgs.getVgmPosition(), loopPosition + 635);
+        return fail("VGM loop did not reset the position");
+    }
+
+    // seeking keeps the channel mutes set by the program (the note is keyed on for 9 frames after the position)
+    vgs.outPort(VGS_ADDR_YM2612_MUTE0, 1);
+    vgs.outPort(VGS_ADDR_YM2612_MUTE3, 1);
+    vgs.seekVgm(intro + 13 * noteLength + 1000);
+    if (1 != vgs.inPort(VGS_ADDR_YM2612_MUTE0) || 1 != vgs.inPort(VGS_ADDR_YM2612_MUTE3) || 0 != vgs.inPort(VGS_ADDR_YM2612_MUTE1)) {
+        return fail("VGM seek cleared the channel mutes");
+    }
+    for (int i = 0; i < 4; i++) {
+        vgs.tickSound(buf, 735 * 2); // the filters restarted by the seek settle
+    }
+    if (nonSilent()) {
+        return fail("VGM seek unmuted the channel in the synthesizer");
+    }
+    vgs.outPort(VGS_ADDR_YM2612_MUTE0, 0);
+    vgs.outPort(VGS_ADDR_YM2612_MUTE3, 0);
+
+    vgs.ctx.vgmData[0].data = nullptr;
+    vgs.ctx.vgmData[0].size = 0;
+    return 0;
+}
+
+static int test_sfx_mixer(VGSX& vgs)
+{
+    static const int16_t kQuiet[8] = {1000, -1000, 1000, -1000, 1000, -1000, 1000, -1000};
+    static const int16_t kLoud[8] = {20000, 20000, 20000, 20000, 20000, 20000, 20000, 20000};
+    static const int16_t kNegative[8] = {-15000, -15000, -15000, -15000, -15000, -15000, -15000, -15000};
+    vgs.ctx.vgmPause = true;
+    vgs.ctx.sfxData[1].data = kQuiet;
+    vgs.ctx.sfxData[1].count = 8;
+    vgs.ctx.sfxData[2].data = kLoud;
+    vgs.ctx.sfxData[2].count = 8;
+    vgs.ctx.sfxData[3].data = kLoud;
+    vgs.ctx.sfxData[3].count = 8;
+    vgs.ctx.sfxData[4].data = kNegative;
+    vgs.ctx.sfxData[4].count = 4;
+    for (int i = 1; i <= 4; i++) {
+        vgs.ctx.sfxData[i].format = VGSX::SfxFormat::PCM16;
+        vgs.ctx.sfxData[i].channels = 2;
+        vgs.ctx.sfxData[i].step = 1;
+        vgs.ctx.sfxData[i].frames = (uint32_t)vgs.ctx.sfxData[i].count / 2;
+    }
+    int16_t buf[8];
+
+    // per-voice volume and pan (50% hard left)
+    vgs.outPort(VGS_ADDR_SFX_VOLUME, (1 << 16) | 128);
+    vgs.outPort(VGS_ADDR_SFX_PAN, (1 << 16) | VGS_SFX_PAN_LEFT);
+    vgs.outPort(VGS_ADDR_SFX_PLAY, 1);
+    vgs.tickSound(buf, 4);
+    if (buf[0] != 500 || buf[1] != 0 || buf[2] != 500 || buf[3] != 0) {
+        std::fprintf(stderr, "%d, %d, %d, %d\n", buf[0], buf[1], buf[2], buf[3]);
+        return fail("SFX volume/pan was not applied");
+    }
+    vgs.outPort(VGS_ADDR_SFX_STOP, 1);
+    if (vgs.ctx.sfxActiveCount != 0 || vgs.ctx.sfxData[1].play) {
+        return fail("SFX stop did not remove the voice from the active list");
+    }
+
+    // overlapping voices are summed in 32 bits and clamped once
+    vgs.outPort(VGS_ADDR_SFX_PLAY, 2);
+    vgs.outPort(VGS_ADDR_SFX_PLAY, 3);
+    vgs.outPort(VGS_ADDR_SFX_PLAY, 4);
+    vgs.outPort(VGS_ADDR_SFX_PLAY, 4); // restart must not add a second entry
+    if (vgs.ctx.sfxActiveCount != 3) {
+        return fail("SFX active list has an unexpected size");
+    }
+    vgs.tickSound(buf, 8);
+    if (buf[0] != 25000 || buf[3] != 25000 || buf[4] != 32767 || buf[7] != 32767) {
+        std::fprintf(stderr, "%d, %d, %d, %d\n", buf[0], buf[3], buf[4], buf[7]);
+        return fail("SFX voices were not mixed with a single clamp");
+    }
+    if (vgs.ctx.sfxActiveCount != 0 || vgs.ctx.sfxData[2].play || vgs.ctx.sfxData[3].play || vgs.ctx.sfxData[4].play) {
+        return fail("finished SFX voices were not removed from the active list");
+    }
+
+    vgs.outPort(VGS_ADDR_SFX_VOLUME, (1 << 16) | 255);
+    vgs.outPort(VGS_ADDR_SFX_PAN, (1 << 16) | VGS_SFX_PAN_CENTER);
+    for (int i = 1; i <= 4; i++) {
+        vgs.ctx.sfxData[i].data = nullptr;
+        vgs.ctx.sfxData[i].count = 0;
+    }
+    vgs.ctx.vgmPause = false;
+    return 0;
+}
+
+static std::vector<uint8_t> makeWav(uint16_t format, uint16_t channels, uint32_t rate, uint16_t bits, uint16_t blockAlign, const std::vector<uint8_t>& data)
+{
+    std::vector<uint8_t> wav;
+    auto put16 = [&](uint32_t v) { wav.insert(wav.end(), {(uint8_t)v, (uint8_t)(v >> 8)}); };
+    auto put32 = [&](uint32_t v) { put16(v & 0xFFFF); put16(v >> 16); };
+    const bool adpcm = format == 0x0011;
+    wav.insert(wav.end(), {'R', 'I', 'F', 'F'});
+    put32(0); // fill later
+    wav.insert(wav.end(), {'W', 'A', 'V', 'E', 'f', 'm', 't', ' '});
+    put32(adpcm ? 20 : 16);
+    put16(format);
+    put16(channels);
+    put32(rate);
+    put32(rate * blockAlign);
+    put16(blockAlign);
+    put16(bits);
+    if (adpcm) {
+        put16(2);
+        put16((blockAlign - 4 * channels) * 8 / (4 * channels) + 1);
+    }
+    wav.insert(wav.end(), {'d', 'a', 't', 'a'});
+    put32((uint32_t)data.size());
+    wav.insert(wav.end(), data.begin(), data.end());
+    const uint32_t riff = (uint32_t)wav.size() - 8;
+    std::memcpy(&wav[4], &riff, 4);
+    return wav;
+}
+
+static int test_sfx_formats(VGSX& vgs)
+{
+    vgs.ctx.vgmPause = true;
+    int16_t buf[20];
+
+    // 22050Hz monaural PCM: interpolated to 44100Hz and copied to both channels
+    static std::vector<uint8_t> mono;
+    mono = makeWav(0x0001, 1, 22050, 16, 2, {0x00, 0x00, 0xE8, 0x03, 0xD0, 0x07, 0xB8, 0x0B}); // 0, 1000, 2000, 3000
+    if (!vgs.loadWav(5, mono.data(), mono.size()) || vgs.ctx.sfxData[5].count != 16) {
+        return fail("failed to load a 22050Hz monaural wav");
+    }
+    vgs.outPort(VGS_ADDR_SFX_PLAY, 5);
+    vgs.tickSound(buf, 20);
+    static const int16_t kMono[20] = {0, 0, 500, 500, 1000, 1000, 1500, 1500, 2000, 2000, 2500, 2500, 3000, 3000, 3000, 3000, 0, 0, 0, 0};
+    if (0 != std::memcmp(buf, kMono, sizeof(kMono))) {
+        return fail("22050Hz monaural wav was not converted correctly");
+    }
+
+    // IMA-ADPCM stereo: 16 bytes block = 4 bytes header x 2ch + 8 samples x 2ch
+    static std::vector<uint8_t> adpcm;
+    adpcm = makeWav(0x0011, 2, 44100, 4, 16, {100, 0, 0, 0, 0x9C, 0xFF, 0, 0, 0x44, 0x44, 0x44, 0x44, 0xCC, 0xCC, 0xCC, 0xCC});
+    if (!vgs.loadWav(6, adpcm.data(), adpcm.size()) || vgs.ctx.sfxData[6].count != 18) {
+        return fail("failed to load an IMA-ADPCM wav");
+    }
+    vgs.outPort(VGS_ADDR_SFX_PLAY, 6);
+    vgs.tickSound(buf, 20);
+    static const int16_t kAdpcm[20] = {100, -100, 107, -107, 117, -117, 129, -129, 143, -143, 161, -161, 182, -182, 207, -207, 238, -238, 0, 0};
+    if (0 != std::memcmp(buf, kAdpcm, sizeof(kAdpcm))) {
+        for (int i = 0; i < 20; i++) {
+            std::fprintf(stderr, "%d, ", buf[i]);
+        }
+        std::fprintf(stderr, "\n");
+        return fail("IMA-ADPCM wav was not decoded correctly");
+    }
+
+    // unsupported sampling rate
+    static std::vector<uint8_t> invalid;
+    invalid = makeWav(0x0001, 2, 4000, 16, 4, {0, 0, 0, 0});
+    if (vgs.loadWav(7, invalid.data(), invalid.size())) {
+        return fail("4000Hz wav must be rejected");
+    }
+
+    for (int i = 5; i <= 6; i++) {
+        vgs.ctx.sfxData[i].data = nullptr;
+        vgs.ctx.sfxData[i].count = 0;
+    }
+    vgs.ctx.vgmPause = false;
+    return 0;
+}
+
+static int test_sample_rate(VGSX& vgs)
+{
+    vgs.ctx.vgmPause = true;
+    auto constant = [](int frames, int channels, int16_t value) {
+        std::vector<uint8_t> data;
+        for (int i = 0; i < frames * channels; i++) {
+            data.insert(data.end(), {(uint8_t)value, (uint8_t)(value >> 8)});
+        }
+        return data;
+    };
+    auto flat = [&](uint8_t n, int16_t expected) {
+        int16_t buf[400];
+        vgs.outPort(VGS_ADDR_SFX_PLAY, n);
+        vgs.tickSound(buf, 400);
+        vgs.outPort(VGS_ADDR_SFX_STOP, n);
+        for (int i = 100; i < 300; i++) {
+            if (std::abs(buf[i] - expected) > 2) {
+                std::fprintf(stderr, "sample[%d]: %d (expected %d)\n", i, buf[i], expected);
+                return false;
+            }
+        }
+        return true;
+    };
+
+    // a 48000Hz SFX is resampled while mixing for the 44100Hz output
+    static std::vector<uint8_t> wav48k;
+    static std::vector<uint8_t> wav22k;
+    wav48k = makeWav(0x0001, 2, 48000, 16, 4, constant(480, 2, 1000));
+    wav22k = makeWav(0x0001, 1, 22050, 16, 2, constant(441, 1, -2000));
+    if (!vgs.loadWav(8, wav48k.data(), wav48k.size()) || vgs.ctx.sfxData[8].count != 441 * 2 || !vgs.ctx.sfxData[8].resample) {
+        return fail("failed to load a 48000Hz wav");
+    }
+    if (!vgs.loadWav(9, wav22k.data(), wav22k.size()) || vgs.ctx.sfxData[9].resample) {
+        return fail("22050Hz wav must be decoded while mixing at 44100Hz");
+    }
+    if (!flat(8, 1000)) {
+        return fail("48000Hz wav was not resampled correctly");
+    }
+
+    // 48000Hz output: the SFX are resampled from the source with the filters of the new rate and the VGM follows it
+    vgs.setSampleRate(48000);
+    if (vgs.ctx.sfxData[8].count != 480 * 2 || vgs.ctx.sfxData[9].count != 960 * 2) {
+        return fail("SFX were not resampled for the 48000Hz output");
+    }
+    if (!flat(8, 1000) || !flat(9, -2000)) {
+        return fail("SFX were not played correctly at 48000Hz");
+    }
+    static std::vector<uint8_t> vgm = makeToneVgm();
+    vgs.ctx.vgmData[0].data = vgm.data();
+    vgs.ctx.vgmData[0].size = vgm.size();
+    vgs.ctx.vgmPause = false;
+    vgs.outPort(VGS_ADDR_VGM_PLAY, 0);
+    std::vector<int16_t> pcm(1000 * 2);
+    vgs.tickSound(pcm.data(), (int)pcm.size());
+    if (vgs.getVgmPosition() != 918) {
+        std::fprintf(stderr, "position=%u\n", vgs.getVgmPosition());
+        return fail("VGM position must be counted in 44100Hz samples at 48000Hz");
+    }
+    if (pcm[pcm.size() - 1] == 0 && pcm[pcm.size() - 2] == 0) {
+        return fail("VGM was not rendered at 48000Hz");
+    }
+
+    vgs.setSampleRate(44100);
+    if (vgs.ctx.sfxData[8].count != 441 * 2 || vgs.ctx.sfxData[9].resample || vgs.ctx.sfxData[9].count != 441 * 2 * 2) {
+        return fail("SFX were not restored for the 44100Hz output");
+    }
+    for (int i = 8; i <= 9; i++) {
+        vgs.ctx.sfxData[i].data = nullptr;
+        vgs.ctx.sfxData[i].count = 0;
+    }
+    vgs.ctx.vgmData[0].data = nullptr;
+    vgs.ctx.vgmData[0].size = 0;
+    return 0;
+}
+
+static int test_save_state(VGSX& vgs)
+{
+    // BGM, a SFX decoded while mixing, WRAM and a character pattern transferred from WRAM
+    static std::vector<uint8_t> vgm = makeToneVgm();
+    static std::vector<uint8_t> wav;
+    std::vector<uint8_t> ramp;
+    for (int i = 0; i < 4410; i++) {
+        const int16_t value = (int16_t)((i * 37) % 20000 - 10000);
+        ramp.insert(ramp.end(), {(uint8_t)value, (uint8_t)(value >> 8)});
+    }
+    wav = makeWav(0x0001, 1, 22050, 16, 2, ramp);
+    vgs.ctx.vgmData[0].data = vgm.data();
+    vgs.ctx.vgmData[0].size = vgm.size();
+    if (!vgs.loadWav(10, wav.data(), wav.size())) {
+        return fail("failed to load a wav for the save state test");
+    }
+    vgs.outPort(VGS_ADDR_VGM_PLAY, 0);
+    vgs.outPort(VGS_ADDR_SFX_PLAY, 10);
+    for (int i = 0; i < 32; i++) {
+        vgs.ctx.ram[0x1000 + i] = (uint8_t)(0x11 * (i + 1));
+    }
+    vgs.vdp.write(0xD20000 + 38 * 4, 0xF01000); // tr_addr
+    vgs.vdp.write(0xD20000 + 39 * 4, 32);       // tr_size
+    vgs.vdp.write(0xD20000 + 40 * 4, 100);      // tr_to
+    vgs.vdp.ctx.nametbl[1][5] = 0x12345678;
+    std::vector<int16_t> pcm(1000 * 2);
+    vgs.tickSound(pcm.data(), (int)pcm.size());
+
+    std::vector<uint8_t> state;
+    vgs.saveState(state);
+    if (state.size() < sizeof(vgs.ctx.ram) || (4 << 20) < state.size()) {
+        std::fprintf(stderr, "state size=%d\n", (int)state.size());
+        return fail("unexpected save state size");
+    }
+    std::vector<int16_t> expected(3000 * 2);
+    vgs.tickSound(expected.data(), (int)expected.size());
+
+    // modify the machine and restore
+    vgs.ctx.ram[0x1000] = 0;
+    vgs.vdp.ctx.nametbl[1][5] = 0;
+    vgs.vdp.write(0xD20000 + 36 * 4, 100); // cp_fr
+    vgs.vdp.write(0xD20000 + 37 * 4, 200); // cp_to
+    vgs.outPort(VGS_ADDR_SFX_STOP, 10);
+    vgs.seekVgm(100);
+    if (vgs.loadState(state.data(), state.size() - 1)) {
+        return fail("a truncated state must be rejected");
+    }
+    if (vgs.ctx.ram[0x1000] != 0) {
+        return fail("a rejected state must not modify the machine");
+    }
+    if (!vgs.loadState(state.data(), state.size())) {
+        return fail(vgs.getLastError());
+    }
+    if (vgs.ctx.ram[0x1000] != 0x11 || vgs.vdp.ctx.nametbl[1][5] != 0x12345678) {
+        return fail("WRAM or the name table was not restored");
+    }
+    if (vgs.vdp.ctx.ptn[100][31] != 0x11 * 32 % 256 || vgs.vdp.ctx.ptn[200][0] != 0) {
+        return fail("character patterns were not restored");
+    }
+    std::vector<int16_t> actual(3000 * 2);
+    vgs.tickSound(actual.data(), (int)actual.size());
+    if (actual != expected) {
+        return fail("the sound after restoring differs from the sound after saving");
+    }
+
+    // a restored machine serializes to the same state
+    std::vector<uint8_t> again;
+    vgs.loadState(state.data(), state.size());
+    vgs.saveState(again);
+    if (again != state) {
+        return fail("the state changed by a save/restore round trip");
+    }
+    again[0] = 'X';
+    if (vgs.loadState(again.data(), again.size())) {
+        return fail("a state with a wrong magic must be rejected");
+    }
+
+    // a state is bound to the program it was saved with, even if another program has the same size
+    static std::vector<uint8_t> elfA = makeElf({0x4E71, 0x60FC}); // nop; bra.s -4
+    static std::vector<uint8_t> elfB = makeElf({0x4E75, 0x60FC}); // rts; bra.s -4
+    if (!vgs.loadProgram(elfA.data(), elfA.size())) {
+        return fail(vgs.getLastError());
+    }
+    vgs.saveState(again);
+    if (!vgs.loadProgram(elfB.data(), elfB.size())) {
+        return fail(vgs.getLastError());
+    }
+    if (vgs.loadState(again.data(), again.size())) {
+        return fail("a state saved with another program of the same size must be rejected");
+    }
+    if (!vgs.loadProgram(elfA.data(), elfA.size()) || !vgs.loadState(again.data(), again.size())) {
+        return fail("a state saved with the loaded program must be accepted");
+    }
+
+    vgs.outPort(VGS_ADDR_SFX_STOP, 10);
+    vgs.ctx.sfxData[10].data = nullptr;
+    vgs.ctx.sfxData[10].count = 0;
+    vgs.ctx.vgmPause = true;
+    vgs.ctx.vgmData[0].data = nullptr;
+    vgs.ctx.vgmData[0].size = 0;
+    return 0;
+}
+
+static int test_rewind(VGSX& vgs)
+{
+    // count the frames in WRAM and copy the count to the name table every frame
+    static std::vector<uint8_t> elf = makeElf({
+        0x52B9, 0x00F0, 0x0100,                 // addq.l #1, ($F00100).l
+        0x23F9, 0x00F0, 0x0100, 0x00C0, 0x0010, // move.l ($F00100).l, ($C00010).l
+        0x4AB9, 0x00E0, 0x0000,                 // tst.l ($E00000).l (V-SYNC)
+        0x60E8,                                 // bra.s loop
+    });
+    if (!vgs.loadProgram(elf.data(), elf.size())) {
+        return fail(vgs.getLastError());
+    }
+    auto counter = [&]() {
+        return (uint32_t)vgs.ctx.ram[0x100] << 24 | vgs.ctx.ram[0x101] << 16 | vgs.ctx.ram[0x102] << 8 | vgs.ctx.ram[0x103];
+    };
+    if (vgs.rewind()) {
+        return fail("rewind must fail while it is disabled");
+    }
+    vgs.setRewindLimit(8 << 20);
+    for (int i = 0; i < 10; i++) {
+        vgs.tick();
+    }
+    const uint32_t last = counter();
+    if (last < 9 || vgs.getRewindFrames() != 9) {
+        std::fprintf(stderr, "counter=%u, frames=%d\n", counter(), vgs.getRewindFrames());
+        return fail("unexpected frames in the rewind buffer");
+    }
+    if (16 * 1024 < vgs.getRewindMemory()) {
+        std::fprintf(stderr, "memory=%d\n", (int)vgs.getRewindMemory());
+        return fail("rewind frames are not delta compressed");
+    }
+
+    // the host writes after the latest frame are reverted too
+    vgs.ctx.ram[0x8000] = 0x5A;
+    vgs.markRamDirty(0x8000, 1);
+    if (!vgs.rewind() || counter() != last - 1 || vgs.vdp.ctx.nametbl[0][4] != last - 1 || vgs.ctx.ram[0x8000] == 0x5A) {
+        return fail("rewind did not restore the previous frame");
+    }
+    if (!vgs.rewind() || counter() != last - 2 || vgs.vdp.ctx.nametbl[0][4] != last - 2 || vgs.getRewindFrames() != 7) {
+        return fail("rewind did not restore the second previous frame");
+    }
+    vgs.tick();
+    if (counter() != last - 1 || vgs.vdp.ctx.nametbl[0][4] != last - 1 || vgs.getRewindFrames() != 8) {
+        return fail("the program did not resume from the rewound frame");
+    }
+
+    // the frames of the previous program are discarded by loading a program
+    if (!vgs.loadProgram(elf.data(), elf.size()) || vgs.getRewindFrames() != 0 || vgs.rewind()) {
+        return fail("loading a program must discard the rewind frames");
+    }
+    for (int i = 0; i < 3; i++) {
+        vgs.tick();
+    }
+
+    // the oldest frames are dropped by the memory limit
+    vgs.setRewindLimit(1);
+    if (vgs.getRewindFrames() != 0 || vgs.rewind()) {
+        return fail("rewind frames were not dropped by the limit");
+    }
+    vgs.setRewindLimit(0);
+    return 0;
+}
+
+static int test_run_ahead(VGSX& vgs)
+{
+    // count the frames, play SFX #0, print an empty line, write save077.dat and call the host every frame
+    static std::vector<uint8_t> elf = makeElf({
+        0x52B9, 0x00F0, 0x0100,                 // addq.l #1, ($F00100).l
+        0x23F9, 0x00F0, 0x0100, 0x00C0, 0x0010, // move.l ($F00100).l, ($C00010).l
+        0x23FC, 0x0000, 0x0000, 0x00E0, 0x1100, // move.l #0, ($E01100).l (SFX)
+        0x23FC, 0x0000, 0x000A, 0x00E0, 0x0000, // move.l #10, ($E00000).l (Console)
+        0x23FC, 0x0000, 0x004D, 0x00E0, 0x3100, // move.l #77, ($E03100).l (Sequencial Open for Write)
+        0x23FC, 0x0000, 0x0000, 0x00E0, 0x3108, // move.l #0, ($E03108).l (Sequencial Commit)
+        0x23FC, 0x0000, 0x0001, 0x00E8, 0x0000, // move.l #1, ($E80000).l (User-Defined I/O)
+        0x4AB9, 0x00E0, 0x0000,                 // tst.l ($E00000).l (V-SYNC)
+        0x60B6,                                 // bra.s loop
+    });
+    auto saved = []() {
+        FILE* fp = std::fopen("save077.dat", "rb");
+        if (fp) {
+            std::fclose(fp);
+        }
+        return nullptr != fp;
+    };
+    int calls = 0;
+    vgs.subscribeOutput([&](uint32_t, uint32_t) { calls++; });
+    static std::vector<uint8_t> wav = makeWav(0x0001, 2, 44100, 16, 4, {0x10, 0x27, 0x10, 0x27});
+    if (!vgs.loadWav(0, wav.data(), wav.size()) || !vgs.loadProgram(elf.data(), elf.size())) {
+        return fail(vgs.getLastError());
+    }
+    int lines = 0;
+    vgs.setConsoleCallback([&](const char*) { lines++; });
+    vgs.setRewindLimit(8 << 20);
+    vgs.tick();
+    vgs.outPort(VGS_ADDR_SFX_STOP, 0);
+    const uint32_t counter = vgs.vdp.ctx.nametbl[0][4];
+    if (1 != lines || 0 != vgs.getRewindFrames()) {
+        return fail("unexpected first frame");
+    }
+
+    // the real frame is not rendered
+    vgs.getDisplay()[0] = 0x01234567;
+    vgs.tick(true);
+    if (vgs.getDisplay()[0] != 0x01234567 || vgs.vdp.ctx.nametbl[0][4] != counter + 1 || 2 != lines || 1 != vgs.getRewindFrames()) {
+        return fail("tick(true) must run the frame without rendering it");
+    }
+    vgs.outPort(VGS_ADDR_SFX_STOP, 0);
+
+    // the speculative frames do not touch the sound, the console, the files, the host and the rewind history
+    std::vector<uint8_t> state;
+    vgs.saveState(state);
+    std::remove("save077.dat");
+    calls = 0;
+    vgs.tick(true, true);
+    vgs.tick(false, true);
+    if (vgs.getDisplay()[0] == 0x01234567 || vgs.vdp.ctx.nametbl[0][4] != counter + 3) {
+        return fail("the speculative frames did not run");
+    }
+    if (vgs.ctx.sfxData[0].play || 2 != lines || 1 != vgs.getRewindFrames()) {
+        return fail("the speculative frames must not play sound, print or record");
+    }
+    if (saved() || 0 != calls) {
+        return fail("the speculative frames must not write the save data or call the user-defined I/O");
+    }
+    const uint32_t presented = vgs.getDisplay()[0];
+    if (!vgs.loadState(state.data(), state.size())) {
+        return fail(vgs.getLastError());
+    }
+    if (vgs.vdp.ctx.nametbl[0][4] != counter + 1 || vgs.getDisplay()[0] != presented) {
+        return fail("rolling back must keep the presented display");
+    }
+    vgs.tick();
+    if (vgs.vdp.ctx.nametbl[0][4] != counter + 2 || !vgs.ctx.sfxData[0].play || 3 != lines) {
+        return fail("the real frame did not resume after rolling back");
+    }
+    if (!saved() || 1 != calls) {
+        return fail("the real frame did not write the save data or call the user-defined I/O");
+    }
+    vgs.outPort(VGS_ADDR_SFX_STOP, 0);
+    vgs.setRewindLimit(0);
+    vgs.setConsoleCallback({});
+    vgs.subscribeOutput([](uint32_t, uint32_t) {});
+    std::remove("save077.dat");
+    return 0;
+}
+
+static int test_movie(VGSX& vgs)
+{
+    // sum the A button and copy the calendar second and the local hour to WRAM every frame
+    static std::vector<uint8_t> elf = makeElf({
+        0x2039, 0x00E0, 0x2010,                 // move.l ($E02010).l, d0 (A button)
+        0xD1B9, 0x00F0, 0x0100,                 // add.l d0, ($F00100).l
+        0x23F9, 0x00E0, 0x4014, 0x00F0, 0x0104, // move.l ($E04014).l, ($F00104).l (second)
+        0x23F9, 0x00E0, 0x402C, 0x00F0, 0x0108, // move.l ($E0402C).l, ($F00108).l (local hour)
+        0x4AB9, 0x00E0, 0x0000,                 // tst.l ($E00000).l (V-SYNC)
+        0x60D8,                                 // bra.s loop
+    });
+    // record in one time zone and replay in another
+    const char* tz = getenv("TZ");
+    const std::string originalTz = tz ? tz : "";
+    auto setTz = [](const char* value) {
+        if (value) {
+            setenv("TZ", value, 1);
+        } else {
+            unsetenv("TZ");
+        }
+        tzset();
+    };
+    setTz("JST-9");
+    if (!vgs.loadProgram(elf.data(), elf.size()) || !vgs.startRecording()) {
+        return fail(vgs.getLastError());
+    }
+    const uint8_t buttons[] = {1, 0, 1, 1, 0, 0, 1};
+    const int samples[] = {0, 1470, 1470, 1472, 1470, 1470, 1468};
+    std::vector<uint64_t> hashes;
+    std::vector<uint8_t> state;
+    std::vector<int16_t> buffer(2048);
+    for (int i = 0; i < 7; i++) {
+        vgs.tickSound(buffer.data(), samples[i]);
+        vgs.key.a = buttons[i];
+        vgs.saveState(state);
+        vgs.tick(false, true); // a rolled back frame is not recorded
+        if (!vgs.loadState(state.data(), state.size())) {
+            return fail(vgs.getLastError());
+        }
+        vgs.tick();
+        hashes.push_back(vgs.getRamHash());
+        hashes.push_back(vgs.getDisplayHash());
+    }
+    std::vector<uint8_t> movie;
+    if (!vgs.stopRecording(movie) || vgs.isRecording() || vgs.getMovieFrames() != 7) {
+        return fail("unexpected recording");
+    }
+    if (20 + 8 + 3 + 6 * 5 < movie.size()) { // header, the first frame with the clock and the UTC offset, then up to 5 bytes per frame
+        std::fprintf(stderr, "size=%d\n", (int)movie.size());
+        return fail("the movie is not compact");
+    }
+
+    // the replay overrides the host inputs and reproduces every frame
+    setTz("EST5");
+    vgs.key.a = 1;
+    if (!vgs.startReplay(movie.data(), movie.size()) || !vgs.isReplaying()) {
+        return fail(vgs.getLastError());
+    }
+    for (size_t i = 0; i < hashes.size(); i += 2) {
+        if (vgs.getMovieSamples() != samples[i / 2]) {
+            return fail("unexpected audio pacing in the replay");
+        }
+        vgs.tickSound(buffer.data(), vgs.getMovieSamples());
+        vgs.tick();
+        if (hashes[i] != vgs.getRamHash() || hashes[i + 1] != vgs.getDisplayHash()) {
+            std::fprintf(stderr, "frame=%d, ram=%d, display=%d\n", (int)i / 2, hashes[i] == vgs.getRamHash(), hashes[i + 1] == vgs.getDisplayHash());
+            return fail("the replay did not reproduce the frame");
+        }
+    }
+    setTz(tz ? originalTz.c_str() : nullptr);
+    if (vgs.isReplaying() || vgs.getMovieFrame() != 7) {
+        return fail("the replay did not end with the movie");
+    }
+
+    // broken movies are rejected
+    std::vector<uint8_t> broken(movie.begin(), movie.end() - 1);
+    if (vgs.startReplay(broken.data(), broken.size())) {
+        return fail("a truncated movie was accepted");
+    }
+    broken = movie;
+    broken[12] ^= 1;
+    if (vgs.startReplay(broken.data(), broken.size())) {
+        return fail("a movie of another program was accepted");
+    }
+    vgs.key.a = 0;
+    return 0;
+}
+
+static int test_capture_callbacks(VGSX& vgs)
+{
+    static std::vector<uint8_t> elf = makeElf({
+        0x4AB9, 0x00E0, 0x0000, // tst.l ($E00000).l (V-SYNC)
+        0x60F8,                 // bra.s loop
+    });
+    if (!vgs.loadProgram(elf.data(), elf.size())) {
+        return fail(vgs.getLastError());
+    }
+    int frames = 0;
+    int samples = 0;
+    vgs.setFrameCallback([&](const uint32_t* display) {
+        frames += display == vgs.getDisplay() ? 1 : 1000;
+    });
+    vgs.setSoundCallback([&](const int16_t*, int count) { samples += count; });
+    std::vector<int16_t> buffer(1470);
+    vgs.tickSound(buffer.data(), (int)buffer.size());
+    vgs.tick();
+    vgs.tick(true);
+    if (1 != frames || 1470 != samples) {
+        return fail("the callbacks must be called for each rendered frame and each sound buffer");
+    }
+    vgs.render();
+    vgs.setFrameCallback({});
+    vgs.setSoundCallback({});
+    vgs.tick();
+    vgs.tickSound(buffer.data(), (int)buffer.size());
+    if (2 != frames || 1470 != samples) {
+        return fail("the callbacks must be removable");
+    }
+    return 0;
+}
+
+static int test_telemetry(VGSX& vgs)
+{
+    static std::vector<uint8_t> elf = makeElf({
+        0x23FC, 0x0000, 0x0055, 0x00E0, 0x0008, // move.l #$55, ($E00008).l (DMA source)
+        0x23FC, 0x00F0, 0x0000, 0x00E0, 0x000C, // move.l #$F00000, ($E0000C).l (DMA destination)
+        0x23FC, 0x0000, 0x0100, 0x00E0, 0x0010, // move.l #256, ($E00010).l (DMA argument)
+        0x23FC, 0x0000, 0x0001, 0x00E0, 0x0014, // move.l #1, ($E00014).l (DMA memset)
+        0x4AB9, 0x00E0, 0x0000,                 // tst.l ($E00000).l (V-SYNC)
+        0x60D0,                                 // bra.s loop
+    });
+    if (!vgs.loadProgram(elf.data(), elf.size())) {
+        return fail(vgs.getLastError());
+    }
+    vgs.vdp.ctx.oam[0].visible = 1;
+    vgs.vdp.ctx.oam[1].visible = 1;
+    std::vector<Telemetry::Frame> records;
+    vgs.setTelemetryCallback([&](const Telemetry::Frame& frame) { records.push_back(frame); });
+    std::vector<int16_t> buffer(1470);
+    auto count = [](const Telemetry::Frame& frame, Telemetry::Span span) {
+        int n = 0;
+        for (int i = 0; i < frame.spanCount; i++) {
+            n += span == frame.spans[i].span ? 1 : 0;
+        }
+        return n;
+    };
+    vgs.tickSound(buffer.data(), (int)buffer.size());
+    vgs.tick();
+    vgs.reportPresent(Telemetry::now());
+    vgs.tick(false, true);
+    vgs.tick(true);
+    vgs.flushTelemetry();
+    vgs.setTelemetryCallback({});
+    vgs.tick();
+    vgs.vdp.ctx.oam[0].visible = 0;
+    vgs.vdp.ctx.oam[1].visible = 0;
+    if (3 != records.size()) {
+        return fail("a telemetry record must be handed over for each tick");
+    }
+    const auto& first = records[0];
+    if (0 != first.frame || first.speculative || 1 != count(first, Telemetry::Span::TickSound) || 1 != count(first, Telemetry::Span::Tick) || 1 != count(first, Telemetry::Span::Render) || VDP_BG_NUM != count(first, Telemetry::Span::RenderBG) || 1 != count(first, Telemetry::Span::RenderSprites) || 1 != count(first, Telemetry::Span::Present)) {
+        return fail("the first telemetry record must hold the sound, tick, render and present spans");
+    }
+    for (const auto& record : records) {
+        if (1 != record.inPorts || 4 != record.outPorts || 256 != record.dmaBytes || 0 == record.cpuClocks) {
+            return fail("the telemetry must count the port accesses and the DMA bytes of each frame");
+        }
+        for (int i = 0; i < record.spanCount; i++) {
+            if (record.spans[i].end < record.spans[i].begin) {
+                return fail("a telemetry span must not end before it begins");
+            }
+        }
+    }
+    if (2 != first.sprites || !records[1].speculative || 1 != records[1].frame || 0 != count(records[2], Telemetry::Span::Render) || 0 != records[2].sprites) {
+        return fail("the telemetry must record the sprites, the speculative ticks and the skipped render");
+    }
+    return 0;
+}
+
+static int test_perf_ports(VGSX& vgs)
+{
+    static std::vector<uint8_t> elf = makeElf({
+        0x4AB9, 0x00E0, 0x0000, // tst.l ($E00000).l (V-SYNC)
+        0x60F8,                 // bra.s loop
+    });
+    if (!vgs.loadProgram(elf.data(), elf.size())) {
+        return fail(vgs.getLastError());
+    }
+    if (0 != vgs.inPort(VGS_ADDR_PERF_TOTAL_CLOCKS) || 0 != vgs.inPort(VGS_ADDR_PERF_LAST_CLOCKS)) {
+        return fail("the performance counters must be cleared by reset");
+    }
+    uint32_t total = 0;
+    uint32_t last = 0;
+    for (int i = 0; i < 3; i++) {
+        vgs.tick();
+        if (vgs.ctx.frameClocks != vgs.inPort(VGS_ADDR_PERF_CLOCKS) || last != vgs.inPort(VGS_ADDR_PERF_LAST_CLOCKS)) {
+            return fail("PERF_CLOCKS must be the clocks of the current frame and PERF_LAST_CLOCKS those of the previous frame");
+        }
+        last = vgs.ctx.frameClocks;
+        total += last;
+        if (total != vgs.inPort(VGS_ADDR_PERF_TOTAL_CLOCKS)) {
+            return fail("PERF_TOTAL_CLOCKS must count the clocks of all frames");
+        }
+    }
+    std::vector<uint8_t> state;
+    vgs.saveState(state);
+    vgs.tick();
+    if (!vgs.loadState(state.data(), state.size()) || total != vgs.inPort(VGS_ADDR_PERF_TOTAL_CLOCKS) || last != vgs.inPort(VGS_ADDR_PERF_CLOCKS)) {
+        return fail("the clock counters must be restored by loadState");
+    }
+    vgs.startRecording();
+    vgs.tick();
+    const uint32_t renderTime = vgs.inPort(VGS_ADDR_PERF_RENDER_TIME);
+    std::vector<uint8_t> movie;
+    vgs.stopRecording(movie);
+    if (0 != renderTime) {
+        return fail("PERF_RENDER_TIME must be 0 while recording a movie (host dependent)");
+    }
+    return 0;
+}
+
 int main()
 {
     vgsx.disableBootBios();
@@ -175,9 +1719,30 @@ int main()
     if (int rc = test_readme_vdp_register_doc(); rc) return rc;
     if (int rc = test_random_full_cycle(vgsx); rc) return rc;
     if (int rc = test_dma_memset_last_byte(vgsx); rc) return rc;
+    if (int rc = test_dma_u2s_ascii_run_and_kanji(vgsx); rc) return rc;
     if (int rc = test_seq_write_clamps_to_1mb(vgsx); rc) return rc;
     if (int rc = test_sprite_size_63_renders_512_pixels(); rc) return rc;
     if (int rc = test_palette_1024_addressing_and_rendering(vgsx); rc) return rc;
+    if (int rc = test_vdp_string_draw_and_advance(); rc) return rc;
+    if (int rc = test_sprite_hit_unit(vgsx); rc) return rc;
+    if (int rc = test_math_array(vgsx); rc) return rc;
+    if (int rc = test_dma_sort(vgsx); rc) return rc;
+    if (int rc = test_vgm_block_render_tolerance(vgsx); rc) return rc;
+    if (int rc = test_vgm_register_burst(vgsx); rc) return rc;
+    if (int rc = test_vgm_analog_presets(vgsx); rc) return rc;
+    if (int rc = test_vgm_compile(vgsx); rc) return rc;
+    if (int rc = test_vgm_seek(vgsx); rc) return rc;
+    if (int rc = test_audio_stats(vgsx); rc) return rc;
+    if (int rc = test_sfx_mixer(vgsx); rc) return rc;
+    if (int rc = test_sfx_formats(vgsx); rc) return rc;
+    if (int rc = test_sample_rate(vgsx); rc) return rc;
+    if (int rc = test_save_state(vgsx); rc) return rc;
+    if (int rc = test_rewind(vgsx); rc) return rc;
+    if (int rc = test_run_ahead(vgsx); rc) return rc;
+    if (int rc = test_movie(vgsx); rc) return rc;
+    if (int rc = test_capture_callbacks(vgsx); rc) return rc;
+    if (int rc = test_telemetry(vgsx); rc) return rc;
+    if (int rc = test_perf_ports(vgsx); rc) return rc;
 
     std::fprintf(stderr, "OK\n");
     return 0;
@@ -39,6 +39,148 @@ class Data
 
 static std::vector<Data*> _data;
 
+static const int16_t imaStepTable[89] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230, 253, 279, 307,
+    337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
+    2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899,
+    15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767};
+
+static const int8_t imaIndexTable[16] = {-1, -1, -1, -1, 2, 4, 6, 8, -1, -1, -1, -1, 2, 4, 6, 8};
+
+static uint8_t imaEncodeSample(int sample, int* predictor, int* index)
+{
+    int step = imaStepTable[*index];
+    int diff = sample - *predictor;
+    uint8_t nibble = 0;
+    if (diff < 0) {
+        nibble = 8;
+        diff = -diff;
+    }
+    if (diff >= step) {
+        nibble |= 4;
+        diff -= step;
+    }
+    if (diff >= step >> 1) {
+        nibble |= 2;
+        diff -= step >> 1;
+    }
+    if (diff >= step >> 2) {
+        nibble |= 1;
+    }
+
+    // update the predictor in the same way as the decoder
+    int delta = step >> 3;
+    if (nibble & 1) delta += step >> 2;
+    if (nibble & 2) delta += step >> 1;
+    if (nibble & 4) delta += step;
+    *predictor += (nibble & 8) ? -delta : delta;
+    *predictor = *predictor < -32768 ? -32768 : (32767 < *predictor ? 32767 : *predictor);
+    *index += imaIndexTable[nibble];
+    *index = *index < 0 ? 0 : (88 < *index ? 88 : *index);
+    return nibble;
+}
+
+static void put16(std::vector<uint8_t>& out, uint32_t value)
+{
+    out.push_back(value & 0xFF);
+    out.push_back((value >> 8) & 0xFF);
+}
+
+static void put32(std::vector<uint8_t>& out, uint32_t value)
+{
+    put16(out, value & 0xFFFF);
+    put16(out, value >> 16);
+}
+
+// Encode a 16-bit PCM .wav to an IMA-ADPCM .wav (WAVE_FORMAT_IMA_ADPCM)
+static uint8_t* encodeImaAdpcm(const char* path, const uint8_t* wav, int size, int* outSize)
+{
+    uint16_t format = 0, channels = 0, bits = 0;
+    uint32_t rate = 0;
+    const int16_t* pcm = nullptr;
+    uint32_t pcmSize = 0;
+    if (size < 12 || 0 != memcmp(wav, "RIFF", 4) || 0 != memcmp(wav + 8, "WAVE", 4)) {
+        printf("Invalid wav format: %s\n", path);
+        exit(255);
+    }
+    for (int ptr = 12; ptr + 8 <= size;) {
+        uint32_t n;
+        memcpy(&n, wav + ptr + 4, 4);
+        if (0 == memcmp(wav + ptr, "fmt ", 4) && 16 <= n) {
+            memcpy(&format, wav + ptr + 8, 2);
+            memcpy(&channels, wav + ptr + 10, 2);
+            memcpy(&rate, wav + ptr + 12, 4);
+            memcpy(&bits, wav + ptr + 22, 2);
+        } else if (0 == memcmp(wav + ptr, "data", 4)) {
+            pcm = (const int16_t*)(wav + ptr + 8);
+            pcmSize = n < (uint32_t)(size - ptr - 8) ? n : (uint32_t)(size - ptr - 8);
+            break;
+        }
+        ptr += 8 + n;
+    }
+    if (format != 1 || bits != 16 || (channels != 1 && channels != 2) || (rate != 44100 && rate != 22050 && rate != 11025) || !pcm) {
+        printf("Unsupported wav format (44100/22050/11025Hz, 16bits, 1/2ch only): %s\n", path);
+        exit(255);
+    }
+
+    const uint32_t blockAlign = 512 * channels;
+    const uint32_t header = 4 * channels;
+    const uint32_t samplesPerBlock = (blockAlign - header) * 8 / header + 1;
+    const uint32_t frames = pcmSize / (2 * channels);
+    const uint32_t blocks = (frames + samplesPerBlock - 1) / samplesPerBlock;
+
+    std::vector<uint8_t> out;
+    out.insert(out.end(), {'R', 'I', 'F', 'F', 0, 0, 0, 0, 'W', 'A', 'V', 'E', 'f', 'm', 't', ' '});
+    put32(out, 20);
+    put16(out, 0x0011);
+    put16(out, channels);
+    put32(out, rate);
+    put32(out, rate * blockAlign / samplesPerBlock);
+    put16(out, blockAlign);
+    put16(out, 4);
+    put16(out, 2);
+    put16(out, samplesPerBlock);
+    out.insert(out.end(), {'f', 'a', 'c', 't'});
+    put32(out, 4);
+    put32(out, frames);
+    out.insert(out.end(), {'d', 'a', 't', 'a'});
+    put32(out, blocks * blockAlign);
+
+    int predictor[2] = {0, 0};
+    int index[2] = {0, 0};
+    auto sample = [&](uint32_t frame, int ch) {
+        return frame < frames ? pcm[frame * channels + ch] : (frames ? pcm[(frames - 1) * channels + ch] : 0);
+    };
+    for (uint32_t b = 0; b < blocks; b++) {
+        const uint32_t first = b * samplesPerBlock;
+        for (int ch = 0; ch < channels; ch++) {
+            predictor[ch] = sample(first, ch);
+            put16(out, (uint16_t)predictor[ch]);
+            out.push_back((uint8_t)index[ch]);
+            out.push_back(0);
+        }
+        for (uint32_t group = 0; group < (samplesPerBlock - 1) / 8; group++) {
+            for (int ch = 0; ch < channels; ch++) {
+                for (int i = 0; i < 8; i += 2) {
+                    const uint32_t frame = first + 1 + group * 8 + i;
+                    uint8_t lo = imaEncodeSample(sample(frame, ch), &predictor[ch], &index[ch]);
+                    uint8_t hi = imaEncodeSample(sample(frame + 1, ch), &predictor[ch], &index[ch]);
+                    out.push_back(lo | (hi << 4));
+                }
+            }
+        }
+    }
+    const uint32_t riff = (uint32_t)out.size() - 8;
+    memcpy(&out[4], &riff, 4);
+
+    printf("Encoded %s to IMA-ADPCM: %d -> %d bytes\n", path, size, (int)out.size());
+    *outSize = (int)out.size();
+    uint8_t* result = new uint8_t[out.size()];
+    memcpy(result, out.data(), out.size());
+    return result;
+}
+
 static void put_usage(void)
 {
     puts("usage: makerom  -o /path/to/output.rom");
@@ -47,6 +189,7 @@ static void put_usage(void)
     puts("               [-g /path/to/pattern.chr ...]");
     puts("               [-b /path/to/bgm.vgm ...]");
     puts("               [-s /path/to/sfx.wav ...]");
+    puts("               [-a /path/to/sfx.wav ...] (encode as IMA-ADPCM)");
     exit(1);
 }
 
@@ -102,6 +245,24 @@ int main(int argc, char* argv[])
                     }
                     break;
                 }
+                case 'a': {
+                    if (argc <= ++i) { put_usage(); }
+                    int size;
+                    int encodedSize;
+                    uint8_t* bin;
+                    uint8_t* encoded;
+                    bin = loadBinary(argv[i], &size);
+                    encoded = encodeImaAdpcm(argv[i], bin, size, &encodedSize);
+                    _data.push_back(new Data("WAV", encoded, encodedSize));
+                    delete[] bin;
+                    while (i + 1 < argc && argv[i + 1][0] != '-') {
+                        bin = loadBinary(argv[++i], &size);
+                        encoded = encodeImaAdpcm(argv[i], bin, size, &encodedSize);
+                        _data.push_back(new Data("WAV", encoded, encodedSize));
+                        delete[] bin;
+                    }
+                    break;
+                }
                 case 'e': {
                     if (programSpecified) { put_usage(); }
                     if (argc <= ++i) { put_usage(); }
@@ -1,7 +1,8 @@
-#include <pthread.h>
 #include <SDL.h>
 #include <unistd.h>
 #include <ctype.h>
+#include <algorithm>
+#include <atomic>
 #include <cstdio>
 #include <iostream>
 #include <fstream>
@@ -13,8 +14,59 @@
 
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include "../common/stb_image_write.h"
+#include "../common/audio_stats.h"
+#include "../common/frame_capture.h"
+#include "../common/telemetry_writer.h"
 
-static pthread_mutex_t soundMutex = PTHREAD_MUTEX_INITIALIZER;
+// Lock-free ring of stereo PCM frames: written by the main loop (tickSound) and read by the audio callback only
+class AudioRing
+{
+  public:
+    static constexpr size_t Capacity = 16384; // frames (must be a power of 2)
+
+    // producer side
+    size_t writable() const { return Capacity - (this->tail.load(std::memory_order_relaxed) - this->head.load(std::memory_order_acquire)); }
+    size_t queued() const { return Capacity - this->writable(); }
+
+    void push(const int16_t* src, size_t frames)
+    {
+        const size_t tail = this->tail.load(std::memory_order_relaxed);
+        for (size_t i = 0; i < frames; i++) {
+            const size_t index = ((tail + i) & (Capacity - 1)) * 2;
+            this->buffer[index] = src[i * 2];
+            this->buffer[index + 1] = src[i * 2 + 1];
+        }
+        this->tail.store(tail + frames, std::memory_order_release);
+    }
+
+    // consumer side (returns the number of copied frames)
+    size_t pop(int16_t* dst, size_t frames)
+    {
+        const size_t head = this->head.load(std::memory_order_relaxed);
+        const size_t available = this->tail.load(std::memory_order_acquire) - head;
+        if (available < frames) {
+            frames = available;
+        }
+        for (size_t i = 0; i < frames; i++) {
+            const size_t index = ((head + i) & (Capacity - 1)) * 2;
+            dst[i * 2] = this->buffer[index];
+            dst[i * 2 + 1] = this->buffer[index + 1];
+        }
+        this->head.store(head + frames, std::memory_order_release);
+        return frames;
+    }
+
+  private:
+    int16_t buffer[Capacity * 2];
+    alignas(64) std::atomic<size_t> head{0}; // read position (updated by the consumer)
+    alignas(64) std::atomic<size_t> tail{0}; // write position (updated by the producer)
+};
+
+static AudioRing audioRing;
+static std::atomic<uint32_t> audioUnderrunFrames{0};
+static std::atomic<uint32_t> audioUnderruns{0};
+static std::atomic<uint32_t> audioConsumedFrames{0};
+static uint32_t audioOverrunFrames = 0;
 static int pendingMouseScrollV = 0;
 static int pendingMouseScrollH = 0;
 static bool enableCrtFilter = false;
@@ -125,6 +177,13 @@ static void put_usage()
     puts("            [-m]");
     puts("            [-rsv]");
     puts("            [--ym-analog=off|clean|subtle|real|re1e|warm]");
+    puts("            [--run-ahead=0-4]");
+    puts("            [--record=/path/to/movie.vgsm]");
+    puts("            [--replay=/path/to/movie.vgsm]");
+    puts("            [--capture=/path/to/output]");
+    puts("            [--capture-format=png|raw]");
+    puts("            [--telemetry=/path/to/telemetry.json]");
+    puts("            [--telemetry-format=jsonl|trace]");
     puts("            [-g /path/to/pattern.chr]");
     puts("            [-c /path/to/palette.bin]");
     puts("            [-b /path/to/bgm.vgm]");
@@ -135,10 +194,32 @@ static void put_usage()
 
 static void audioCallback(void* userdata, Uint8* stream, int len)
 {
-    memset(stream, 0, len);
-    pthread_mutex_lock(&soundMutex);
-    vgsx.tickSound((int16_t*)stream, len / 2);
-    pthread_mutex_unlock(&soundMutex);
+    const size_t frames = (size_t)len / 4;
+    const size_t copied = audioRing.pop((int16_t*)stream, frames);
+    audioConsumedFrames.fetch_add((uint32_t)copied, std::memory_order_relaxed);
+    if (copied < frames) {
+        memset(stream + copied * 4, 0, (frames - copied) * 4);
+        audioUnderrunFrames.fetch_add((uint32_t)(frames - copied), std::memory_order_relaxed);
+        audioUnderruns.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+// Keep the ring filled up to the target by synthesizing the sound on the emulation side
+static void produceSound(std::vector<int16_t>& buffer, size_t targetFrames)
+{
+    const size_t queued = audioRing.queued();
+    if (targetFrames <= queued) {
+        return;
+    }
+    const size_t writable = audioRing.writable();
+    size_t frames = targetFrames - queued;
+    if (writable < frames) {
+        audioOverrunFrames += (uint32_t)(frames - writable);
+        frames = writable;
+    }
+    buffer.resize(frames * 2);
+    vgsx.tickSound(buffer.data(), (int)buffer.size());
+    audioRing.push(buffer.data(), frames);
 }
 
 static void applyMouseOption(bool enableMouse)
@@ -258,6 +339,13 @@ int main(int argc, char* argv[])
     bool print_dump = false;
     bool enableMouse = false;
     YmAnalogOption ymAnalogOption = YmAnalogOption::Real;
+    int runAhead = 0;
+    const char* recordPath = nullptr;
+    const char* replayPath = nullptr;
+    const char* capturePath = nullptr;
+    FrameCapture::Format captureFormat = FrameCapture::Format::Png;
+    const char* telemetryPath = nullptr;
+    TelemetryWriter::Format telemetryFormat = TelemetryWriter::Format::Lines;
     vgsx.disableBootBios();
     for (int i = 1; i < argc; i++) {
         if ('-' == argv[i][0]) {
@@ -282,6 +370,61 @@ int main(int argc, char* argv[])
                 isFirstOption = false;
                 continue;
             }
+            if (0 == strncmp(argv[i], "--run-ahead=", 12)) {
+                runAhead = atoi(argv[i] + 12);
+                if (runAhead < 0 || 4 < runAhead) {
+                    put_usage();
+                    return 1;
+                }
+                isFirstOption = false;
+                continue;
+            }
+            if (0 == strncmp(argv[i], "--record=", 9)) {
+                recordPath = argv[i] + 9;
+                isFirstOption = false;
+                continue;
+            }
+            if (0 == strncmp(argv[i], "--replay=", 9)) {
+                replayPath = argv[i] + 9;
+                isFirstOption = false;
+                continue;
+            }
+            if (0 == strncmp(argv[i], "--capture=", 10)) {
+                capturePath = argv[i] + 10;
+                isFirstOption = false;
+                continue;
+            }
+            if (0 == strncmp(argv[i], "--capture-format=", 17)) {
+                const char* value = argv[i] + 17;
+                if (0 == strcmp(value, "png")) {
+                    captureFormat = FrameCapture::Format::Png;
+                } else if (0 == strcmp(value, "raw")) {
+                    captureFormat = FrameCapture::Format::Raw;
+                } else {
+                    put_usage();
+                    return 1;
+                }
+                isFirstOption = false;
+                continue;
+            }
+            if (0 == strncmp(argv[i], "--telemetry=", 12)) {
+                telemetryPath = argv[i] + 12;
+                isFirstOption = false;
+                continue;
+            }
+            if (0 == strncmp(argv[i], "--telemetry-format=", 19)) {
+                const char* value = argv[i] + 19;
+                if (0 == strcmp(value, "jsonl")) {
+                    telemetryFormat = TelemetryWriter::Format::Lines;
+                } else if (0 == strcmp(value, "trace")) {
+                    telemetryFormat = TelemetryWriter::Format::Trace;
+                } else {
+                    put_usage();
+                    return 1;
+                }
+                isFirstOption = false;
+                continue;
+            }
             switch (tolower(argv[i][1])) {
                 case 'x': {
                     if (argc <= i + 1) {
@@ -444,6 +587,8 @@ int main(int argc, char* argv[])
     }
 
     SDL_AudioDeviceID audioDeviceId = 0;
+    size_t audioTargetFrames = 0;
+    std::vector<int16_t> soundBuffer;
     SDL_Window* window = nullptr;
     SDL_Renderer* renderer = nullptr;
     SDL_Texture* displayTexture = nullptr;
@@ -467,7 +612,7 @@ int main(int argc, char* argv[])
         desired.samples = 2048;
         desired.callback = audioCallback;
         desired.userdata = &vgsx;
-        audioDeviceId = SDL_OpenAudioDevice(nullptr, 0, &desired, &obtained, 0);
+        audioDeviceId = SDL_OpenAudioDevice(nullptr, 0, &desired, &obtained, SDL_AUDIO_ALLOW_FREQUENCY_CHANGE);
         if (0 == audioDeviceId) {
             printf(" ... SDL_OpenAudioDevice failed: %s\n", SDL_GetError());
             exit(-1);
@@ -476,6 +621,8 @@ int main(int argc, char* argv[])
         printf("- obtained.format = %X\n", obtained.format);
         printf("- obtained.channels = %d\n", obtained.channels);
         printf("- obtained.samples = %d\n", obtained.samples);
+        vgsx.setSampleRate(obtained.freq); // synthesize at the device rate (no conversion in SDL)
+        audioTargetFrames = obtained.samples + obtained.freq / 60 * 3; // one callback and 3 frames of headroom
 
         window = SDL_CreateWindow(
             "VGS-X for SDL2",
@@ -516,12 +663,39 @@ int main(int argc, char* argv[])
     bool swPressed[10];
     double totalClocks = 0.0;
     uint32_t maxClocks = 0;
+    uint32_t reportedUnderrunFrames = 0;
+    uint32_t reportedUnderruns = 0;
+    uint32_t reportedConsumedFrames = 0;
+    uint32_t reportedOverrunFrames = 0;
+    std::vector<uint8_t> runAheadState;
     memset(swPressed, 0, sizeof(swPressed));
     if (!consoleMode) {
         SDL_PauseAudioDevice(audioDeviceId, 0);
     }
     vgsx.reset();
     applyMouseOption(enableMouse);
+    if (replayPath) {
+        int size;
+        uint8_t* movie = loadBinary(replayPath, &size);
+        if (!movie || !vgsx.startReplay(movie, size)) {
+            printf("Replay failed: %s\n", movie ? vgsx.getLastError() : replayPath);
+            exit(255);
+        }
+        printf("Replaying %d frames: %s\n", vgsx.getMovieFrames(), replayPath);
+        delete[] movie;
+    } else if (recordPath) {
+        vgsx.startRecording();
+    }
+    FrameCapture capture;
+    if (capturePath && !capture.start(vgsx, capturePath, captureFormat)) {
+        printf("Cannot write: %s\n", capturePath);
+        exit(255);
+    }
+    TelemetryWriter telemetry;
+    if (telemetryPath && !telemetry.start(vgsx, telemetryPath, telemetryFormat)) {
+        printf("Cannot write: %s\n", telemetryPath);
+        exit(255);
+    }
     while (!quit && !vgsx.isExit()) {
         loopCount++;
         auto start = std::chrono::system_clock::now();
@@ -562,7 +736,14 @@ int main(int argc, char* argv[])
                         printf("CRT filter: %s\n", enableCrtFilter ? "ON" : "OFF");
                         break;
                     case SDLK_q: quit = true; break;
-                    case SDLK_r: vgsx.reset(); break;
+                    case SDLK_r:
+                        // a reset is not a movie event, so it would desync the recording or the replay
+                        if (vgsx.isRecording() || vgsx.isReplaying()) {
+                            printf("Reset is disabled while recording or replaying a movie\n");
+                        } else {
+                            vgsx.reset();
+                        }
+                        break;
                     case SDLK_c: screenShot(); break;
                 }
             } else if (event.type == SDL_KEYUP) {
@@ -585,16 +766,54 @@ int main(int argc, char* argv[])
             }
         }
         if (!quit) {
-            pthread_mutex_lock(&soundMutex);
             updateMouse(window, enableMouse);
-            vgsx.tick();
-            pthread_mutex_unlock(&soundMutex);
+            if (vgsx.isReplaying() && 0 < vgsx.getMovieSamples()) {
+                // the BGM advances as much as it did in the recording
+                const size_t frames = std::min((size_t)vgsx.getMovieSamples() / 2, audioRing.writable());
+                soundBuffer.resize((size_t)vgsx.getMovieSamples());
+                vgsx.tickSound(soundBuffer.data(), (int)soundBuffer.size());
+                if (!consoleMode) {
+                    audioRing.push(soundBuffer.data(), frames);
+                }
+            }
+            if (0 < runAhead && !consoleMode) {
+                // run the real frame, present the frame N frames ahead with the current input and roll back
+                vgsx.tick(true);
+                vgsx.saveState(runAheadState);
+                for (int i = 1; i < runAhead; i++) {
+                    vgsx.tick(true, true);
+                }
+                vgsx.tick(false, true);
+                if (!vgsx.loadState(runAheadState.data(), runAheadState.size())) {
+                    printf("error: Run-ahead was disabled (%s)\n", vgsx.getLastError());
+                    runAhead = 0;
+                }
+            } else {
+                vgsx.tick();
+            }
+            if (!consoleMode && !vgsx.isReplaying()) {
+                produceSound(soundBuffer, audioTargetFrames);
+                const uint32_t underrunFrames = audioUnderrunFrames.load(std::memory_order_relaxed);
+                if (reportedUnderrunFrames != underrunFrames && 1 < loopCount) {
+                    printf("warning: Audio underrun (%u frames in total)\n", underrunFrames);
+                }
+                reportedUnderrunFrames = underrunFrames;
+
+                // hand the device side counters over to VGSX (consumed samples, underrun and overrun events)
+                const uint32_t underruns = audioUnderruns.load(std::memory_order_relaxed);
+                const uint32_t consumedFrames = audioConsumedFrames.load(std::memory_order_relaxed);
+                vgsx.reportAudioDevice((consumedFrames - reportedConsumedFrames) * 2, underruns - reportedUnderruns, audioOverrunFrames != reportedOverrunFrames ? 1 : 0);
+                reportedUnderruns = underruns;
+                reportedConsumedFrames = consumedFrames;
+                reportedOverrunFrames = audioOverrunFrames;
+            }
             totalClocks += vgsx.ctx.frameClocks;
             if (maxClocks < vgsx.ctx.frameClocks) {
                 maxClocks = vgsx.ctx.frameClocks;
                 printf("Update the peak CPU clock rate: %dHz per frame.\n", maxClocks);
             }
             if (!consoleMode) {
+                const uint64_t presentStart = Telemetry::now();
                 const int displayWidth = vgsx.getDisplayWidth();
                 const int displayHeight = vgsx.getDisplayHeight();
                 const uint32_t* display = vgsx.getDisplay();
@@ -620,6 +839,7 @@ int main(int argc, char* argv[])
                     SDL_RenderCopy(renderer, displayTexture, nullptr, nullptr);
                     SDL_RenderPresent(renderer);
                 }
+                vgsx.reportPresent(presentStart);
             }
             // sync 60fps
             std::chrono::duration<double> diff = std::chrono::system_clock::now() - start;
@@ -638,6 +858,25 @@ int main(int argc, char* argv[])
         }
     }
 
+    if (telemetry.isRecording()) {
+        telemetry.stop();
+        printf("Wrote the telemetry of %d frames: %s\n", telemetry.getFrames(), telemetryPath);
+    }
+
+    if (capture.isCapturing()) {
+        capture.stop();
+        printf("Captured %d frames (%d dropped%s): %s\n", capture.getCapturedFrames(), capture.getDroppedFrames(), capture.isFailed() ? ", write error" : "", capturePath);
+        capture.printRawHint();
+    }
+
+    if (vgsx.isRecording()) {
+        std::vector<uint8_t> movie;
+        vgsx.stopRecording(movie);
+        std::ofstream ofs(recordPath, std::ios::binary);
+        ofs.write((const char*)movie.data(), (std::streamsize)movie.size());
+        printf("Recorded %d frames (%d bytes): %s\n", vgsx.getMovieFrames(), (int)movie.size(), recordPath);
+    }
+
     if (print_dump) {
         printf("\n[RAM DUMP]\n");
         uint8_t prevbin[16];
@@ -698,6 +937,9 @@ int main(int argc, char* argv[])
     } else {
         printf("Maximum MC68030 Clocks: %.1fMHz per second.\n", max / 1000000);
     }
+    if (!consoleMode) {
+        printAudioStats(vgsx.getAudioStats(), vgsx.getSampleRate());
+    }
     if (displayTexture) {
         SDL_DestroyTexture(displayTexture);
     }
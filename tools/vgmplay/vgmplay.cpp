@@ -154,11 +154,12 @@ int main(int argc, char* argv[])
     desired.samples = 2048;
     desired.callback = audioCallback;
     desired.userdata = &vgsx;
-    audioDeviceId = SDL_OpenAudioDevice(nullptr, 0, &desired, &obtained, 0);
+    audioDeviceId = SDL_OpenAudioDevice(nullptr, 0, &desired, &obtained, SDL_AUDIO_ALLOW_FREQUENCY_CHANGE);
     if (0 == audioDeviceId) {
         printf(" ... SDL_OpenAudioDevice failed: %s\n", SDL_GetError());
         exit(-1);
     }
+    vgsx.setSampleRate(obtained.freq);
     SDL_PauseAudioDevice(audioDeviceId, 0);
 
     // execute 1 frame (program_elf calls vgs_bgm_play in the fast frame)